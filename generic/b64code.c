@@ -228,7 +228,9 @@ TrfInit_B64 (interp)
 Tcl_Interp* interp;
 {
   TrfLock; /* THREADING: serialize initialization */
-  convDefinition.options = Trf_ConverterOptions ();
+  if (convDefinition.options == (Trf_OptionVectors*) NULL) {
+    convDefinition.options = Trf_ConverterOptions ();
+  }
   TrfUnlock;
 
   return Trf_Register (interp, &convDefinition);
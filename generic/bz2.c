@@ -69,6 +69,11 @@ static int              DecodeBuffer   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
 						     unsigned char* buffer, int bufLen,
 						     Tcl_Interp* interp,
 						     ClientData clientData));
+static int              DecodeBudget   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     unsigned char* buffer, int bufLen,
+						     int budget, int* pending,
+						     Tcl_Interp* interp,
+						     ClientData clientData));
 static int              FlushDecoder   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
 						     Tcl_Interp* interp,
 						     ClientData clientData));
@@ -80,6 +85,38 @@ static void Bz2libError _ANSI_ARGS_ ((Tcl_Interp* interp,
 				    int         errcode,
 				    CONST char* prefix));
 
+struct _DecoderControl_;
+
+static int Decompress _ANSI_ARGS_ ((struct _DecoderControl_* c,
+				    int         budget,
+				    Tcl_Interp* interp));
+static int NextStream _ANSI_ARGS_ ((struct _DecoderControl_* c,
+				    Tcl_Interp* interp));
+
+struct _EncoderControl_;
+struct _ParallelBz2_;
+
+static struct _ParallelBz2_* ParallelCreate _ANSI_ARGS_ ((TrfBz2OptionBlock* o));
+static void ParallelDelete   _ANSI_ARGS_ ((struct _ParallelBz2_* p));
+static void ParallelClear    _ANSI_ARGS_ ((struct _ParallelBz2_* p));
+static int  ParallelWrite    _ANSI_ARGS_ ((struct _EncoderControl_* c,
+					   unsigned char* buffer, int bufLen,
+					   Tcl_Interp* interp));
+static int  ParallelCompress _ANSI_ARGS_ ((struct _EncoderControl_* c,
+					   Tcl_Interp* interp));
+
+struct _BlocksBz2_;
+
+static struct _BlocksBz2_* BlocksCreate _ANSI_ARGS_ ((TrfBz2OptionBlock* o));
+static void BlocksDelete _ANSI_ARGS_ ((struct _BlocksBz2_* p));
+static void BlocksClear  _ANSI_ARGS_ ((struct _BlocksBz2_* p));
+static int  BlocksWrite  _ANSI_ARGS_ ((struct _DecoderControl_* c,
+				       unsigned char* buffer, int bufLen,
+				       Tcl_Interp* interp));
+static int  BlocksParse  _ANSI_ARGS_ ((struct _DecoderControl_* c,
+				       int final, Tcl_Interp* interp));
+static int  BlocksRun    _ANSI_ARGS_ ((struct _DecoderControl_* c,
+				       int final, Tcl_Interp* interp));
 
 /*
  * Converter definition.
@@ -120,9 +157,11 @@ typedef struct _EncoderControl_ {
 
   /* add conversion specific items here (BZ2) */
 
-  bz_stream state;	/* compressor state */
+  bz_stream state;	/* compressor state, unused for a parallel
+			 * compression */
 
-  char* output_buffer;
+  struct _ParallelBz2_* par; /* State of a parallel compression
+			      * (-threads), or NULL */
 
 } EncoderControl;
 
@@ -135,14 +174,121 @@ typedef struct _DecoderControl_ {
 
   bz_stream state;	/* decompressor state */
 
-  char* output_buffer;
-
   int lastRes;
+  int streams;		/* Number of streams completed so far */
+  int stop;		/* Boolean flag. Set if the data following
+			 * the last stream is not a stream */
+
+  unsigned char* keep;	/* Input not decoded yet by 'DecodeBudget' */
+  int keepLen;
+  int keepSize;		/* Allocated size of 'keep' */
+
+  struct _BlocksBz2_* par; /* State of a parallel decompression
+			    * (-threads), or NULL */
 
 } DecoderControl;
 
 #define KILO     (1024)
-#define OUT_SIZE (32 * KILO)
+#define OUT_SIZE TRF_SCRATCH_SIZE /* Output is collected in the scratch
+				   * buffers of the thread */
+
+/*
+ * Parallel compression (-threads N). The input is cut into chunks of
+ * the size of a bzip2 block (100K times the level). Up to N chunks
+ * are compressed at the same time, each into a complete bzip2
+ * stream of its own, and the results are written in order. bzip2
+ * blocks do not depend on each other anyway, and a sequence of
+ * streams is decompressed by bunzip2, and by the decompressor below,
+ * as if it were a single stream.
+ */
+
+typedef struct _CompressJob_ {
+  unsigned char* in;		/* Chunk to compress (not owned) */
+  int            inLen;
+  int            level;
+
+  bz_stream      state;		/* Kept for the error message */
+  unsigned char* out;		/* Compressed chunk, owned by the job */
+  int            outSize;	/* Allocated size of 'out' */
+  int            outLen;	/* Used size of 'out' */
+  int            res;		/* BZ_OK, or bzlib error code */
+} CompressJob;
+
+typedef struct _ParallelBz2_ {
+  int            threads;
+  int            chunk;		/* Size of the chunks */
+  int            level;
+  unsigned char* buffer;	/* Space for 'threads' chunks of input */
+  int            inLen;		/* Bytes of input waiting for compression */
+  int            written;	/* Boolean. Set after a stream was written */
+  CompressJob*   jobs;		/* 'threads' job descriptions */
+} ParallelBz2;
+
+/*
+ * Parallel decompression (-threads N, immediate mode only). The
+ * blocks of a bzip2 stream are located by searching for the 48 bit
+ * block magic, at any bit offset. Each block is copied into a
+ * stream of its own (header, block, end of stream marker, and the
+ * block CRC as the combined CRC of that stream). Up to N of these
+ * are decompressed at the same time, which also checks the block
+ * CRC, and the results are written in order. The combined CRC of
+ * the original stream is checked as well.
+ *
+ * The magic can occur by chance inside of a block. Such a false
+ * boundary makes the decompression of both halves fail, they are
+ * then joined and decompressed again. This is done only while the
+ * joined block is not larger than any block of the stream's level
+ * can be, i.e. 100000 bytes of input per level, generously expanded
+ * for incompressible data, plus tables. Beyond that the data is
+ * corrupt, and the error is reported immediately, instead of joining
+ * every block after it.
+ */
+
+#define BLOCK_MAGIC  ((Tcl_WideUInt) 0x314159265359)
+#define END_MAGIC    ((Tcl_WideUInt) 0x177245385090)
+#define MAGIC_MASK   ((Tcl_WideUInt) 0xffffffffffff)
+
+#define BLOCK_LIMIT(level) (8 * ((level) * 125000 + KILO)) /* in bits */
+
+typedef struct _BlockJob_ {
+  int            end;		/* Boolean. The job is the end of a stream,
+				 * 'crc' its combined CRC. Not decoded */
+  int            start;		/* Range of the block in the input, */
+  int            stop;		/* in bits */
+  unsigned int   crc;		/* CRC of the block, from its header */
+  int            level;		/* Level of the containing stream */
+  int            held;		/* Boolean. Decompression failed, waiting
+				 * for the next block to join it with */
+
+  bz_stream      state;		/* Kept for the error message */
+  unsigned char* out;		/* Decompressed block, owned by the job */
+  int            outSize;	/* Allocated size of 'out' */
+  int            outLen;	/* Used size of 'out' */
+  int            res;		/* BZ_OK, or bzlib error code */
+  unsigned char* in;		/* Input containing the block (not owned) */
+} BlockJob;
+
+typedef struct _BlocksBz2_ {
+  int            threads;
+  unsigned char* in;		/* Input not completely decoded yet */
+  int            inLen;
+  int            inSize;	/* Allocated size of 'in' */
+  int            pos;		/* Next item to parse, in bits */
+  int            scan;		/* Search for the next magic starts here,
+				 * in bits */
+  int            inStream;	/* Boolean. Set between the header and the
+				 * end of a stream */
+  int            level;		/* Level of the current stream */
+  int            streams;	/* Number of streams parsed */
+  int            stop;		/* Boolean. Set if the data following the
+				 * last stream is not a stream */
+  unsigned int   combined;	/* Combined CRC of the blocks written */
+
+  BlockJob*      jobs;		/* Blocks and stream ends, in order */
+  int            numJobs;
+  int            numBlocks;	/* Number of blocks in 'jobs' */
+  int            allocJobs;	/* Allocated size of 'jobs' */
+} BlocksBz2;
 
 
 /*
@@ -168,7 +314,10 @@ TrfInit_BZ2 (interp)
 Tcl_Interp* interp;
 {
   TrfLock; /* THREADING: serialize initialization */
-  convDefinition.options = TrfBZ2Options ();
+  if (convDefinition.options == (Trf_OptionVectors*) NULL) {
+    TrfRegisterConvertBudget (&convDefinition.decoder, DecodeBudget);
+    convDefinition.options = TrfBZ2Options ();
+  }
   TrfUnlock;
 
   return Trf_Register (interp, &convDefinition);
@@ -208,6 +357,11 @@ ClientData     clientData;
   c = (EncoderControl*) ckalloc (sizeof (EncoderControl));
   c->write           = fun;
   c->writeClientData = writeClientData;
+  c->par             = ParallelCreate (o);
+
+  if (c->par != (ParallelBz2*) NULL) {
+    return (ClientData) c;
+  }
 
   /* initialize conversion specific items here (BZ2) */
 
@@ -215,13 +369,6 @@ ClientData     clientData;
   c->state.bzfree  = NULL;
   c->state.opaque = NULL;
 
-  c->output_buffer = (char*) ckalloc (OUT_SIZE);
-
-  if (c->output_buffer == (char*) NULL) {
-    ckfree ((VOID*) c);
-    return (ClientData) NULL;
-  }
-
   res = bz.bcompressInit (&c->state, o->level, 0, 0);
 
   if (res != BZ_OK) {
@@ -229,7 +376,6 @@ ClientData     clientData;
       Bz2libError (interp, &c->state, res, "compressor/init");
     }
 
-    ckfree ((VOID*) c->output_buffer);
     ckfree ((VOID*) c);
     return (ClientData) NULL;
   }
@@ -264,8 +410,11 @@ ClientData clientData;
 
   /* release conversion specific items here (BZ2) */
 
-  bz.bcompressEnd (&c->state);
-  ckfree ((char*) c->output_buffer);
+  if (c->par != (ParallelBz2*) NULL) {
+    ParallelDelete (c->par);
+  } else {
+    bz.bcompressEnd (&c->state);
+  }
   ckfree ((char*) c);
 }
 
@@ -300,15 +449,21 @@ ClientData clientData;
   /* execute conversion specific code here (BZ2) */
 
   char in;
+  unsigned char* out;
   int res;
 
   in = character;
 
+  if (c->par != (ParallelBz2*) NULL) {
+    return ParallelWrite (c, (unsigned char*) &in, 1, interp);
+  }
+
   c->state.next_in   = (unsigned char*) (Bytef*) &in;
   c->state.avail_in  = 1;
 
   for (;;) {
-    c->state.next_out  = (unsigned char*) (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (char*) out;
     c->state.avail_out = OUT_SIZE;
 
     res = bz.bcompress (&c->state, BZ_RUN);
@@ -321,8 +476,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	return res;
       }
@@ -370,13 +525,19 @@ ClientData clientData;
   EncoderControl* c = (EncoderControl*) ctrlBlock;
 
   /* execute conversion specific code here (BZ2) */
+  unsigned char* out;
   int res;
 
+  if (c->par != (ParallelBz2*) NULL) {
+    return ParallelWrite (c, buffer, bufLen, interp);
+  }
+
   c->state.next_in   = (unsigned char*) (Bytef*) buffer;
   c->state.avail_in  = bufLen;
 
   for (;;) {
-    c->state.next_out  = (unsigned char*) (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (char*) out;
     c->state.avail_out = OUT_SIZE;
 
     res = bz.bcompress (&c->state, BZ_RUN);
@@ -389,8 +550,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	return res;
       }
@@ -436,13 +597,21 @@ ClientData clientData;
   EncoderControl* c = (EncoderControl*) ctrlBlock;
 
   /* execute conversion specific code here (BZ2) */
+  unsigned char* out;
   int res;
 
+  if (c->par != (ParallelBz2*) NULL) {
+    res = ParallelCompress (c, interp);
+    ParallelClear (c->par);
+    return res;
+  }
+
   c->state.next_in   = (unsigned char*) (Bytef*) NULL;
   c->state.avail_in  = 0;
 
   for (;;) {
-    c->state.next_out  = (unsigned char*) (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (char*) out;
     c->state.avail_out = OUT_SIZE;
 
     res = bz.bcompress (&c->state, BZ_FINISH);
@@ -455,8 +624,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	return res;
       }
@@ -494,11 +663,15 @@ ClearEncoder (ctrlBlock, clientData)
 Trf_ControlBlock ctrlBlock;
 ClientData clientData;
 {
-  /* EncoderControl* c = (EncoderControl*) ctrlBlock; */
+  EncoderControl* c = (EncoderControl*) ctrlBlock;
 
   /* execute conversion specific code here (BZ2) */
 
   /* bz.bcompressReset (&c->state); */
+
+  if (c->par != (ParallelBz2*) NULL) {
+    ParallelClear (c->par);
+  }
 }
 
 /*
@@ -529,11 +702,22 @@ Tcl_Interp*    interp;
 ClientData     clientData;
 {
   DecoderControl*    c;
+  TrfBz2OptionBlock* o = (TrfBz2OptionBlock*) optInfo;
   int res;
 
   c = (DecoderControl*) ckalloc (sizeof (DecoderControl));
   c->write           = fun;
   c->writeClientData = writeClientData;
+  c->keep            = (unsigned char*) NULL;
+  c->keepLen         = 0;
+  c->keepSize        = 0;
+  c->streams         = 0;
+  c->stop            = 0;
+  c->par             = BlocksCreate (o);
+
+  if (c->par != (BlocksBz2*) NULL) {
+    return (ClientData) c;
+  }
 
   /* initialize conversion specific items here (BZ2) */
 
@@ -541,13 +725,6 @@ ClientData     clientData;
   c->state.bzfree  = NULL;
   c->state.opaque = NULL;
 
-  c->output_buffer = (char*) ckalloc (OUT_SIZE);
-
-  if (c->output_buffer == (char*) NULL) {
-    ckfree ((VOID*) c);
-    return (ClientData) NULL;
-  }
-
   res = bz.bdecompressInit (&c->state, 0, 0);
 
   if (res != BZ_OK) {
@@ -555,7 +732,6 @@ ClientData     clientData;
       Bz2libError (interp, &c->state, res, "decompressor/init");
     }
 
-    ckfree ((VOID*) c->output_buffer);
     ckfree ((VOID*) c);
     return (ClientData) NULL;
   }
@@ -592,9 +768,16 @@ ClientData clientData;
 
   /* release conversion specific items here (BZ2) */
 
-  bz.bdecompressEnd (&c->state);
+  if (c->par != (BlocksBz2*) NULL) {
+    BlocksDelete (c->par);
+  } else {
+    bz.bdecompressEnd (&c->state);
+  }
+
+  if (c->keep != (unsigned char*) NULL) {
+    ckfree ((char*) c->keep);
+  }
 
-  ckfree ((char*) c->output_buffer);
   ckfree ((char*) c);
 }
 
@@ -628,45 +811,17 @@ ClientData clientData;
 
   /* execute conversion specific code here (BZ2) */
   char in;
-  int res;
 
   in = character;
 
-  c->state.next_in   = (unsigned char*) (Bytef*) &in;
-  c->state.avail_in  = 1;
-
-  for (;;) {
-    c->state.next_out  = (unsigned char*) (Bytef*) c->output_buffer;
-    c->state.avail_out = OUT_SIZE;
-
-    res = bz.bdecompress (&c->state);
-    c->lastRes = res;
-
-    if ((res < BZ_OK) && (res != BZ_STREAM_END)) {
-      if (interp) {
-	Bz2libError (interp, &c->state, res, "decompressor");
-      }
-      return TCL_ERROR;
-    }
-
-    if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
-      if (res != TCL_OK) {
-	return res;
-      }
-    }
-
-    if (c->state.avail_in > 0)
-      continue;
-
-    if ((c->state.avail_out == 0) && (res == BZ_OK))
-      continue;
-
-    break;
+  if (c->par != (BlocksBz2*) NULL) {
+    return BlocksWrite (c, (unsigned char*) &in, 1, interp);
   }
 
-  return TCL_OK;
+  c->state.next_in   = (char*) &in;
+  c->state.avail_in  = 1;
+
+  return Decompress (c, -1, interp);
 }
 
 /*
@@ -699,18 +854,156 @@ ClientData clientData;
   DecoderControl* c = (DecoderControl*) ctrlBlock;
 
   /* execute conversion specific code here (BZ2) */
-  int res;
 
-  c->state.next_in   = (unsigned char*) (Bytef*) buffer;
+  if (c->par != (BlocksBz2*) NULL) {
+    return BlocksWrite (c, buffer, bufLen, interp);
+  }
+
+  c->state.next_in   = (char*) buffer;
   c->state.avail_in  = bufLen;
 
+  return Decompress (c, -1, interp);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DecodeBudget --
+ *
+ *	------------------------------------------------*
+ *	Decode the given buffer, or the input kept from
+ *	the last call, and write at most 'budget' bytes.
+ *	See 'TrfConvertBudget'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun. Keeps the input
+ *		not decoded yet.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+DecodeBudget (ctrlBlock, buffer, bufLen, budget, pending, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+unsigned char* buffer;
+int bufLen;
+int budget;
+int* pending;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
+  int res;
+
+  if (bufLen > 0) {
+    c->state.next_in  = (char*) buffer;
+    c->state.avail_in = bufLen;
+  } else {
+    c->state.next_in  = (char*) c->keep;
+    c->state.avail_in = c->keepLen;
+  }
+
+  res = Decompress (c, budget, interp);
+
+  /* Keep the unused input. The output budget is exhausted if bzlib
+   * filled the last output buffer, it may hold more output.
+   */
+
+  if ((res != TCL_OK) || c->stop) {
+    c->keepLen = 0;
+    *pending   = 0;
+  } else {
+    if (c->state.avail_in > (unsigned int) c->keepSize) {
+      c->keep     = (unsigned char*) ckrealloc ((char*) c->keep,
+					       c->state.avail_in);
+      c->keepSize = c->state.avail_in;
+    }
+    if (c->state.avail_in > 0) {
+      memmove ((VOID*) c->keep, (VOID*) c->state.next_in, c->state.avail_in);
+    }
+
+    c->keepLen = c->state.avail_in;
+    *pending   = (c->keepLen > 0) ||
+		 ((c->state.avail_out == 0) && (c->lastRes != BZ_STREAM_END));
+  }
+
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Decompress --
+ *
+ *	------------------------------------------------*
+ *	Decompresses the input set into the state and
+ *	writes the result, at most 'budget' bytes, or
+ *	everything for a negative budget.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Decompress (c, budget, interp)
+DecoderControl* c;
+int budget;
+Tcl_Interp* interp;
+{
+  unsigned char* out;
+  int            res, size;
+  unsigned int   avail;
+
   for (;;) {
-    c->state.next_out  = (unsigned char*) (Bytef*) c->output_buffer;
-    c->state.avail_out = OUT_SIZE;
+    if (c->lastRes == BZ_STREAM_END) {
+      /*
+       * More input after the end of a stream is the next stream of a
+       * concatenation (see -threads). Anything else is ignored, like
+       * bunzip2 does.
+       */
+
+      if (c->stop || (c->state.avail_in == 0)) {
+	break;
+      }
+      if (NextStream (c, interp) != TCL_OK) {
+	return TCL_ERROR;
+      }
+    }
+
+    if (budget == 0) {
+      break;
+    }
+
+    size = ((budget < 0) || (budget > OUT_SIZE)) ? OUT_SIZE : budget;
+
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (char*) out;
+    c->state.avail_out = size;
+    avail              = c->state.avail_in;
 
     res = bz.bdecompress (&c->state);
     c->lastRes = res;
 
+    if ((res == BZ_DATA_ERROR_MAGIC) && (c->streams > 0)) {
+      /* Trailing garbage */
+      c->stop              = 1;
+      c->lastRes           = BZ_STREAM_END;
+      c->state.avail_in    = 0;
+      break;
+    }
+
     if ((res < BZ_OK) && (res != BZ_STREAM_END)) {
       if (interp) {
 	Bz2libError (interp, &c->state, res, "decompressor");
@@ -718,18 +1011,33 @@ ClientData clientData;
       return TCL_ERROR;
     }
 
-    if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+    if (res == BZ_STREAM_END) {
+      c->streams ++;
+    }
+
+    if (c->state.avail_out < (unsigned int) size) {
+      if (budget > 0) {
+	budget -= size - c->state.avail_out;
+      }
+
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   size - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	return res;
       }
+    } else if ((budget >= 0) && (c->state.avail_in == avail) &&
+	       (c->lastRes != BZ_STREAM_END)) {
+      /* No progress */
+      break;
     }
 
+    if (c->lastRes == BZ_STREAM_END)
+      continue;
+
     if (c->state.avail_in > 0)
       continue;
 
-    if ((c->state.avail_out == 0) && (res == BZ_OK))
+    if ((c->state.avail_out == 0) && (c->lastRes == BZ_OK))
       continue;
 
     break;
@@ -738,6 +1046,56 @@ ClientData clientData;
   return TCL_OK;
 }
 
+
+/*
+ *------------------------------------------------------*
+ *
+ *	NextStream --
+ *
+ *	------------------------------------------------*
+ *	Reinitializes the decompressor after the end of
+ *	a stream, for the stream following it.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above. The input set into the state
+ *		is kept.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+NextStream (c, interp)
+DecoderControl* c;
+Tcl_Interp*     interp;
+{
+  char*        in    = c->state.next_in;
+  unsigned int avail = c->state.avail_in;
+  int          res;
+
+  bz.bdecompressEnd (&c->state);
+
+  c->state.bzalloc = NULL;
+  c->state.bzfree  = NULL;
+  c->state.opaque  = NULL;
+
+  res = bz.bdecompressInit (&c->state, 0, 0);
+
+  if (res != BZ_OK) {
+    if (interp) {
+      Bz2libError (interp, &c->state, res, "decompressor/init");
+    }
+    return TCL_ERROR;
+  }
+
+  c->state.next_in  = in;
+  c->state.avail_in = avail;
+  c->lastRes        = res;
+  return TCL_OK;
+}
 /*
  *------------------------------------------------------*
  *
@@ -766,20 +1124,29 @@ ClientData clientData;
   DecoderControl* c = (DecoderControl*) ctrlBlock;
 
   /* execute conversion specific code here (BZ2) */
+  unsigned char* out = TrfScratchBuffer ();
   int res;
 
+  if (c->par != (BlocksBz2*) NULL) {
+    if (BlocksParse (c, 1, interp) != TCL_OK) {
+      return TCL_ERROR;
+    }
+    return BlocksRun (c, 1, interp);
+  }
+
   if (c->lastRes == BZ_STREAM_END) {
     /* Essentially already flushed ! */
     return TCL_OK;
   }
 
-  c->state.next_in  = (unsigned char*) (Bytef*) c->output_buffer; /* fake out
+  c->state.next_in  = (char*) out; /* fake out
 								   * 'inflate'
 								   */
   c->state.avail_in = 0;
 
   for (;;) {
-    c->state.next_out  = (unsigned char*) (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (char*) out;
     c->state.avail_out = OUT_SIZE;
 
     res = bz.bdecompress (&c->state);
@@ -792,8 +1159,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	return res;
       }
@@ -831,11 +1198,16 @@ ClearDecoder (ctrlBlock, clientData)
 Trf_ControlBlock ctrlBlock;
 ClientData clientData;
 {
-  /*  DecoderControl* c = (DecoderControl*) ctrlBlock; */
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
 
   /* execute conversion specific code here (BZ2) */
 
   /* bz.bdecompressReset (&c->state); */
+  c->keepLen = 0;
+
+  if (c->par != (BlocksBz2*) NULL) {
+    BlocksClear (c->par);
+  }
 }
 
 /*
@@ -913,3 +1285,1158 @@ CONST char* prefix;
   Tcl_AppendResult (interp, "): ", (char*) NULL);
   Tcl_AppendResult (interp, msg, (char*) NULL);
 }
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelCreate --
+ *
+ *	------------------------------------------------*
+ *	Allocates the state of a parallel compression,
+ *	if the options ask for one.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		A reference to the state, or NULL.
+ *
+ *------------------------------------------------------*
+ */
+
+static ParallelBz2*
+ParallelCreate (o)
+TrfBz2OptionBlock* o;
+{
+  ParallelBz2* p;
+  int          i;
+
+  if (o->threads <= 1) {
+    return (ParallelBz2*) NULL;
+  }
+
+  p = (ParallelBz2*) ckalloc (sizeof (ParallelBz2));
+
+  p->threads = o->threads;
+  p->level   = o->level;
+  p->chunk   = o->level * 100000;
+  p->buffer  = (unsigned char*) ckalloc (p->threads * p->chunk);
+  p->jobs    = (CompressJob*) ckalloc (p->threads * sizeof (CompressJob));
+
+  for (i = 0; i < p->threads; i++) {
+    p->jobs [i].out     = (unsigned char*) NULL;
+    p->jobs [i].outSize = 0;
+  }
+
+  ParallelClear (p);
+  return p;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelDelete --
+ *
+ *	------------------------------------------------*
+ *	Releases the state of a parallel compression.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases memory.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ParallelDelete (p)
+ParallelBz2* p;
+{
+  int i;
+
+  for (i = 0; i < p->threads; i++) {
+    if (p->jobs [i].out != (unsigned char*) NULL) {
+      ckfree ((char*) p->jobs [i].out);
+    }
+  }
+
+  ckfree ((char*) p->jobs);
+  ckfree ((char*) p->buffer);
+  ckfree ((char*) p);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelClear --
+ *
+ *	------------------------------------------------*
+ *	Discards waiting input, i.e. the next data starts
+ *	a new sequence of streams.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ParallelClear (p)
+ParallelBz2* p;
+{
+  p->inLen   = 0;
+  p->written = 0;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	RunJob --
+ *
+ *	------------------------------------------------*
+ *	Compresses a single chunk into a complete stream.
+ *	Executed by the worker threads, and by the thread
+ *	owning the compressor.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates and fills the output buffer of
+ *		the job.
+ *
+ *	Result:
+ *		None. The bzlib result is stored in the job.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+RunJob (j)
+CompressJob* j;
+{
+  int res;
+
+  memset ((VOID*) &j->state, 0, sizeof (bz_stream));
+  j->outLen = 0;
+
+  res = bz.bcompressInit (&j->state, j->level, 0, 0);
+  if (res != BZ_OK) {
+    j->res = res;
+    return;
+  }
+
+  /*
+   * bzip2 expands incompressible data by about 1%, plus 600 bytes
+   * (see its manual). Grow the buffer if even that was not enough.
+   */
+
+  if (j->outSize < (j->inLen + j->inLen / 100 + 600)) {
+    if (j->out != (unsigned char*) NULL) {
+      ckfree ((char*) j->out);
+    }
+    j->outSize = j->inLen + j->inLen / 100 + 600;
+    j->out     = (unsigned char*) ckalloc (j->outSize);
+  }
+
+  j->state.next_in  = (char*) j->in;
+  j->state.avail_in = j->inLen;
+
+  for (;;) {
+    j->state.next_out  = (char*) (j->out + j->outLen);
+    j->state.avail_out = j->outSize - j->outLen;
+
+    res = bz.bcompress (&j->state, BZ_FINISH);
+    j->outLen = j->outSize - j->state.avail_out;
+
+    if (res == BZ_STREAM_END) {
+      res = BZ_OK;
+      break;
+    }
+    if (res < BZ_OK) {
+      break;
+    }
+
+    j->outSize *= 2;
+    j->out = (unsigned char*) ckrealloc ((char*) j->out, j->outSize);
+  }
+
+  bz.bcompressEnd (&j->state);
+  j->res = res;
+}
+
+#ifdef TCL_THREADS
+/*
+ *------------------------------------------------------*
+ *
+ *	CompressWorker --
+ *
+ *	------------------------------------------------*
+ *	Body of the worker threads.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See 'RunJob'.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static Tcl_ThreadCreateType
+CompressWorker (clientData)
+ClientData clientData;
+{
+  RunJob ((CompressJob*) clientData);
+
+  /* Run the exit handlers of the thread, they release its allocator
+   * caches.
+   */
+
+  Tcl_ExitThread (0);
+  TCL_THREAD_CREATE_RETURN;
+}
+#endif
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelCompress --
+ *
+ *	------------------------------------------------*
+ *	Compresses all waiting input, one chunk per
+ *	thread, and writes the resulting streams in
+ *	order.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ParallelCompress (c, interp)
+EncoderControl* c;
+Tcl_Interp*     interp;
+{
+  ParallelBz2* p = c->par;
+  int          n, i, res = TCL_OK;
+#ifdef TCL_THREADS
+  Tcl_ThreadId tid [TRF_MAX_THREADS];
+  int          started [TRF_MAX_THREADS];
+#endif
+
+  n = (p->inLen + p->chunk - 1) / p->chunk;
+  if ((n == 0) && !p->written) {
+    n = 1; /* Empty input still is a stream */
+  }
+
+  for (i = 0; i < n; i++) {
+    CompressJob* j = &p->jobs [i];
+    int        off = i * p->chunk;
+
+    j->in    = p->buffer + off;
+    j->inLen = (i < n-1) ? p->chunk : (p->inLen - off);
+    j->level = p->level;
+    j->res   = BZ_OK;
+  }
+
+  /*
+   * Chunks 1..n-1 go to worker threads, chunk 0 is done here.
+   */
+
+#ifdef TCL_THREADS
+  for (i = 1; i < n; i++) {
+    started [i] = (TCL_OK == Tcl_CreateThread (&tid [i], CompressWorker,
+					       (ClientData) &p->jobs [i],
+					       TCL_THREAD_STACK_DEFAULT,
+					       TCL_THREAD_JOINABLE));
+  }
+#endif
+
+  if (n > 0) {
+    RunJob (&p->jobs [0]);
+  }
+
+  for (i = 1; i < n; i++) {
+#ifdef TCL_THREADS
+    if (started [i]) {
+      int result;
+      Tcl_JoinThread (tid [i], &result);
+      continue;
+    }
+#endif
+    /* No threads, or thread creation failed */
+    RunJob (&p->jobs [i]);
+  }
+
+  for (i = 0; (i < n) && (res == TCL_OK); i++) {
+    CompressJob* j = &p->jobs [i];
+
+    if (j->res != BZ_OK) {
+      if (interp) {
+	Bz2libError (interp, &j->state, j->res, "compressor/parallel");
+      }
+      res = TCL_ERROR;
+      break;
+    }
+
+    res = c->write (c->writeClientData, j->out, j->outLen, interp);
+    p->written = 1;
+  }
+
+  p->inLen = 0;
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelWrite --
+ *
+ *	------------------------------------------------*
+ *	Collects input for a parallel compression, and
+ *	compresses it whenever a chunk is available for
+ *	every thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of 'ParallelCompress'.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ParallelWrite (c, buffer, bufLen, interp)
+EncoderControl* c;
+unsigned char*  buffer;
+int             bufLen;
+Tcl_Interp*     interp;
+{
+  ParallelBz2* p    = c->par;
+  int          size = p->threads * p->chunk;
+  int          n;
+
+  while (bufLen > 0) {
+    n = size - p->inLen;
+    if (n > bufLen) {
+      n = bufLen;
+    }
+
+    memcpy ((VOID*) (p->buffer + p->inLen), (VOID*) buffer, n);
+    p->inLen += n;
+    buffer   += n;
+    bufLen   -= n;
+
+    if (p->inLen == size) {
+      if (ParallelCompress (c, interp) != TCL_OK) {
+	return TCL_ERROR;
+      }
+    }
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	BlocksCreate --
+ *
+ *	------------------------------------------------*
+ *	Allocates the state of a parallel decompression,
+ *	if the options ask for one.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		A reference to the state, or NULL.
+ *
+ *------------------------------------------------------*
+ */
+
+static BlocksBz2*
+BlocksCreate (o)
+TrfBz2OptionBlock* o;
+{
+  BlocksBz2* p;
+
+  if ((o->threads <= 1) || !o->immediate) {
+    return (BlocksBz2*) NULL;
+  }
+
+  p = (BlocksBz2*) ckalloc (sizeof (BlocksBz2));
+
+  p->threads   = o->threads;
+  p->in        = (unsigned char*) NULL;
+  p->inSize    = 0;
+  p->allocJobs = 2 * o->threads;
+  p->jobs      = (BlockJob*) ckalloc (p->allocJobs * sizeof (BlockJob));
+  p->numJobs   = 0;
+
+  BlocksClear (p);
+  return p;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	BlocksDelete --
+ *
+ *	------------------------------------------------*
+ *	Releases the state of a parallel decompression.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases memory.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+BlocksDelete (p)
+BlocksBz2* p;
+{
+  BlocksClear (p);
+
+  if (p->in != (unsigned char*) NULL) {
+    ckfree ((char*) p->in);
+  }
+
+  ckfree ((char*) p->jobs);
+  ckfree ((char*) p);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	BlocksClear --
+ *
+ *	------------------------------------------------*
+ *	Discards waiting input and blocks, i.e. the next
+ *	data starts a new sequence of streams.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+BlocksClear (p)
+BlocksBz2* p;
+{
+  int i;
+
+  for (i = 0; i < p->numJobs; i++) {
+    if (p->jobs [i].out != (unsigned char*) NULL) {
+      ckfree ((char*) p->jobs [i].out);
+    }
+  }
+
+  p->inLen     = 0;
+  p->pos       = 0;
+  p->scan      = 0;
+  p->inStream  = 0;
+  p->level     = 9;
+  p->streams   = 0;
+  p->stop      = 0;
+  p->combined  = 0;
+  p->numJobs   = 0;
+  p->numBlocks = 0;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	GetBits --
+ *
+ *	------------------------------------------------*
+ *	Reads 'n' bits (at most 48), starting at bit
+ *	'pos', most significant bit first, like bzip2
+ *	writes them.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		The bits read.
+ *
+ *------------------------------------------------------*
+ */
+
+static Tcl_WideUInt
+GetBits (in, pos, n)
+unsigned char* in;
+int            pos;
+int            n;
+{
+  Tcl_WideUInt v = 0;
+
+  for (; n > 0; n--, pos++) {
+    v = (v << 1) | ((in [pos >> 3] >> (7 - (pos & 7))) & 1);
+  }
+
+  return v;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PutBits --
+ *
+ *	------------------------------------------------*
+ *	Writes the 'n' lower bits of 'v' at bit '*pos',
+ *	most significant bit first. The area written to
+ *	has to be cleared before.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Advances '*pos'.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+PutBits (out, pos, v, n)
+unsigned char* out;
+int*           pos;
+Tcl_WideUInt   v;
+int            n;
+{
+  for (n--; n >= 0; n--, (*pos)++) {
+    if ((v >> n) & 1) {
+      out [*pos >> 3] |= 0x80 >> (*pos & 7);
+    }
+  }
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	FindMagic --
+ *
+ *	------------------------------------------------*
+ *	Searches the first block or end of stream magic
+ *	starting at or after bit 'from', and ending at
+ *	or before bit 'limit'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		The bit position of the magic, or -1.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+FindMagic (in, from, limit)
+unsigned char* in;
+int            from;
+int            limit;
+{
+  Tcl_WideUInt acc = 0;
+  Tcl_WideUInt w;
+  int          i, k, have = 0, start;
+
+  /*
+   * Every byte shifted into 'acc' completes the 48 bit windows
+   * starting at the 8 bit positions 48 bits before it.
+   */
+
+  for (i = from >> 3; (i + 1) * 8 <= limit; i++) {
+    acc   = (acc << 8) | in [i];
+    have += 8;
+
+    if (have < 48) {
+      continue;
+    }
+
+    for (k = 7; k >= 0; k--) {
+      start = (i + 1) * 8 - 48 - k;
+      if ((start < from) || (have < 48 + k)) {
+	continue;
+      }
+      w = (acc >> k) & MAGIC_MASK;
+      if ((w == BLOCK_MAGIC) || (w == END_MAGIC)) {
+	return start;
+      }
+    }
+  }
+
+  return -1;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	RunBlock --
+ *
+ *	------------------------------------------------*
+ *	Decompresses a single block, after wrapping it
+ *	into a stream of its own. Executed by the worker
+ *	threads, and by the thread owning the
+ *	decompressor.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates and fills the output buffer of
+ *		the job.
+ *
+ *	Result:
+ *		None. The bzlib result is stored in the job.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+RunBlock (j)
+BlockJob* j;
+{
+  unsigned char* stream;
+  unsigned char* src   = j->in + (j->start >> 3);
+  int            shift = j->start & 7;
+  int            bits  = j->stop - j->start;
+  int            n     = (bits + 7) / 8;
+  int            size  = 4 + n + 11;
+  int            i, pos, res;
+
+  /*
+   * Header, the block shifted to a byte boundary, end of stream
+   * marker, combined CRC. The input behind the block is at least a
+   * magic, so reading one byte beyond it is safe.
+   */
+
+  stream = (unsigned char*) ckalloc (size);
+  memset ((VOID*) stream, 0, size);
+
+  stream [0] = 'B';
+  stream [1] = 'Z';
+  stream [2] = 'h';
+  stream [3] = '0' + j->level;
+
+  for (i = 0; i < n; i++) {
+    stream [4 + i] = shift ?
+      ((src [i] << shift) | (src [i+1] >> (8 - shift))) : src [i];
+  }
+  if (bits & 7) {
+    stream [4 + n - 1] &= 0xff << (8 - (bits & 7));
+  }
+
+  pos = 32 + bits;
+  PutBits (stream, &pos, END_MAGIC, 48);
+  PutBits (stream, &pos, (Tcl_WideUInt) j->crc, 32);
+
+  memset ((VOID*) &j->state, 0, sizeof (bz_stream));
+  j->outLen = 0;
+
+  res = bz.bdecompressInit (&j->state, 0, 0);
+  if (res != BZ_OK) {
+    ckfree ((char*) stream);
+    j->res = res;
+    return;
+  }
+
+  if (j->out == (unsigned char*) NULL) {
+    j->outSize = j->level * 100000 + KILO;
+    j->out     = (unsigned char*) ckalloc (j->outSize);
+  }
+
+  j->state.next_in  = (char*) stream;
+  j->state.avail_in = (pos + 7) / 8;
+
+  for (;;) {
+    j->state.next_out  = (char*) (j->out + j->outLen);
+    j->state.avail_out = j->outSize - j->outLen;
+
+    res = bz.bdecompress (&j->state);
+    j->outLen = j->outSize - j->state.avail_out;
+
+    if (res == BZ_STREAM_END) {
+      res = BZ_OK;
+      break;
+    }
+    if (res < BZ_OK) {
+      break;
+    }
+    if (j->state.avail_out > 0) {
+      /* All input used, and still no end */
+      res = BZ_UNEXPECTED_EOF;
+      break;
+    }
+
+    j->outSize *= 2;
+    j->out = (unsigned char*) ckrealloc ((char*) j->out, j->outSize);
+  }
+
+  bz.bdecompressEnd (&j->state);
+  ckfree ((char*) stream);
+  j->res = res;
+}
+
+#ifdef TCL_THREADS
+/*
+ *------------------------------------------------------*
+ *
+ *	BlockWorker --
+ *
+ *	------------------------------------------------*
+ *	Body of the worker threads.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See 'RunBlock'.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static Tcl_ThreadCreateType
+BlockWorker (clientData)
+ClientData clientData;
+{
+  RunBlock ((BlockJob*) clientData);
+
+  /* Run the exit handlers of the thread, they release its allocator
+   * caches.
+   */
+
+  Tcl_ExitThread (0);
+  TCL_THREAD_CREATE_RETURN;
+}
+#endif
+
+/*
+ *------------------------------------------------------*
+ *
+ *	BlocksWrite --
+ *
+ *	------------------------------------------------*
+ *	Collects input for a parallel decompression, and
+ *	decompresses whenever a block was found for
+ *	every thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of 'BlocksParse'.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+BlocksWrite (c, buffer, bufLen, interp)
+DecoderControl* c;
+unsigned char*  buffer;
+int             bufLen;
+Tcl_Interp*     interp;
+{
+  BlocksBz2* p = c->par;
+
+  if (p->stop) {
+    return TCL_OK;
+  }
+
+  if (p->inLen + bufLen > p->inSize) {
+    p->inSize = 2 * (p->inLen + bufLen);
+    p->in     = (unsigned char*) ckrealloc ((char*) p->in, p->inSize);
+  }
+
+  memcpy ((VOID*) (p->in + p->inLen), (VOID*) buffer, bufLen);
+  p->inLen += bufLen;
+
+  return BlocksParse (c, 0, interp);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	BlocksParse --
+ *
+ *	------------------------------------------------*
+ *	Splits the collected input into blocks and stream
+ *	ends, and decompresses them whenever a block was
+ *	found for every thread. With 'final' set there
+ *	is no more input, incomplete streams are errors.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of 'BlocksRun'.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+BlocksParse (c, final, interp)
+DecoderControl* c;
+int             final;
+Tcl_Interp*     interp;
+{
+  BlocksBz2*     p = c->par;
+  unsigned char* in;
+  BlockJob*      j;
+  Tcl_WideUInt   magic;
+  int            avail, at, q, err;
+
+  for (;;) {
+    in    = p->in;
+    avail = p->inLen * 8;
+    err   = BZ_OK;
+
+    if (p->stop) {
+      break;
+    }
+
+    if (!p->inStream) {
+      /* Streams start at a byte boundary */
+      at     = (p->pos + 7) / 8;
+      p->pos = at * 8;
+
+      if (p->inLen - at < 4) {
+	if (final && (p->streams == 0) && (p->inLen > at)) {
+	  err = BZ_UNEXPECTED_EOF;
+	  goto error;
+	}
+	break;
+      }
+
+      if ((in [at] != 'B') || (in [at+1] != 'Z') || (in [at+2] != 'h') ||
+	  (in [at+3] < '1') || (in [at+3] > '9')) {
+	if (p->streams > 0) {
+	  /* Trailing garbage, ignored like bunzip2 does */
+	  p->stop = 1;
+	  break;
+	}
+	err = BZ_DATA_ERROR_MAGIC;
+	goto error;
+      }
+
+      p->level    = in [at+3] - '0';
+      p->pos     += 32;
+      p->scan     = p->pos;
+      p->inStream = 1;
+      continue;
+    }
+
+    if (avail - p->pos < 80) {
+      /* Not enough for the magic and the CRC following it */
+      if (final) {
+	err = BZ_UNEXPECTED_EOF;
+	goto error;
+      }
+      break;
+    }
+
+    magic = GetBits (in, p->pos, 48);
+
+    if (magic == END_MAGIC) {
+      if (p->numJobs == p->allocJobs) {
+	p->allocJobs *= 2;
+	p->jobs = (BlockJob*) ckrealloc ((char*) p->jobs,
+					 p->allocJobs * sizeof (BlockJob));
+      }
+      j = &p->jobs [p->numJobs];
+      p->numJobs ++;
+
+      j->end   = 1;
+      j->held  = 0;
+      j->crc   = (unsigned int) GetBits (in, p->pos + 48, 32);
+      j->out   = (unsigned char*) NULL;
+      j->start = j->stop = p->pos;
+
+      p->pos     += 80;
+      p->inStream = 0;
+      p->streams ++;
+      continue;
+    }
+
+    if (magic != BLOCK_MAGIC) {
+      err = BZ_DATA_ERROR;
+      goto error;
+    }
+
+    if (p->scan < p->pos + 48) {
+      p->scan = p->pos + 48;
+    }
+
+    q = FindMagic (in, p->scan, avail);
+
+    if (q < 0) {
+      /* The block is not complete yet */
+      if (final) {
+	err = BZ_UNEXPECTED_EOF;
+	goto error;
+      }
+      if (avail - 47 > p->scan) {
+	p->scan = avail - 47;
+      }
+      break;
+    }
+
+    if ((p->numJobs > 0) && p->jobs [p->numJobs-1].held) {
+      /*
+       * The last block failed to decompress at its end, join it with
+       * this one. See 'BlocksRun'.
+       */
+
+      j = &p->jobs [p->numJobs-1];
+
+      if (q - j->start > BLOCK_LIMIT (j->level)) {
+	err = j->res;
+	goto error;
+      }
+
+      j->stop = q;
+      j->held = 0;
+    } else {
+      if (p->numJobs == p->allocJobs) {
+	p->allocJobs *= 2;
+	p->jobs = (BlockJob*) ckrealloc ((char*) p->jobs,
+					 p->allocJobs * sizeof (BlockJob));
+      }
+      j = &p->jobs [p->numJobs];
+      p->numJobs ++;
+      p->numBlocks ++;
+
+      j->end   = 0;
+      j->held  = 0;
+      j->start = p->pos;
+      j->stop  = q;
+      j->crc   = (unsigned int) GetBits (in, p->pos + 48, 32);
+      j->level = p->level;
+      j->out   = (unsigned char*) NULL;
+    }
+
+    p->pos  = q;
+    p->scan = q + 48;
+
+    if (p->numBlocks == p->threads) {
+      if (BlocksRun (c, 0, interp) != TCL_OK) {
+	return TCL_ERROR;
+      }
+    }
+  }
+
+  return TCL_OK;
+
+ error:
+  if (interp) {
+    Bz2libError (interp, (bz_stream*) NULL, err, "decompressor/parallel");
+  }
+  BlocksClear (p);
+  p->stop = 1;
+  return TCL_ERROR;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	BlocksRun --
+ *
+ *	------------------------------------------------*
+ *	Decompresses the waiting blocks, one block per
+ *	thread, and writes the results in order. A block
+ *	failing to decompress is joined with the block
+ *	after it, and tried again. Without 'final' the
+ *	last block may be kept waiting for the next.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun. Drops the input
+ *		of the blocks written.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+BlocksRun (c, final, interp)
+DecoderControl* c;
+int             final;
+Tcl_Interp*     interp;
+{
+  BlocksBz2* p = c->par;
+  BlockJob*  run [TRF_MAX_THREADS];
+  BlockJob*  j;
+  int        n = 0, i, k, keep, res = TCL_OK;
+#ifdef TCL_THREADS
+  Tcl_ThreadId tid [TRF_MAX_THREADS];
+  int          started [TRF_MAX_THREADS];
+#endif
+
+  for (i = 0; i < p->numJobs; i++) {
+    j = &p->jobs [i];
+    if (!j->end && !j->held) {
+      j->in    = p->in;
+      run [n++] = j;
+    }
+  }
+
+  /*
+   * Blocks 1..n-1 go to worker threads, block 0 is done here.
+   */
+
+#ifdef TCL_THREADS
+  for (i = 1; i < n; i++) {
+    started [i] = (TCL_OK == Tcl_CreateThread (&tid [i], BlockWorker,
+					       (ClientData) run [i],
+					       TCL_THREAD_STACK_DEFAULT,
+					       TCL_THREAD_JOINABLE));
+  }
+#endif
+
+  if (n > 0) {
+    RunBlock (run [0]);
+  }
+
+  for (i = 1; i < n; i++) {
+#ifdef TCL_THREADS
+    if (started [i]) {
+      int result;
+      Tcl_JoinThread (tid [i], &result);
+      continue;
+    }
+#endif
+    /* No threads, or thread creation failed */
+    RunBlock (run [i]);
+  }
+
+  i = 0;
+  while (i < p->numJobs) {
+    j = &p->jobs [i];
+
+    if (j->end) {
+      if (j->crc != p->combined) {
+	if (interp) {
+	  Bz2libError (interp, &j->state, BZ_DATA_ERROR,
+		       "decompressor/parallel");
+	}
+	res = TCL_ERROR;
+	break;
+      }
+      p->combined = 0;
+      i ++;
+      continue;
+    }
+
+    if (!j->held && (j->res == BZ_OK)) {
+      res = c->write (c->writeClientData, j->out, j->outLen, interp);
+
+      p->combined = ((p->combined << 1) | (p->combined >> 31)) ^ j->crc;
+      ckfree ((char*) j->out);
+      j->out = (unsigned char*) NULL;
+      i ++;
+
+      if (res != TCL_OK) {
+	break;
+      }
+      continue;
+    }
+
+    if ((i+1 < p->numJobs) && !p->jobs [i+1].end &&
+	(p->jobs [i+1].stop - j->start <= BLOCK_LIMIT (j->level))) {
+      /* Possibly a false boundary. Join with the next block, retry. */
+
+      j->stop = p->jobs [i+1].stop;
+      j->held = 0;
+      if (p->jobs [i+1].out != (unsigned char*) NULL) {
+	ckfree ((char*) p->jobs [i+1].out);
+      }
+      memmove ((VOID*) (p->jobs + i + 1), (VOID*) (p->jobs + i + 2),
+	       (p->numJobs - i - 2) * sizeof (BlockJob));
+      p->numJobs --;
+      p->numBlocks --;
+
+      RunBlock (j);
+      continue;
+    }
+
+    if ((i+1 < p->numJobs) || final ||
+	(p->pos - j->start > BLOCK_LIMIT (j->level))) {
+      /* Corrupt, or at the end of the input. */
+
+      if (interp) {
+	Bz2libError (interp, &j->state, j->res, "decompressor/parallel");
+      }
+      res = TCL_ERROR;
+      break;
+    }
+
+    /* Wait for the next block */
+    j->held = 1;
+    if (j->out != (unsigned char*) NULL) {
+      ckfree ((char*) j->out);
+      j->out = (unsigned char*) NULL;
+    }
+    break;
+  }
+
+  if (res != TCL_OK) {
+    BlocksClear (p);
+    p->stop = 1;
+    return res;
+  }
+
+  /*
+   * Drop the jobs done, and the input before the held block, or
+   * before the next item to parse.
+   */
+
+  memmove ((VOID*) p->jobs, (VOID*) (p->jobs + i),
+	   (p->numJobs - i) * sizeof (BlockJob));
+  p->numJobs  -= i;
+  p->numBlocks = p->numJobs;
+
+  keep = ((p->numJobs > 0) ? p->jobs [0].start : p->pos) / 8;
+
+  if (keep > 0) {
+    memmove ((VOID*) p->in, (VOID*) (p->in + keep), p->inLen - keep);
+    p->inLen -= keep;
+    p->pos   -= keep * 8;
+    p->scan  -= keep * 8;
+
+    for (k = 0; k < p->numJobs; k++) {
+      p->jobs [k].start -= keep * 8;
+      p->jobs [k].stop  -= keep * 8;
+    }
+  }
+
+  return TCL_OK;
+}
@@ -115,12 +115,14 @@ static Trf_Options
 CreateOptions (clientData)
 ClientData clientData;
 {
-  TrfZipOptionBlock* o;
+  TrfBz2OptionBlock* o;
 
-  o = (TrfZipOptionBlock*) ckalloc (sizeof (TrfZipOptionBlock));
+  o = (TrfBz2OptionBlock*) ckalloc (sizeof (TrfBz2OptionBlock));
 
-  o->mode  = TRF_UNKNOWN_MODE;
-  o->level = 9;
+  o->mode    = TRF_UNKNOWN_MODE;
+  o->level   = 9;
+  o->threads = 1;
+  o->immediate = 0;
 
   return (Trf_Options) o;
 }
@@ -178,7 +180,7 @@ Tcl_Interp*            interp;
 CONST Trf_BaseOptions* baseOptions;
 ClientData             clientData;
 {
-  TrfZipOptionBlock* o = (TrfZipOptionBlock*) options;
+  TrfBz2OptionBlock* o = (TrfBz2OptionBlock*) options;
 
   /*
    * 'bz2' is used, therefore load the required library.
@@ -198,6 +200,7 @@ ClientData             clientData;
       Tcl_AppendResult (interp, "-mode option not set", (char*) NULL);
       return TCL_ERROR;
     }
+    o->immediate = 1;
   } else /* ATTACH */ {
     if (o->mode == TRF_UNKNOWN_MODE) {
       o->mode = TRF_COMPRESS;
@@ -239,9 +242,10 @@ ClientData  clientData;
    * -level <number>
    * -level default
    * -mode compress|decompress
+   * -threads <number>
    */
 
-  TrfZipOptionBlock* o = (TrfZipOptionBlock*) options;
+  TrfBz2OptionBlock* o = (TrfBz2OptionBlock*) options;
   int              len = strlen (optname + 1);
   CONST char*      value;
 
@@ -310,6 +314,28 @@ ClientData  clientData;
     } /* switch optvalue */
     break;
 
+  case 't':
+    if (0 != strncmp (optname, "-threads", len))
+      goto unknown_option;
+
+    {
+      int  val;
+      char buf [50];
+
+      if (TCL_OK != Tcl_GetIntFromObj (interp, (Tcl_Obj*) optvalue, &val)) {
+	return TCL_ERROR;
+      }
+
+      if ((val < 1) || (val > TRF_MAX_THREADS)) {
+	sprintf (buf, "1..%d", TRF_MAX_THREADS);
+	Tcl_AppendResult (interp, "threads out of range ", buf, (char*) NULL);
+	return TCL_ERROR;
+      }
+
+      o->threads = val;
+    }
+    break;
+
   default:
     goto unknown_option;
     break;
@@ -320,7 +346,7 @@ ClientData  clientData;
  unknown_option:
   Tcl_AppendResult (interp, "unknown option '", (char*) NULL);
   Tcl_AppendResult (interp, optname, (char*) NULL);
-  Tcl_AppendResult (interp, "', should be '-level' or '-mode'", (char*) NULL);
+  Tcl_AppendResult (interp, "', should be '-level', '-mode' or '-threads'", (char*) NULL);
   return TCL_ERROR;
 }
 
@@ -350,7 +376,7 @@ QueryOptions (options, clientData)
 Trf_Options options;
 ClientData  clientData;
 {
-  TrfZipOptionBlock* o = (TrfZipOptionBlock*) options;
+  TrfBz2OptionBlock* o = (TrfBz2OptionBlock*) options;
 
   return (o->mode == TRF_COMPRESS ? 1 : 0);
 }
@@ -24,6 +24,7 @@
 #endif /* BZ2_LIB_NAME */
 
 
+#ifndef BZLIB_STATIC_BUILD
 static char* symbols [] = {
   "BZ2_bzCompress",
   "BZ2_bzCompressEnd",
@@ -39,18 +40,15 @@ static char* symbols [] = {
  * Global variable containing the vectors into the 'bz2'-library.
  */
 
-#ifdef BZLIB_STATIC_BUILD
-bzFunctions bz = {
-  0,
-  bzCompress,
-  bzCompressEnd,
-  bzCompressInit,
-  bzDecompress,
-  bzDecompressEnd,
-  bzDecompressInit,
-};
-#else
 bzFunctions bz = {0}; /* THREADING: serialize initialization */
+
+/*
+ * Set after the library was loaded successfully. Later calls of
+ * 'TrfLoadBZ2lib' only check it, under the lock, and do not load the
+ * library again.
+ */
+
+static int bzLoaded = 0; /* THREADING: read and set under the lock */
 #endif
 
 
@@ -63,7 +61,16 @@ TrfLoadBZ2lib (interp)
 
   TrfLock; /* THREADING: serialize initialization */
 
+  if (bzLoaded) {
+    TrfUnlock;
+    return TCL_OK;
+  }
+
+
   res = Trf_LoadLibrary (interp, BZ2_LIB_NAME, (VOID**) &bz, symbols, 6);
+  if (res == TCL_OK) {
+    bzLoaded = 1;
+  }
   TrfUnlock;
 
   return res;
@@ -66,13 +66,76 @@ static Trf_MessageDigestDescription mdDescription = {
 };
 
 /*
- * Additional declarations
+ * Lookup table for crc calculation, for polynomial PRZCRC. Computed
+ * by the 'mk_crctbl' procedure of PGP.
  */
 
-static crcword CrcTable [256]; /* THREADING: serialize initialization */
-
-static void
-GenCrcLookupTable _ANSI_ARGS_ ((crcword polynomial));
+static CONST crcword CrcTable [256] = { /* THREADING: constant, read-only => safe */
+  0x00000000L, 0x00864cfbL, 0x018ad50dL, 0x010c99f6L,
+  0x0393e6e1L, 0x0315aa1aL, 0x021933ecL, 0x029f7f17L,
+  0x07a18139L, 0x0727cdc2L, 0x062b5434L, 0x06ad18cfL,
+  0x043267d8L, 0x04b42b23L, 0x05b8b2d5L, 0x053efe2eL,
+  0x0fc54e89L, 0x0f430272L, 0x0e4f9b84L, 0x0ec9d77fL,
+  0x0c56a868L, 0x0cd0e493L, 0x0ddc7d65L, 0x0d5a319eL,
+  0x0864cfb0L, 0x08e2834bL, 0x09ee1abdL, 0x09685646L,
+  0x0bf72951L, 0x0b7165aaL, 0x0a7dfc5cL, 0x0afbb0a7L,
+  0x1f0cd1e9L, 0x1f8a9d12L, 0x1e8604e4L, 0x1e00481fL,
+  0x1c9f3708L, 0x1c197bf3L, 0x1d15e205L, 0x1d93aefeL,
+  0x18ad50d0L, 0x182b1c2bL, 0x192785ddL, 0x19a1c926L,
+  0x1b3eb631L, 0x1bb8facaL, 0x1ab4633cL, 0x1a322fc7L,
+  0x10c99f60L, 0x104fd39bL, 0x11434a6dL, 0x11c50696L,
+  0x135a7981L, 0x13dc357aL, 0x12d0ac8cL, 0x1256e077L,
+  0x17681e59L, 0x17ee52a2L, 0x16e2cb54L, 0x166487afL,
+  0x14fbf8b8L, 0x147db443L, 0x15712db5L, 0x15f7614eL,
+  0x3e19a3d2L, 0x3e9fef29L, 0x3f9376dfL, 0x3f153a24L,
+  0x3d8a4533L, 0x3d0c09c8L, 0x3c00903eL, 0x3c86dcc5L,
+  0x39b822ebL, 0x393e6e10L, 0x3832f7e6L, 0x38b4bb1dL,
+  0x3a2bc40aL, 0x3aad88f1L, 0x3ba11107L, 0x3b275dfcL,
+  0x31dced5bL, 0x315aa1a0L, 0x30563856L, 0x30d074adL,
+  0x324f0bbaL, 0x32c94741L, 0x33c5deb7L, 0x3343924cL,
+  0x367d6c62L, 0x36fb2099L, 0x37f7b96fL, 0x3771f594L,
+  0x35ee8a83L, 0x3568c678L, 0x34645f8eL, 0x34e21375L,
+  0x2115723bL, 0x21933ec0L, 0x209fa736L, 0x2019ebcdL,
+  0x228694daL, 0x2200d821L, 0x230c41d7L, 0x238a0d2cL,
+  0x26b4f302L, 0x2632bff9L, 0x273e260fL, 0x27b86af4L,
+  0x252715e3L, 0x25a15918L, 0x24adc0eeL, 0x242b8c15L,
+  0x2ed03cb2L, 0x2e567049L, 0x2f5ae9bfL, 0x2fdca544L,
+  0x2d43da53L, 0x2dc596a8L, 0x2cc90f5eL, 0x2c4f43a5L,
+  0x2971bd8bL, 0x29f7f170L, 0x28fb6886L, 0x287d247dL,
+  0x2ae25b6aL, 0x2a641791L, 0x2b688e67L, 0x2beec29cL,
+  0x7c3347a4L, 0x7cb50b5fL, 0x7db992a9L, 0x7d3fde52L,
+  0x7fa0a145L, 0x7f26edbeL, 0x7e2a7448L, 0x7eac38b3L,
+  0x7b92c69dL, 0x7b148a66L, 0x7a181390L, 0x7a9e5f6bL,
+  0x7801207cL, 0x78876c87L, 0x798bf571L, 0x790db98aL,
+  0x73f6092dL, 0x737045d6L, 0x727cdc20L, 0x72fa90dbL,
+  0x7065efccL, 0x70e3a337L, 0x71ef3ac1L, 0x7169763aL,
+  0x74578814L, 0x74d1c4efL, 0x75dd5d19L, 0x755b11e2L,
+  0x77c46ef5L, 0x7742220eL, 0x764ebbf8L, 0x76c8f703L,
+  0x633f964dL, 0x63b9dab6L, 0x62b54340L, 0x62330fbbL,
+  0x60ac70acL, 0x602a3c57L, 0x6126a5a1L, 0x61a0e95aL,
+  0x649e1774L, 0x64185b8fL, 0x6514c279L, 0x65928e82L,
+  0x670df195L, 0x678bbd6eL, 0x66872498L, 0x66016863L,
+  0x6cfad8c4L, 0x6c7c943fL, 0x6d700dc9L, 0x6df64132L,
+  0x6f693e25L, 0x6fef72deL, 0x6ee3eb28L, 0x6e65a7d3L,
+  0x6b5b59fdL, 0x6bdd1506L, 0x6ad18cf0L, 0x6a57c00bL,
+  0x68c8bf1cL, 0x684ef3e7L, 0x69426a11L, 0x69c426eaL,
+  0x422ae476L, 0x42aca88dL, 0x43a0317bL, 0x43267d80L,
+  0x41b90297L, 0x413f4e6cL, 0x4033d79aL, 0x40b59b61L,
+  0x458b654fL, 0x450d29b4L, 0x4401b042L, 0x4487fcb9L,
+  0x461883aeL, 0x469ecf55L, 0x479256a3L, 0x47141a58L,
+  0x4defaaffL, 0x4d69e604L, 0x4c657ff2L, 0x4ce33309L,
+  0x4e7c4c1eL, 0x4efa00e5L, 0x4ff69913L, 0x4f70d5e8L,
+  0x4a4e2bc6L, 0x4ac8673dL, 0x4bc4fecbL, 0x4b42b230L,
+  0x49ddcd27L, 0x495b81dcL, 0x4857182aL, 0x48d154d1L,
+  0x5d26359fL, 0x5da07964L, 0x5cace092L, 0x5c2aac69L,
+  0x5eb5d37eL, 0x5e339f85L, 0x5f3f0673L, 0x5fb94a88L,
+  0x5a87b4a6L, 0x5a01f85dL, 0x5b0d61abL, 0x5b8b2d50L,
+  0x59145247L, 0x59921ebcL, 0x589e874aL, 0x5818cbb1L,
+  0x52e37b16L, 0x526537edL, 0x5369ae1bL, 0x53efe2e0L,
+  0x51709df7L, 0x51f6d10cL, 0x50fa48faL, 0x507c0401L,
+  0x5542fa2fL, 0x55c4b6d4L, 0x54c82f22L, 0x544e63d9L,
+  0x56d11cceL, 0x56575035L, 0x575bc9c3L, 0x57dd8538L
+};
 
 /*
  *------------------------------------------------------*
@@ -96,8 +159,6 @@ int
 TrfInit_CRC (interp)
 Tcl_Interp* interp;
 {
-  GenCrcLookupTable (PRZCRC);
-
   return Trf_RegisterMessageDigest (interp, &mdDescription);
 }
 
@@ -251,42 +312,3 @@ VOID* digest;
   /* -*- PGP -*- */
 }
 
-/*
- * Initialize lookup table for crc calculation.
- */
-
-static void
-GenCrcLookupTable (poly)
-crcword poly;
-{
-  /* -*- PGP -*-, was 'mk_crctbl' */
-  int i;
-  crcword t, *p, *q;
-
-  TrfLock; /* THREADING: serialize initialization */
-
-  p = q = CrcTable;
-
-  *q++ = 0;
-  *q++ = poly;
-
-  for (i = 1; i < 128; i++)
-    {
-      t = *++p;
-      if (t & CRCHIBIT)
-	{
-	  t <<= 1;
-	  *q++ = t ^ poly;
-	  *q++ = t;
-	}
-      else
-	{
-	  t <<= 1;
-	  *q++ = t;
-	  *q++ = t ^ poly;
-	}
-    }
-
-  TrfUnlock;
-  /* -*- PGP -*- */
-}
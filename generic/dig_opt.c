@@ -57,6 +57,10 @@ static int         TargetType _ANSI_ARGS_ ((Tcl_Interp* interp,
 static int         DigestMode _ANSI_ARGS_ ((Tcl_Interp* interp,
 					    CONST char* modeString,
 					    int* mode));
+
+static int         Iterations _ANSI_ARGS_ ((Tcl_Interp* interp,
+					    CONST Tcl_Obj* countObj,
+					    int* count));
 
 /*
  *------------------------------------------------------*
@@ -131,6 +135,8 @@ ClientData clientData;
   o->vInterp		= (Tcl_Interp*) NULL;
   o->rdChannel		= (Tcl_Channel) NULL;
   o->wdChannel		= (Tcl_Channel) NULL;
+  o->iterations		= 1;
+  o->every		= 0;
 
   return (Trf_Options) o;
 }
@@ -218,7 +224,7 @@ ClientData             clientData;
     }
   }
 
-  /* TRF_IMMEDIATE: no options allowed
+  /* TRF_IMMEDIATE: only -iterations and -every allowed
    * TRF_ATTACH:    -mode required
    *                TRF_ABSORB_HASH: -matchflag required (only if channel is read)
    *                TRF_WRITE_HASH:  -write/read-destination required according to
@@ -237,8 +243,21 @@ ClientData             clientData;
       DONE (dig_opt:CheckOptions);
       return TCL_ERROR;
     }
+    if (o->every > o->iterations) {
+      Tcl_AppendResult (interp, "immediate: -every larger than -iterations",
+			(char*) NULL);
+      DONE (dig_opt:CheckOptions);
+      return TCL_ERROR;
+    }
   } else {
     /* ATTACH MODE / FILTER */
+    if ((o->iterations != 1) || (o->every != 0)) {
+      Tcl_AppendResult (interp, "attach: -iterations and -every not allowed",
+			(char*) NULL);
+      DONE (dig_opt:CheckOptions);
+      return TCL_ERROR;
+    }
+
     if (o->mode == TRF_UNKNOWN_MODE) {
       Tcl_AppendResult (interp, "attach: -mode not defined", (char*) NULL);
       DONE (dig_opt:CheckOptions);
@@ -352,6 +371,8 @@ ClientData  clientData;
    *	-matchflag		<varname>
    *	-write-destination	<channel> | <variable>
    *	-read-destination	<channel> | <variable>
+   *	-iterations		<n>	(immediate only)
+   *	-every			<k>	(immediate only)
    */
 
   TrfMDOptionBlock* o = (TrfMDOptionBlock*) options;
@@ -399,6 +420,20 @@ ClientData  clientData;
       goto unknown_option;
     break;
 
+  case 'i':
+    if (0 == strncmp (optname, "-iterations", len)) {
+      return Iterations (interp, optvalue, &o->iterations);
+    } else
+      goto unknown_option;
+    break;
+
+  case 'e':
+    if (0 == strncmp (optname, "-every", len)) {
+      return Iterations (interp, optvalue, &o->every);
+    } else
+      goto unknown_option;
+    break;
+
   case 'r':
     if (len < 7)
       goto unknown_option;
@@ -425,7 +460,7 @@ ClientData  clientData;
   return TCL_OK;
 
  unknown_option:
-  Tcl_AppendResult (interp, "unknown option '", optname, "', should be '-mode', '-matchflag', '-write-destination', '-write-type', '-read-destination' or '-read-type'", (char*) NULL);
+  Tcl_AppendResult (interp, "unknown option '", optname, "', should be '-mode', '-matchflag', '-write-destination', '-write-type', '-read-destination', '-read-type', '-iterations' or '-every'", (char*) NULL);
    
   return TCL_ERROR;
 }
@@ -572,3 +607,47 @@ int*        mode;
 
   return TCL_OK;
 }
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Iterations --
+ *
+ *	------------------------------------------------*
+ *	Converts the argument of -iterations or -every
+ *	into a positive integer.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		May leave an error message in the
+ *		interpreter result area.
+ *
+ *	Result:
+ *		A standard Tcl error code, in case of
+ *		success 'count' is set too.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Iterations (interp, countObj, count)
+Tcl_Interp*    interp;
+CONST Tcl_Obj* countObj;
+int*           count;
+{
+  int n;
+
+  if (TCL_OK != Tcl_GetIntFromObj (interp, (Tcl_Obj*) countObj, &n)) {
+    return TCL_ERROR;
+  }
+
+  if (n < 1) {
+    Tcl_AppendResult (interp, "expected positive count, but got \"",
+		      Tcl_GetStringFromObj ((Tcl_Obj*) countObj, NULL), "\"",
+		      (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  *count = n;
+  return TCL_OK;
+}
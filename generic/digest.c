@@ -131,6 +131,8 @@ typedef struct _EncoderControl_ {
 
   VOID*          context;
 
+  int            iterations;	/* Length of the hash chain (IMMEDIATE) */
+  int            every;		/* 0, or distance between returned chain values */
 
 } EncoderControl;
 
@@ -161,8 +163,13 @@ typedef struct _DecoderControl_ {
   VOID*          context;
   char*          matchFlag;      /* target for ATTACH_ABSORB */
 
+  /* ATTACH_ABSORB only: The last 'charCount' bytes seen so far. They are
+   * the candidates for the transmitted digest and therefore withheld from
+   * both context and output. Always starts at index 0, never holds more
+   * than 'digest_size' bytes.
+   */
+
   unsigned char* digest_buffer;
-  short          buffer_pos;
   unsigned short charCount;
 
 } DecoderControl;
@@ -172,8 +179,21 @@ static int
 WriteDigest _ANSI_ARGS_ ((Tcl_Interp* interp, char* destHandle,
 			  Tcl_Channel dest,   char* digest,
 			  Trf_MessageDigestDescription* md));
+
+static void
+UpdateContext _ANSI_ARGS_ ((Trf_MessageDigestDescription* md,
+			    VOID* context, unsigned char* buffer,
+			    int bufLen));
 
 
+/*
+ * Transformer definitions for the registered message digests, keyed by
+ * their descriptions. Never released.
+ */
+
+static Tcl_HashTable mdTypes;          /* THREADING: serialize access */
+static int           mdTypesInit = 0;  /* THREADING: serialize access */
+
 /*
  *------------------------------------------------------*
  *
@@ -184,7 +204,8 @@ WriteDigest _ANSI_ARGS_ ((Tcl_Interp* interp, char* destHandle,
  *	------------------------------------------------*
  *
  *	Sideeffects:
- *		Allocates memory. As of 'Trf_Register'.
+ *		Allocates memory for the first registration
+ *		of a generator. As of 'Trf_Register'.
  *
  *	Result:
  *		A standard Tcl error code.
@@ -198,18 +219,41 @@ Tcl_Interp*                         interp;
 CONST Trf_MessageDigestDescription* md_desc;
 {
   Trf_TypeDefinition* md;
-  int                res;
+  Tcl_HashEntry*      hPtr;
+  int                 new;
+  int                 res;
 
   START (Trf_RegisterMessageDigest);
 
-  /* THREADING: read-only access => safe */
-  md = (Trf_TypeDefinition*) ckalloc (sizeof (Trf_TypeDefinition));
+  /* The definitions are shared by all interpreters and threads, one
+   * per description.
+   */
+
+  TrfLock; /* THREADING: serialize access */
+
+  if (!mdTypesInit) {
+    Tcl_InitHashTable (&mdTypes, TCL_ONE_WORD_KEYS);
+    mdTypesInit = 1;
+  }
+
+  hPtr = Tcl_CreateHashEntry (&mdTypes, (char*) md_desc, &new);
+
+  if (new) {
+    /* THREADING: read-only access => safe */
+    md = (Trf_TypeDefinition*) ckalloc (sizeof (Trf_TypeDefinition));
+
+    memcpy ((VOID*) md, (VOID*) &mdDefinition, sizeof (Trf_TypeDefinition));
+
+    md->name       = md_desc->name;
+    md->clientData = (ClientData) md_desc;
+    md->options    = TrfMDOptions ();
 
-  memcpy ((VOID*) md, (VOID*) &mdDefinition, sizeof (Trf_TypeDefinition));
+    Tcl_SetHashValue (hPtr, md);
+  } else {
+    md = (Trf_TypeDefinition*) Tcl_GetHashValue (hPtr);
+  }
 
-  md->name       = md_desc->name;
-  md->clientData = (ClientData) md_desc;
-  md->options    = TrfMDOptions ();
+  TrfUnlock;
 
   PRINT ("MD_Desc %p\n", md_desc); FL; IN;
 
@@ -227,9 +271,6 @@ CONST Trf_MessageDigestDescription* md_desc;
 
   res = Trf_Register (interp, md);
 
-  /* 'md' is a memory leak, it will never be released.
-   */
-
   DONE (Trf_RegisterMessageDigest);
   return res;
 }
@@ -307,6 +348,9 @@ ClientData    clientData;
   c->context = (VOID*) ckalloc (md->context_size);
   (*md->startProc) (c->context);
 
+  c->iterations = o->iterations;
+  c->every      = o->every;
+
   DONE (digest.CreateEncoder);
 
   return (ClientData) c;
@@ -422,16 +466,7 @@ ClientData       clientData;
   EncoderControl*                c = (EncoderControl*) ctrlBlock;
   Trf_MessageDigestDescription* md = (Trf_MessageDigestDescription*) clientData;
 
-  if (*md->updateBufProc != (Trf_MDUpdateBuf*) NULL) {
-    (*md->updateBufProc) (c->context, buffer, bufLen);
-  } else {
-    unsigned int character, i;
-
-    for (i=0; i < ((unsigned int) bufLen); i++) {
-      character = buffer [i];
-      (*md->updateProc) (c->context, character);
-    }
-  }
+  UpdateContext (md, c->context, buffer, bufLen);
 
   if ((c->operation_mode == ATTACH_ABSORB) ||
       (c->operation_mode == ATTACH_TRANS)) {
@@ -485,6 +520,38 @@ ClientData       clientData;
   if ((c->operation_mode == ATTACH_WRITE) ||
       (c->operation_mode == ATTACH_TRANS)) {
     res = WriteDigest (c->vInterp, c->destHandle, c->dest, digest, md);
+  } else if ((c->operation_mode == IMMEDIATE) &&
+	     ((c->iterations > 1) || (c->every > 0))) {
+    /*
+     * Immediate execution of a hash chain (-iterations, -every). The
+     * digest is fed back into the context it came from, without
+     * leaving C. For the OTP digests this is the S/KEY fold loop, on
+     * their 8 byte state.
+     */
+
+    int i;
+
+    for (i = 1; ; i++) {
+      if ((c->every > 0) && ((i % c->every) == 0)) {
+	res = c->write (c->writeClientData, (unsigned char*) digest,
+			md->digest_size, interp);
+	if (res != TCL_OK) {
+	  break;
+	}
+      }
+      if (i == c->iterations) {
+	break;
+      }
+
+      (*md->startProc) (c->context);
+      UpdateContext (md, c->context, (unsigned char*) digest, md->digest_size);
+      (*md->finalProc) (c->context, digest);
+    }
+
+    if ((res == TCL_OK) && (c->every == 0)) {
+      res = c->write (c->writeClientData, (unsigned char*) digest,
+		      md->digest_size, interp);
+    }
   } else {
     /*
      * Immediate execution or attached channel absorbing the checksum.
@@ -591,7 +658,6 @@ ClientData    clientData;
     }  
   }
 
-  c->buffer_pos = 0;
   c->charCount  = 0;
 
   c->context = (VOID*) ckalloc (md->context_size);
@@ -664,51 +730,16 @@ unsigned int     character;
 Tcl_Interp*      interp;
 ClientData       clientData;
 {
-  DecoderControl*                c = (DecoderControl*) ctrlBlock;
-  Trf_MessageDigestDescription* md = (Trf_MessageDigestDescription*) clientData;
-  char                         buf;
-
-  if (c->operation_mode == ATTACH_WRITE) {
-    buf = character;
-    (*md->updateProc) (c->context, character);
-
-  } else if (c->operation_mode == ATTACH_TRANS) {
-    buf = character;
-    (*md->updateProc) (c->context, character);
-
-    return c->write (c->writeClientData, (unsigned char*) &buf, 1, interp);
-  } else {
-    if (c->charCount == md->digest_size) {
-      /*
-       * ringbuffer full, forward oldest character
-       * and replace with new one.
-       */
-
-      buf = c->digest_buffer [c->buffer_pos];
-
-      c->digest_buffer [c->buffer_pos] = character;
-      c->buffer_pos ++;
-      c->buffer_pos %= md->digest_size;
-
-      character = buf;
-      (*md->updateProc) (c->context, character);
+  unsigned char buf = character;
 
-      return c->write (c->writeClientData, (unsigned char*) &buf, 1, interp);
-    } else {
-      /*
-       * Fill ringbuffer.
-       */
-
-      c->digest_buffer [c->buffer_pos] = character;
-
-      c->buffer_pos ++;
-      c->charCount  ++;
-    }
-  }
+  /*
+   * A buffer of length 1. This keeps the handling of the withheld digest
+   * in absorb mode in one place.
+   */
 
-  return TCL_OK;
+  return DecodeBuffer (ctrlBlock, &buf, 1, interp, clientData);
 }
-
+
 /*
  *------------------------------------------------------*
  *
@@ -738,157 +769,81 @@ ClientData       clientData;
 {
   DecoderControl*                c = (DecoderControl*) ctrlBlock;
   Trf_MessageDigestDescription* md = (Trf_MessageDigestDescription*) clientData;
+  int n, k, res;
 
   if (c->operation_mode == ATTACH_WRITE) {
-    if (*md->updateBufProc != (Trf_MDUpdateBuf*) NULL) {
-      (*md->updateBufProc) (c->context, buffer, bufLen);
-    } else {
-      int character, i;
-
-      for (i=0; i < bufLen; i++) {
-	character = buffer [i];
-	(*md->updateProc) (c->context, character);
-      }
-    }
+    UpdateContext (md, c->context, buffer, bufLen);
+    return TCL_OK;
 
   } else if (c->operation_mode == ATTACH_TRANS) {
-    if (*md->updateBufProc != (Trf_MDUpdateBuf*) NULL) {
-      (*md->updateBufProc) (c->context, buffer, bufLen);
-    } else {
-      int character, i;
+    UpdateContext (md, c->context, buffer, bufLen);
+    return c->write (c->writeClientData, buffer, bufLen, interp);
+  }
 
-      for (i=0; i < bufLen; i++) {
-	character = buffer [i];
-	(*md->updateProc) (c->context, character);
-      }
-    }
+  /*
+   * ATTACH_ABSORB. The last 'digest_size' bytes of the stream are the
+   * transmitted digest and must not be hashed or forwarded. Only they are
+   * carried across calls, in 'digest_buffer'. Everything in front of them
+   * is hashed and written directly from the place it currently resides
+   * in, i.e. the old tail first, then the incoming buffer.
+   */
 
-    return c->write (c->writeClientData, buffer, bufLen, interp);
+  if ((c->charCount + bufLen) <= md->digest_size) {
+    /* Not enough to decide on anything yet, extend the tail. */
 
-  } else {
-    /* try to use more than character at a time. */
-
-    if (*md->updateBufProc != NULL) {
-
-      /*
-       * 2 cases:
-       *
-       * - Incoming buffer and data stored from previous calls are less
-       *   or just enough to fill the ringbuffer. Copy the incoming bytes
-       *   into the buffer and return.
-       *
-       * - Incoming data + ringbuffer contain more than reqired for a
-       * digest. Concatenate both and use the oldest bytes to update the
-       * hash context. Place the remaining 'digest_size' bytes into the
-       * ringbuffer again.
-       *
-       * Both cases assume the ringbuffer data to be starting at index '0'.
-       */
-
-      if ((c->charCount + bufLen) <= md->digest_size) {
-	/* extend ring buffer */
-
-	memcpy ( (VOID*) (c->digest_buffer + c->charCount), (VOID*) buffer, bufLen);
-	c->charCount += bufLen;
-      } else {
-	/*
-	 * n contains the number of bytes we are allowed to hash into the context.
-	 */
-
-	int n = c->charCount + bufLen - md->digest_size;
-	int res;
-
-	if (c->charCount > 0) {
-	  if (n <= c->charCount) {
-	    /*
-	     * update context, then shift down the remaining bytes
-	     */
-
-	    (*md->updateBufProc) (c->context, c->digest_buffer, n);
-
-	    res = c->write (c->writeClientData, c->digest_buffer, n, interp);
-
-	    memmove ((VOID*) c->digest_buffer,
-		     (VOID*) (c->digest_buffer + n), c->charCount - n);
-	    c->charCount -= n;
-	    n             = 0;
-	  } else {
-	    /*
-	     * Hash everything inside the buffer.
-	     */
-
-	    (*md->updateBufProc) (c->context, c->digest_buffer, c->charCount);
-
-	    res = c->write (c->writeClientData, c->digest_buffer, c->charCount, interp);
-
-	    n -= c->charCount;
-	    c->charCount = 0;
-	  }
-
-	  if (res != TCL_OK)
-	    return res;
-	}
+    memcpy ((VOID*) (c->digest_buffer + c->charCount), (VOID*) buffer, bufLen);
+    c->charCount += bufLen;
+    return TCL_OK;
+  }
 
-	if (n > 0) {
-	  (*md->updateBufProc) (c->context, buffer, n);
+  /*
+   * n = number of bytes which can not be part of the digest anymore.
+   * k = number of them taken from the front of the old tail.
+   */
 
-	  res = c->write (c->writeClientData, buffer, n, interp);
+  n = c->charCount + bufLen - md->digest_size;
+  k = (n < c->charCount) ? n : c->charCount;
 
-	  memcpy ((VOID*) (c->digest_buffer + c->charCount),
-		  (VOID*) (buffer + n),
-		  (bufLen - n));
-	  c->charCount = md->digest_size; /* <=> 'c->charCount += bufLen - n;' */
+  if (k > 0) {
+    UpdateContext (md, c->context, c->digest_buffer, k);
 
-	  if (res != TCL_OK)
-	    return res;
-	}
-      }
-    } else {
-      /*
-       * no 'updateBufProc', simulate it using the
-       * underlying single character routine
-       */
-
-      int character, i, res;
-      char         buf;
-
-      for (i=0; i < bufLen; i++) {
-	buf       = c->digest_buffer [c->buffer_pos];
-	character = buffer [i];
-
-	if (c->charCount == md->digest_size) {
-	  /*
-	   * ringbuffer full, forward oldest character
-	   * and replace with new one.
-	   */
-
-	  c->digest_buffer [c->buffer_pos] = character;
-	  c->buffer_pos ++;
-	  c->buffer_pos %= md->digest_size;
-
-	  character = buf;
-	  (*md->updateProc) (c->context, character);
-
-	  res = c->write (c->writeClientData, (unsigned char*) &buf, 1, interp);
-	  if (res != TCL_OK)
-	    return res;
-	} else {
-	  /*
-	   * Fill ringbuffer.
-	   */
-	
-	  c->digest_buffer [c->buffer_pos] = character;
-
-	  c->buffer_pos ++;
-	  c->charCount  ++;
-	}
-      } /* for */
+    res = c->write (c->writeClientData, c->digest_buffer, k, interp);
+    if (res != TCL_OK) {
+      return res;
     }
+    n -= k;
   }
 
+  if (n > 0) {
+    /*
+     * The old tail is used up completely, the new one is the end of the
+     * incoming buffer.
+     */
+
+    UpdateContext (md, c->context, buffer, n);
+
+    res = c->write (c->writeClientData, buffer, n, interp);
+
+    memcpy ((VOID*) c->digest_buffer, (VOID*) (buffer + n), md->digest_size);
+    c->charCount = md->digest_size;
+
+    return res;
+  }
+
+  /*
+   * The incoming buffer is shorter than a digest. The new tail is the
+   * rest of the old one, followed by the whole buffer.
+   */
+
+  memmove ((VOID*) c->digest_buffer,
+	   (VOID*) (c->digest_buffer + k), c->charCount - k);
+  memcpy  ((VOID*) (c->digest_buffer + c->charCount - k),
+	   (VOID*) buffer, bufLen);
+  c->charCount = md->digest_size; /* <=> 'c->charCount += bufLen - k;' */
+
   return TCL_OK;
 }
-
+
 /*
  *------------------------------------------------------*
  *
@@ -941,26 +896,6 @@ ClientData       clientData;
   } else {
     char* result_text;
 
-    if (c->buffer_pos > 0) {
-      /*
-       * Reorder bytes in ringbuffer to form the correct digest.
-       */
-
-      char* temp;
-      int i,j;
-
-      temp = (char*) ckalloc (md->digest_size);
-
-      for (i= c->buffer_pos, j=0;
-	   j < md->digest_size;
-	   i = (i+1) % md->digest_size, j++) {
-	temp [j] = c->digest_buffer [i];
-      }
-
-      memcpy ((VOID*) c->digest_buffer, (VOID*) temp, md->digest_size);
-      ckfree (temp);
-    }
-
     /*
      * Compare computed and transmitted checksums.
      */
@@ -1001,7 +936,6 @@ ClientData       clientData;
   DecoderControl*                c = (DecoderControl*) ctrlBlock;
   Trf_MessageDigestDescription* md = (Trf_MessageDigestDescription*) clientData;
 
-  c->buffer_pos = 0;
   c->charCount  = 0;
 
   (*md->startProc) (c->context);
@@ -1084,3 +1018,43 @@ Trf_MessageDigestDescription* md;
 
   return TCL_OK;
 }
+
+/*
+ *------------------------------------------------------*
+ *
+ *	UpdateContext --
+ *
+ *	------------------------------------------------*
+ *	Hashes the given buffer into the context, using
+ *	the buffer procedure of the digest, if present.
+ *	All digests coming with Trf have one, the loop
+ *	over the characters is only for digests defined
+ *	by other packages which do not.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Modifies the context.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+UpdateContext (md, context, buffer, bufLen)
+Trf_MessageDigestDescription* md;
+VOID*                         context;
+unsigned char*                buffer;
+int                           bufLen;
+{
+  if (*md->updateBufProc != (Trf_MDUpdateBuf*) NULL) {
+    (*md->updateBufProc) (context, buffer, bufLen);
+  } else {
+    int i;
+
+    for (i=0; i < bufLen; i++) {
+      (*md->updateProc) (context, buffer [i]);
+    }
+  }
+}
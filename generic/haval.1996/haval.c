@@ -243,6 +243,12 @@ static unsigned char padding[128] = {        /* constants for padding */
 }
 
 
+/* aku, Oct 19, 2026: The drivers below are not used by Trf. As the core
+ * is instantiated once per variant (see ../havalvar.c) they are excluded
+ * there.
+ */
+#ifndef HAVAL_NO_DRIVER
+
 /* hash a string */
 void haval_string (string, fingerprint)
     char *string;
@@ -303,6 +309,7 @@ void haval_stdin ()
 }
 
 #endif
+#endif /* HAVAL_NO_DRIVER */
 
 /* initialization */
 void haval_start (state)
@@ -366,9 +373,11 @@ void haval_hash (state, str, str_len)
     memcpy (&state->remainder[rmd_len], str, fill_len);
     ch2uint(state->remainder, state->block, 128);
     haval_hash_block (state);
+    /* aku, Oct 19, 2026: complete blocks are converted directly out of
+     * the buffer of the caller, without going through the remainder.
+     */
     for (i = fill_len; i + 127 < str_len; i += 128){
-      memcpy (state->remainder, str+i, 128);
-      ch2uint(state->remainder, state->block, 128);
+      ch2uint(str+i, state->block, 128);
       haval_hash_block (state);
     }
     rmd_len = 0;
@@ -35,43 +35,100 @@
  * ---------------------
  *
  * The HAVAL alogrithm is used to compute a cryptographically strong
- * message digest.
+ * message digest. HAVAL comes in 15 variants, for 3, 4 and 5 passes,
+ * and fingerprints of 128, 160, 192, 224 and 256 bit. Each of them is
+ * registered as a digest of its own, named 'haval-<passes>-<bits>'.
+ * The core is compiled separately for each of them (see "havalvar.c"),
+ * so no choice is made at runtime, in the hashing.
+ *
+ * 'haval' is the variant with 3 passes and a 256 bit fingerprint.
  */
 
-#define DIGEST_SIZE               (32)
-#define CTX_TYPE                  haval_state
+#define HAVAL_NO_DRIVER
 
-/*
- * Declarations of internal procedures.
- */
+#define PASS 3
+#define FPTLEN 128
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 160
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 192
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 224
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 256
+#include "havalvar.c"
+#undef  FPTLEN
+#undef  PASS
 
-static void MDHaval_Start     _ANSI_ARGS_ ((VOID* context));
-static void MDHaval_Update    _ANSI_ARGS_ ((VOID* context, unsigned int character));
-static void MDHaval_UpdateBuf _ANSI_ARGS_ ((VOID* context, unsigned char* buffer, int bufLen));
-static void MDHaval_Final     _ANSI_ARGS_ ((VOID* context, VOID* digest));
+#define PASS 4
+#define FPTLEN 128
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 160
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 192
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 224
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 256
+#include "havalvar.c"
+#undef  FPTLEN
+#undef  PASS
 
-/*
- * Generator definition.
- */
+#define PASS 5
+#define FPTLEN 128
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 160
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 192
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 224
+#include "havalvar.c"
+#undef  FPTLEN
+#define FPTLEN 256
+#include "havalvar.c"
+#undef  FPTLEN
+#undef  PASS
 
 static Trf_MessageDigestDescription mdDescription = { /* THREADING: constant, read-only => safe */
   "haval",
-  sizeof (CTX_TYPE),
-  DIGEST_SIZE,
-  MDHaval_Start,
-  MDHaval_Update,
-  MDHaval_UpdateBuf,
-  MDHaval_Final,
+  sizeof (haval_state),
+  32,
+  MDHaval_Start_3_256,
+  MDHaval_Update_3_256,
+  MDHaval_UpdateBuf_3_256,
+  MDHaval_Final_3_256,
   NULL
 };
-
+
+static Trf_MessageDigestDescription* variants [] = { /* THREADING: constant, read-only => safe */
+  &mdDescription,
+  &mdDescription_3_128, &mdDescription_3_160, &mdDescription_3_192,
+  &mdDescription_3_224, &mdDescription_3_256,
+  &mdDescription_4_128, &mdDescription_4_160, &mdDescription_4_192,
+  &mdDescription_4_224, &mdDescription_4_256,
+  &mdDescription_5_128, &mdDescription_5_160, &mdDescription_5_192,
+  &mdDescription_5_224, &mdDescription_5_256,
+  NULL
+};
+
 /*
  *------------------------------------------------------*
  *
  *	TrfInit_HAVAL --
  *
  *	------------------------------------------------*
- *	Register the generator implemented in this file.
+ *	Register the generators implemented in this file.
  *	------------------------------------------------*
  *
  *	Sideeffects:
@@ -87,121 +144,15 @@ int
 TrfInit_HAVAL (interp)
 Tcl_Interp* interp;
 {
-  return Trf_RegisterMessageDigest (interp, &mdDescription);
-}
-
-/*
- *------------------------------------------------------*
- *
- *	MDHaval_Start --
- *
- *	------------------------------------------------*
- *	Initialize the internal state of the message
- *	digest generator.
- *	------------------------------------------------*
- *
- *	Sideeffects:
- *		As of the called procedure.
- *
- *	Result:
- *		None.
- *
- *------------------------------------------------------*
- */
+  Trf_MessageDigestDescription** md;
+  int                            res;
 
-static void
-MDHaval_Start (context)
-VOID* context;
-{
-  haval_start ((CTX_TYPE*) context);
-}
-
-/*
- *------------------------------------------------------*
- *
- *	MDHaval_Update --
- *
- *	------------------------------------------------*
- *	Update the internal state of the message digest
- *	generator for a single character.
- *	------------------------------------------------*
- *
- *	Sideeffects:
- *		As of the called procedure.
- *
- *	Result:
- *		None.
- *
- *------------------------------------------------------*
- */
+  for (md = variants; *md != NULL; md++) {
+    res = Trf_RegisterMessageDigest (interp, *md);
+    if (res != TCL_OK) {
+      return res;
+    }
+  }
 
-static void
-MDHaval_Update (context, character)
-VOID* context;
-unsigned int   character;
-{
-  unsigned char buf = character;
-
-  haval_hash ((CTX_TYPE*) context, &buf, 1);
+  return TCL_OK;
 }
-
-/*
- *------------------------------------------------------*
- *
- *	MDHaval_UpdateBuf --
- *
- *	------------------------------------------------*
- *	Update the internal state of the message digest
- *	generator for a character buffer.
- *	------------------------------------------------*
- *
- *	Sideeffects:
- *		As of the called procedure.
- *
- *	Result:
- *		None.
- *
- *------------------------------------------------------*
- */
-
-static void
-MDHaval_UpdateBuf (context, buffer, bufLen)
-VOID* context;
-unsigned char* buffer;
-int   bufLen;
-{
-  haval_hash ((CTX_TYPE*) context, (unsigned char*) buffer, bufLen);
-}
-
-/*
- *------------------------------------------------------*
- *
- *	MDHaval_Final --
- *
- *	------------------------------------------------*
- *	Generate the digest from the internal state of
- *	the message digest generator.
- *	------------------------------------------------*
- *
- *	Sideeffects:
- *		As of the called procedure.
- *
- *	Result:
- *		None.
- *
- *------------------------------------------------------*
- */
-
-static void
-MDHaval_Final (context, digest)
-VOID* context;
-VOID* digest;
-{
-  haval_end ((CTX_TYPE*) context, (unsigned char*) digest);
-}
-
-/*
- * External code from here on.
- */
-
-#include "haval.1996/haval.c" /* THREADING: import of one constant var, read-only => safe */
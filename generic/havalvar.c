@@ -0,0 +1,128 @@
+/*
+ * havalvar.c --
+ *
+ *	Template for one variant of the message digest generator HAVAL.
+ *	Included by 'haval.c', once for every supported combination of
+ *	number of passes and length of the fingerprint. Not compiled on
+ *	its own.
+ *
+ *	Expects PASS (3, 4, 5) and FPTLEN (128, 160, 192, 224, 256) to
+ *	be defined by the includer. The HAVAL core is compiled for exactly
+ *	this combination, i.e. all decisions about passes and tailoring
+ *	are made by the preprocessor. The names of the core procedures and
+ *	of the glue procedures below are made unique by appending the
+ *	combination, see HV.
+ *
+ *
+ * Copyright (c) 2026 Andreas Kupries (andreas_kupries@users.sourceforge.net)
+ * All rights reserved.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL I LIABLE TO ANY PARTY FOR DIRECT, INDIRECT, SPECIAL,
+ * INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT OF THE USE OF THIS
+ * SOFTWARE AND ITS DOCUMENTATION, EVEN IF I HAVE BEEN ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * I SPECIFICALLY DISCLAIM ANY WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND
+ * I HAVE NO OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES,
+ * ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * CVS: $Id$
+ */
+
+/* Deliberately no include guard. */
+
+/*
+ * Name mangling, ex.: HV (MDHaval_Start) => MDHaval_Start_5_256
+ */
+
+#define HV_GLUE2(n,p,f) n##_##p##_##f
+#define HV_GLUE(n,p,f)  HV_GLUE2(n,p,f)
+#define HV(n)           HV_GLUE(n,PASS,FPTLEN)
+
+#define HV_NAME2(p,f)   "haval-" #p "-" #f
+#define HV_NAME(p,f)    HV_NAME2(p,f)
+
+/*
+ * Instantiate the core. The round functions depend on PASS and must
+ * not clash with the definitions made for the previous variant.
+ */
+
+#define haval_start      HV (havalStart)
+#define haval_hash       HV (havalHash)
+#define haval_end        HV (havalEnd)
+#define haval_hash_block HV (havalHashBlock)
+#define haval_tailor     HV (havalTailor)
+#define padding          HV (havalPadding)
+
+#undef Fphi_1
+#undef Fphi_2
+#undef Fphi_3
+#undef Fphi_4
+#undef Fphi_5
+
+#include "haval.1996/haval.c" /* THREADING: import of one constant var, read-only => safe */
+
+/*
+ * Glue to the common code for message digests (digest.c). Same as the
+ * procedures of other digests, see for example "rmd160.c".
+ */
+
+static void
+HV (MDHaval_Start) (context)
+VOID* context;
+{
+  haval_start ((haval_state*) context);
+}
+
+static void
+HV (MDHaval_Update) (context, character)
+VOID*        context;
+unsigned int character;
+{
+  unsigned char buf = character;
+
+  haval_hash ((haval_state*) context, &buf, 1);
+}
+
+static void
+HV (MDHaval_UpdateBuf) (context, buffer, bufLen)
+VOID*          context;
+unsigned char* buffer;
+int            bufLen;
+{
+  haval_hash ((haval_state*) context, buffer, bufLen);
+}
+
+static void
+HV (MDHaval_Final) (context, digest)
+VOID* context;
+VOID* digest;
+{
+  haval_end ((haval_state*) context, (unsigned char*) digest);
+}
+
+static Trf_MessageDigestDescription HV (mdDescription) = { /* THREADING: constant, read-only => safe */
+  HV_NAME (PASS, FPTLEN),
+  sizeof (haval_state),
+  (FPTLEN >> 3),
+  HV (MDHaval_Start),
+  HV (MDHaval_Update),
+  HV (MDHaval_UpdateBuf),
+  HV (MDHaval_Final),
+  NULL
+};
+
+#undef haval_start
+#undef haval_hash
+#undef haval_end
+#undef haval_hash_block
+#undef haval_tailor
+#undef padding
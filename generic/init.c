@@ -31,6 +31,67 @@
 
 extern TrfStubs trfStubs;
 
+/*
+ * The builtin transformations, and the procedures registering them.
+ * 'Trf_Init' creates only their commands, see 'TrfRegisterLazy'. A
+ * procedure registering several transformations is listed for each of
+ * them.
+ */
+
+typedef struct Transformer {
+  CONST char*  name;
+  TrfInitProc* initProc;
+} Transformer;
+
+static Transformer transformers [] = { /* THREADING: constant, read-only => safe */
+  /* Error correction */
+  { "rs_ecc",           TrfInit_RS_ECC },
+  /* Compressors */
+  { "zip",              TrfInit_ZIP },
+  { "bz2",              TrfInit_BZ2 },
+  { "lz4",              TrfInit_LZ4 },
+  /* Message digests */
+  { "crc",              TrfInit_CRC },
+  { "adler",            TrfInit_ADLER },
+  { "crc-zlib",         TrfInit_CRC_ZLIB },
+  { "md5",              TrfInit_MD5 },
+  { "otp_md5",          TrfInit_OTP_MD5 },
+  { "md2",              TrfInit_MD2 },
+  { "haval",            TrfInit_HAVAL },
+  { "haval-3-128",      TrfInit_HAVAL },
+  { "haval-3-160",      TrfInit_HAVAL },
+  { "haval-3-192",      TrfInit_HAVAL },
+  { "haval-3-224",      TrfInit_HAVAL },
+  { "haval-3-256",      TrfInit_HAVAL },
+  { "haval-4-128",      TrfInit_HAVAL },
+  { "haval-4-160",      TrfInit_HAVAL },
+  { "haval-4-192",      TrfInit_HAVAL },
+  { "haval-4-224",      TrfInit_HAVAL },
+  { "haval-4-256",      TrfInit_HAVAL },
+  { "haval-5-128",      TrfInit_HAVAL },
+  { "haval-5-160",      TrfInit_HAVAL },
+  { "haval-5-192",      TrfInit_HAVAL },
+  { "haval-5-224",      TrfInit_HAVAL },
+  { "haval-5-256",      TrfInit_HAVAL },
+  { "sha",              TrfInit_SHA },
+  { "sha1",             TrfInit_SHA1 },
+  { "otp_sha1",         TrfInit_OTP_SHA1 },
+  { "ripemd160",        TrfInit_RIPEMD160 },
+  { "ripemd128",        TrfInit_RIPEMD128 },
+  /* Freeform transformation, reflector into tcl level */
+  { "transform",        TrfInit_Transform },
+  /* Standard encodings */
+  { "ascii85",          TrfInit_Ascii85 },
+  { "uuencode",         TrfInit_UU },
+  { "base64",           TrfInit_B64 },
+  { "bin",              TrfInit_Bin },
+  { "oct",              TrfInit_Oct },
+  { "otp_words",        TrfInit_OTP_WORDS },
+  { "quoted-printable", TrfInit_QP },
+  { "hex",              TrfInit_Hex },
+  { NULL,               NULL }
+};
+
 
 /*
  *------------------------------------------------------*
@@ -57,6 +118,7 @@ Tcl_Interp* interp;
 {
   Trf_Registry*  registry;
   int            res;
+  Transformer*   t;
 
 #ifdef USE_TCL_STUBS
   CONST char* actualVersion;
@@ -91,10 +153,13 @@ Tcl_Interp* interp;
     Tcl_GetVersion (&major, &minor, &patchlevel, &releasetype);
 
     if (major > 8) {
-      /* Beyond 8.3.2 */
-      registry->patchVariant = PATCH_832;
+      /* Beyond 8.5 */
+      registry->patchVariant = PATCH_85;
     } else if (major == 8) {
-      if ((minor > 3) ||
+      if (minor > 4) {
+	/* Is 8.5 or beyond */
+	registry->patchVariant = PATCH_85;
+      } else if ((minor > 3) ||
 	  ((minor == 3) && (patchlevel > 1) &&
 	   (releasetype == TCL_FINAL_RELEASE))) {
 	/* Is 8.3.2 or beyond */
@@ -129,159 +194,36 @@ Tcl_Interp* interp;
 
   if (res != TCL_OK)
     return res;
-  
-#ifdef ENABLE_BINIO
-  res = TrfInit_Binio (interp);
 
-  if (res != TCL_OK)
-    return res;
-#endif
+  res = TrfInit_Pipeline (interp);
 
-  /*
-   * Register error correction algorithms.
-   */
-
-  res = TrfInit_RS_ECC (interp);
-  
   if (res != TCL_OK)
     return res;
-
-  /*
-   * Register compressors.
-   */
-
-  res = TrfInit_ZIP (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_BZ2 (interp);
+  
+#ifdef ENABLE_BINIO
+  res = TrfInit_Binio (interp);
 
   if (res != TCL_OK)
     return res;
+#endif
 
   /*
-   * Register message digests
+   * Announce the transformations. Their registration is completed
+   * on the first use of their command.
    */
 
-  res = TrfInit_CRC (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_ADLER (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_CRC_ZLIB (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_MD5 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_OTP_MD5 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_MD2 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_HAVAL (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_SHA (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_SHA1 (interp);
+  for (t = transformers; t->name != NULL; t++) {
+    res = TrfRegisterLazy (interp, t->name, t->initProc);
 
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_OTP_SHA1 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_RIPEMD160 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_RIPEMD128 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  /*
-   * Register freeform transformation, reflector into tcl level
-   */
-
-  res = TrfInit_Transform (interp);
+    if (res != TCL_OK)
+      return res;
+  }
 
-  if (res != TCL_OK)
-    return res;
-  
   /*
    * Register crypt commands for pwd auth.
    */
 
-  res = TrfInit_Crypt (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  /*
-   * Register standard encodings.
-   */
-
-  res = TrfInit_Ascii85 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_UU (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_B64 (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_Bin (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_Oct (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_OTP_WORDS (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  res = TrfInit_QP (interp);
-
-  if (res != TCL_OK)
-    return res;
-
-  return TrfInit_Hex (interp);
+  return TrfInit_Crypt (interp);
 }
 
 /*
@@ -41,6 +41,7 @@
 #endif /* SSL_LIB_NAME */
 
 
+#ifndef SSL_STATIC_BUILD
 typedef struct SslLibFunctions {
   void* handle;
   /* MD2 */
@@ -66,6 +67,7 @@ static char* ssl_symbols [] = {
   /* -- */
   (char *) NULL,
 };
+#endif
 
 #ifndef MD5_STATIC_BUILD
 static char* crypt_symbols [] = {
@@ -85,8 +87,10 @@ static char* crypt_symbols [] = {
  * Global variables containing the vectors to DES, MD2, ...
  */
 
+#ifndef SSL_STATIC_BUILD
 md2Functions  md2f  = {0}; /* THREADING: serialize initialization */
 sha1Functions sha1f = {0}; /* THREADING: serialize initialization */
+#endif
 md5Functions  md5f  = {0}; /* THREADING: serialize initialization */
 
 #ifdef MD5_STATIC_BUILD
@@ -106,7 +110,9 @@ static void md5_final(unsigned char* digest, MD5_CTX* c) {
  *                        contains all vectors loaded from 'libdes' library.
  */
 
+#ifndef SSL_STATIC_BUILD
 static sslLibFunctions ssl; /* THREADING: serialize initialization */
+#endif
 
 /*
  *------------------------------------------------------*
@@ -134,6 +140,14 @@ int
 TrfLoadMD2 (interp)
     Tcl_Interp* interp;
 {
+#ifdef SSL_STATIC_BUILD
+  if (!md2f.loaded) {
+    Tcl_AppendResult (interp, "md2 is not available in the linked libcrypto",
+		      (char*) NULL);
+    return TCL_ERROR;
+  }
+  return TCL_OK;
+#else
   int res;
 
   TrfLock; /* THREADING: serialize initialization */
@@ -161,6 +175,7 @@ TrfLoadMD2 (interp)
 
   TrfUnlock;
   return TCL_ERROR;
+#endif
 }
 
 /*
@@ -234,6 +249,9 @@ int
 TrfLoadSHA1 (interp)
     Tcl_Interp* interp;
 {
+#ifdef SSL_STATIC_BUILD
+  return TCL_OK;
+#else
   int res;
 
   TrfLock; /* THREADING: serialize initialization */
@@ -261,5 +279,6 @@ TrfLoadSHA1 (interp)
 
   TrfUnlock;
   return TCL_ERROR;
+#endif
 }
 
@@ -46,6 +46,13 @@ extern "C" {
 
 #include "transformInt.h"
 
+#ifdef SSL_STATIC_BUILD
+/* The functions are referenced directly, see below. Trf uses the
+ * low-level digest API on purpose.
+ */
+#   define OPENSSL_SUPPRESS_DEPRECATED
+#endif
+
 #ifdef HAVE_MD2_H
 #   ifdef OPENSSL_SUB
 #       include <openssl/md2.h>
@@ -134,9 +141,35 @@ typedef struct Sha1Functions {
  * a mutex in case of a thread-enabled Tcl.
  */
 
+#ifdef SSL_STATIC_BUILD
+/* 'libcrypto' is linked into the package (--enable-static-ssl). As for
+ * 'zf' in "transformInt.h" the tables are constants, allowing the
+ * compiler to call the functions directly. MD2 is optional, newer
+ * versions of OpenSSL do not provide it by default.
+ */
+
+static CONST md2Functions md2f = { /* THREADING: constant, read-only => safe */
+#ifndef OPENSSL_NO_MD2
+  1,
+  (void (*) _ANSI_ARGS_ ((MD2_CTX*))) MD2_Init,
+  (void (*) _ANSI_ARGS_ ((MD2_CTX*, unsigned char*, unsigned long))) MD2_Update,
+  (void (*) _ANSI_ARGS_ ((unsigned char*, MD2_CTX*))) MD2_Final
+#else
+  0, NULL, NULL, NULL
+#endif
+};
+
+static CONST sha1Functions sha1f = { /* THREADING: constant, read-only => safe */
+  1,
+  (void (*) _ANSI_ARGS_ ((SHA_CTX*))) SHA1_Init,
+  (void (*) _ANSI_ARGS_ ((SHA_CTX*, unsigned char*, unsigned long))) SHA1_Update,
+  (void (*) _ANSI_ARGS_ ((unsigned char*, SHA_CTX*))) SHA1_Final
+};
+#else
 EXTERN md2Functions  md2f;  /* THREADING: serialize initialization */
-EXTERN md5Functions  md5f;  /* THREADING: serialize initialization */
 EXTERN sha1Functions sha1f; /* THREADING: serialize initialization */
+#endif
+EXTERN md5Functions  md5f;  /* THREADING: serialize initialization */
 
 
 EXTERN int
@@ -0,0 +1,1557 @@
+/*
+ * lz4.c --
+ *
+ *	Implements and registers a fast compressor using the LZ4 block
+ *	and frame formats. The codec is part of Trf, no external
+ *	library is required.
+ *
+ *
+ * Copyright (c) 2026 Andreas Kupries (andreas_kupries@users.sourceforge.net)
+ * All rights reserved.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL I LIABLE TO ANY PARTY FOR DIRECT, INDIRECT, SPECIAL,
+ * INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT OF THE USE OF THIS
+ * SOFTWARE AND ITS DOCUMENTATION, EVEN IF I HAVE BEEN ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * I SPECIFICALLY DISCLAIM ANY WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND
+ * I HAVE NO OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES,
+ * ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * CVS: $Id$
+ */
+
+#include "transformInt.h"
+
+/*
+ * The compressor writes a single LZ4 frame (magic 0x184D2204) per
+ * flush: independent blocks of at most 64K, a checksum of the
+ * uncompressed content (xxHash32), no content size. Blocks which
+ * do not compress are stored. The decompressor accepts any
+ * sequence of LZ4 frames, with independent or linked blocks, block
+ * checksums, content size, and skippable frames in between. Frames
+ * using a dictionary are rejected.
+ */
+
+typedef struct _Xxh32_ {
+  unsigned int  v [4];		/* Accumulators */
+  unsigned int  total;		/* Length of the data, modulo 2^32 */
+  int           large;		/* Boolean. Set if at least 16 bytes seen */
+  unsigned char mem [16];	/* Incomplete stripe */
+  int           memLen;
+} Xxh32;
+
+/*
+ * Declarations of internal procedures.
+ */
+
+static Trf_ControlBlock CreateEncoder  _ANSI_ARGS_ ((ClientData writeClientData,
+						     Trf_WriteProc *fun,
+						     Trf_Options optInfo,
+						     Tcl_Interp*   interp,
+						     ClientData clientData));
+static void             DeleteEncoder  _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     ClientData clientData));
+static int              Encode         _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     unsigned int character,
+						     Tcl_Interp* interp,
+						     ClientData clientData));
+static int              EncodeBuffer   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     unsigned char* buffer, int bufLen,
+						     Tcl_Interp* interp,
+						     ClientData clientData));
+static int              FlushEncoder   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     Tcl_Interp* interp,
+						     ClientData clientData));
+static void             ClearEncoder   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     ClientData clientData));
+
+static Trf_ControlBlock CreateDecoder  _ANSI_ARGS_ ((ClientData writeClientData,
+						     Trf_WriteProc *fun,
+						     Trf_Options optInfo,
+						     Tcl_Interp*   interp,
+						     ClientData clientData));
+static void             DeleteDecoder  _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     ClientData clientData));
+static int              Decode         _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     unsigned int character,
+						     Tcl_Interp* interp,
+						     ClientData clientData));
+static int              DecodeBuffer   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     unsigned char* buffer, int bufLen,
+						     Tcl_Interp* interp,
+						     ClientData clientData));
+static int              FlushDecoder   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     Tcl_Interp* interp,
+						     ClientData clientData));
+static void             ClearDecoder   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+						     ClientData clientData));
+
+static void         Xxh32Init     _ANSI_ARGS_ ((Xxh32* x));
+static void         Xxh32Update   _ANSI_ARGS_ ((Xxh32* x,
+						CONST unsigned char* data,
+						int length));
+static unsigned int Xxh32Digest   _ANSI_ARGS_ ((Xxh32* x));
+
+static int Lz4Compress   _ANSI_ARGS_ ((CONST unsigned char* src, int srcLen,
+				       unsigned char* dst, int acceleration,
+				       int* table));
+static int Lz4Decompress _ANSI_ARGS_ ((CONST unsigned char* src, int srcLen,
+				       unsigned char* dst, int dstPos,
+				       int dstMax));
+
+struct _EncoderControl_;
+struct _DecoderControl_;
+
+static int CompressBlock _ANSI_ARGS_ ((struct _EncoderControl_* c,
+				       unsigned char* data, int length,
+				       Tcl_Interp* interp));
+static int DecodeUnit    _ANSI_ARGS_ ((struct _DecoderControl_* c,
+				       unsigned char* data, int length,
+				       Tcl_Interp* interp));
+static int WriteBlock    _ANSI_ARGS_ ((struct _DecoderControl_* c,
+				       unsigned char* data, int length,
+				       Tcl_Interp* interp));
+static void Lz4Error     _ANSI_ARGS_ ((Tcl_Interp* interp,
+				       CONST char* prefix,
+				       CONST char* msg));
+
+/*
+ * Converter definition.
+ */
+
+static Trf_TypeDefinition convDefinition =
+{
+  "lz4",
+  NULL, /* client data not used       */
+  NULL, /* filled by TrfInit_LZ4, THREADING: serialize initialization */
+  {
+    CreateEncoder,
+    DeleteEncoder,
+    Encode,
+    EncodeBuffer,
+    FlushEncoder,
+    ClearEncoder,
+    NULL /* no MaxRead */
+  }, {
+    CreateDecoder,
+    DeleteDecoder,
+    Decode,
+    DecodeBuffer,
+    FlushDecoder,
+    ClearDecoder,
+    NULL /* no MaxRead */
+  },
+  TRF_UNSEEKABLE
+};
+
+/*
+ * Format constants.
+ */
+
+#define FRAME_MAGIC     (0x184D2204U)
+#define SKIP_MAGIC      (0x184D2A50U)	/* Low 4 bits are free */
+#define SKIP_MASK       (0xFFFFFFF0U)
+
+#define FLG_VERSION     (0x40)
+#define FLG_INDEPENDENT (0x20)
+#define FLG_BLOCK_SUM   (0x10)
+#define FLG_SIZE        (0x08)
+#define FLG_CONTENT_SUM (0x04)
+#define FLG_DICTIONARY  (0x01)
+
+#define STORED          (0x80000000U)	/* Block size flag, uncompressed */
+
+#define BLOCK_SIZE      (64 * 1024)	/* Compressor, block maximum code 4 */
+#define BLOCK_BD        (0x40)
+#define HISTORY         (64 * 1024)	/* Reach of a match */
+
+#define MINMATCH        (4)
+#define LASTLITERALS    (5)	/* The last 5 bytes are always literals */
+#define MFLIMIT         (12)	/* No match starts in the last 12 bytes */
+#define MAX_DISTANCE    (65535)
+#define HASH_LOG        (12)
+#define HASH_SIZE       (1 << HASH_LOG)
+#define SKIP_TRIGGER    (6)	/* Misses before the step grows */
+
+#define BOUND(n)        ((n) + (n) / 255 + 16)
+
+#define HASH(v)         (((v) * 2654435761U) >> (32 - HASH_LOG))
+
+/*
+ * Definition of the control blocks for en- and decoder.
+ */
+
+typedef struct _EncoderControl_ {
+  Trf_WriteProc* write;
+  ClientData     writeClientData;
+
+  /* add conversion specific items here (LZ4) */
+
+  int            acceleration;
+  int            started;	/* Boolean. Set after the frame header
+				 * was written */
+  unsigned char* block;		/* Input collected for the next block */
+  int            blockLen;
+  unsigned char* out;		/* Size field and compressed block */
+  int*           table;		/* Hash table of the compressor */
+  Xxh32          sum;		/* Checksum of the content */
+
+} EncoderControl;
+
+
+/*
+ * States of the decoder, i.e. the kind of unit collected.
+ */
+
+#define DEC_MAGIC      (0)
+#define DEC_FLAGS      (1)	/* FLG and BD */
+#define DEC_DESCRIPTOR (2)	/* Rest of the frame descriptor */
+#define DEC_SIZE       (3)	/* Block size, or end mark */
+#define DEC_BLOCK      (4)	/* Block data, and block checksum */
+#define DEC_CHECKSUM   (5)	/* Content checksum */
+#define DEC_SKIPSIZE   (6)	/* Size of a skippable frame */
+#define DEC_SKIP       (7)	/* Contents of a skippable frame */
+
+typedef struct _DecoderControl_ {
+  Trf_WriteProc* write;
+  ClientData     writeClientData;
+
+  /* add conversion specific items here (LZ4) */
+
+  int            state;		/* See DEC_* above */
+  int            need;		/* Size of the unit */
+  unsigned char* unit;		/* The unit collected so far */
+  int            unitLen;
+  int            unitSize;	/* Allocated size of 'unit' */
+
+  int            flg;		/* Frame descriptor of the current frame */
+  int            bd;
+  int            blockMax;	/* Maximal size of a block */
+  int            stored;	/* Boolean. Current block is uncompressed */
+  unsigned int   skip;		/* Bytes left of a skippable frame */
+
+  unsigned char* window;	/* Output of the last block, behind the
+				 * history of linked blocks */
+  int            windowSize;
+  int            histLen;
+  Xxh32          sum;		/* Checksum of the content */
+
+} DecoderControl;
+
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfInit_LZ4 --
+ *
+ *	------------------------------------------------*
+ *	Register the compressor implemented in this file.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of 'Trf_Register'.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+int
+TrfInit_LZ4 (interp)
+Tcl_Interp* interp;
+{
+  TrfLock; /* THREADING: serialize initialization */
+  if (convDefinition.options == (Trf_OptionVectors*) NULL) {
+    convDefinition.options = TrfLZ4Options ();
+  }
+  TrfUnlock;
+
+  return Trf_Register (interp, &convDefinition);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CreateEncoder --
+ *
+ *	------------------------------------------------*
+ *	Allocate and initialize the control block of a
+ *	data encoder.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		An opaque reference to the control block.
+ *
+ *------------------------------------------------------*
+ */
+
+static Trf_ControlBlock
+CreateEncoder (writeClientData, fun, optInfo, interp, clientData)
+ClientData     writeClientData;
+Trf_WriteProc* fun;
+Trf_Options    optInfo;
+Tcl_Interp*    interp;
+ClientData     clientData;
+{
+  EncoderControl*    c;
+  TrfLz4OptionBlock* o = (TrfLz4OptionBlock*) optInfo;
+
+  c = (EncoderControl*) ckalloc (sizeof (EncoderControl));
+  c->write           = fun;
+  c->writeClientData = writeClientData;
+
+  /* initialize conversion specific items here (LZ4) */
+
+  c->acceleration = o->acceleration;
+  c->block        = (unsigned char*) ckalloc (BLOCK_SIZE);
+  c->out          = (unsigned char*) ckalloc (4 + BOUND (BLOCK_SIZE));
+  c->table        = (int*) ckalloc (HASH_SIZE * sizeof (int));
+
+  ClearEncoder ((Trf_ControlBlock) c, clientData);
+
+  return (ClientData) c;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DeleteEncoder --
+ *
+ *	------------------------------------------------*
+ *	Destroy the control block of an encoder.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases the memory allocated by 'CreateEncoder'
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+DeleteEncoder (ctrlBlock, clientData)
+Trf_ControlBlock ctrlBlock;
+ClientData clientData;
+{
+  EncoderControl* c = (EncoderControl*) ctrlBlock;
+
+  /* release conversion specific items here (LZ4) */
+
+  ckfree ((char*) c->block);
+  ckfree ((char*) c->out);
+  ckfree ((char*) c->table);
+  ckfree ((char*) c);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Encode --
+ *
+ *	------------------------------------------------*
+ *	Encode the given character and write the result.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Encode (ctrlBlock, character, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+unsigned int character;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  EncoderControl* c = (EncoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (LZ4) */
+
+  c->block [c->blockLen ++] = character;
+
+  if (c->blockLen < BLOCK_SIZE) {
+    return TCL_OK;
+  }
+
+  c->blockLen = 0;
+  return CompressBlock (c, c->block, BLOCK_SIZE, interp);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	EncodeBuffer --
+ *
+ *	------------------------------------------------*
+ *	Encode the given buffer and write the result.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+EncodeBuffer (ctrlBlock, buffer, bufLen, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+unsigned char* buffer;
+int bufLen;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  EncoderControl* c = (EncoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (LZ4) */
+  int n;
+
+  while (bufLen > 0) {
+    if ((c->blockLen == 0) && (bufLen >= BLOCK_SIZE)) {
+      /* Complete blocks are compressed in place */
+      n = BLOCK_SIZE;
+      if (CompressBlock (c, buffer, n, interp) != TCL_OK) {
+	return TCL_ERROR;
+      }
+    } else {
+      n = BLOCK_SIZE - c->blockLen;
+      if (n > bufLen) {
+	n = bufLen;
+      }
+
+      memcpy ((VOID*) (c->block + c->blockLen), (VOID*) buffer, n);
+      c->blockLen += n;
+
+      if (c->blockLen == BLOCK_SIZE) {
+	c->blockLen = 0;
+	if (CompressBlock (c, c->block, BLOCK_SIZE, interp) != TCL_OK) {
+	  return TCL_ERROR;
+	}
+      }
+    }
+
+    buffer += n;
+    bufLen -= n;
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	FlushEncoder --
+ *
+ *	------------------------------------------------*
+ *	Writes the last block, and completes the frame.
+ *	The next data starts a new frame.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+FlushEncoder (ctrlBlock, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  EncoderControl* c = (EncoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (LZ4) */
+  unsigned char trailer [8];
+  unsigned int  sum;
+  int           res;
+
+  /* An empty frame for empty input */
+  res = CompressBlock (c, c->block, c->blockLen, interp);
+  if (res != TCL_OK) {
+    return res;
+  }
+
+  sum = Xxh32Digest (&c->sum);
+
+  memset ((VOID*) trailer, 0, 4); /* End mark */
+  trailer [4] = (sum      ) & 0xff;
+  trailer [5] = (sum >>  8) & 0xff;
+  trailer [6] = (sum >> 16) & 0xff;
+  trailer [7] = (sum >> 24) & 0xff;
+
+  res = c->write (c->writeClientData, trailer, 8, interp);
+
+  ClearEncoder ((Trf_ControlBlock) c, clientData);
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ClearEncoder --
+ *
+ *	------------------------------------------------*
+ *	Discard an incomplete block, the next data
+ *	starts a new frame.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ClearEncoder (ctrlBlock, clientData)
+Trf_ControlBlock ctrlBlock;
+ClientData clientData;
+{
+  EncoderControl* c = (EncoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (LZ4) */
+
+  c->started  = 0;
+  c->blockLen = 0;
+  Xxh32Init (&c->sum);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CompressBlock --
+ *
+ *	------------------------------------------------*
+ *	Compresses a block and writes it, after the frame
+ *	header if this is the first block of the frame.
+ *	An empty block writes only the header, if not
+ *	written already.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+CompressBlock (c, data, length, interp)
+EncoderControl* c;
+unsigned char*  data;
+int             length;
+Tcl_Interp*     interp;
+{
+  unsigned int size;
+  int          res;
+
+  if (!c->started) {
+    unsigned char header [7];
+    Xxh32         hc;
+
+    header [0] = (FRAME_MAGIC      ) & 0xff;
+    header [1] = (FRAME_MAGIC >>  8) & 0xff;
+    header [2] = (FRAME_MAGIC >> 16) & 0xff;
+    header [3] = (FRAME_MAGIC >> 24) & 0xff;
+    header [4] = FLG_VERSION | FLG_INDEPENDENT | FLG_CONTENT_SUM;
+    header [5] = BLOCK_BD;
+
+    Xxh32Init   (&hc);
+    Xxh32Update (&hc, header + 4, 2);
+    header [6] = (Xxh32Digest (&hc) >> 8) & 0xff;
+
+    res = c->write (c->writeClientData, header, 7, interp);
+    if (res != TCL_OK) {
+      return res;
+    }
+
+    c->started = 1;
+  }
+
+  if (length == 0) {
+    return TCL_OK;
+  }
+
+  Xxh32Update (&c->sum, data, length);
+
+  size = Lz4Compress (data, length, c->out + 4, c->acceleration, c->table);
+
+  if (size >= (unsigned int) length) {
+    /* Incompressible, store it */
+    memcpy ((VOID*) (c->out + 4), (VOID*) data, length);
+    size = length | STORED;
+  }
+
+  c->out [0] = (size      ) & 0xff;
+  c->out [1] = (size >>  8) & 0xff;
+  c->out [2] = (size >> 16) & 0xff;
+  c->out [3] = (size >> 24) & 0xff;
+
+  return c->write (c->writeClientData, c->out, 4 + (size & ~STORED), interp);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CreateDecoder --
+ *
+ *	------------------------------------------------*
+ *	Allocate and initialize the control block of a
+ *	data decoder.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		An opaque reference to the control block.
+ *
+ *------------------------------------------------------*
+ */
+
+static Trf_ControlBlock
+CreateDecoder (writeClientData, fun, optInfo, interp, clientData)
+ClientData     writeClientData;
+Trf_WriteProc* fun;
+Trf_Options    optInfo;
+Tcl_Interp*    interp;
+ClientData     clientData;
+{
+  DecoderControl* c;
+
+  c = (DecoderControl*) ckalloc (sizeof (DecoderControl));
+  c->write           = fun;
+  c->writeClientData = writeClientData;
+
+  /* initialize conversion specific items here (LZ4) */
+
+  c->unitSize   = 16;
+  c->unit       = (unsigned char*) ckalloc (c->unitSize);
+  c->window     = (unsigned char*) NULL;
+  c->windowSize = 0;
+
+  ClearDecoder ((Trf_ControlBlock) c, clientData);
+
+  return (ClientData) c;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DeleteDecoder --
+ *
+ *	------------------------------------------------*
+ *	Destroy the control block of an decoder.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases the memory allocated by 'CreateDecoder'
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+DeleteDecoder (ctrlBlock, clientData)
+Trf_ControlBlock ctrlBlock;
+ClientData clientData;
+{
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
+
+  /* release conversion specific items here (LZ4) */
+
+  if (c->window != (unsigned char*) NULL) {
+    ckfree ((char*) c->window);
+  }
+
+  ckfree ((char*) c->unit);
+  ckfree ((char*) c);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Decode --
+ *
+ *	------------------------------------------------*
+ *	Decode the given character and write the result.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Decode (ctrlBlock, character, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+unsigned int character;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  unsigned char in = character;
+
+  return DecodeBuffer (ctrlBlock, &in, 1, interp, clientData);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DecodeBuffer --
+ *
+ *	------------------------------------------------*
+ *	Decode the given buffer and write the result.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+DecodeBuffer (ctrlBlock, buffer, bufLen, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+unsigned char* buffer;
+int bufLen;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (LZ4) */
+  int n;
+
+  while (bufLen > 0) {
+    if (c->state == DEC_SKIP) {
+      n = (c->skip < (unsigned int) bufLen) ? (int) c->skip : bufLen;
+      c->skip -= n;
+      if (c->skip == 0) {
+	c->state = DEC_MAGIC;
+	c->need  = 4;
+      }
+    } else if ((c->unitLen == 0) && (bufLen >= c->need)) {
+      /* Complete units are decoded in place */
+      n = c->need;
+      if (DecodeUnit (c, buffer, n, interp) != TCL_OK) {
+	return TCL_ERROR;
+      }
+    } else {
+      n = c->need - c->unitLen;
+      if (n > bufLen) {
+	n = bufLen;
+      }
+
+      memcpy ((VOID*) (c->unit + c->unitLen), (VOID*) buffer, n);
+      c->unitLen += n;
+
+      if (c->unitLen == c->need) {
+	c->unitLen = 0;
+	if (DecodeUnit (c, c->unit, c->need, interp) != TCL_OK) {
+	  return TCL_ERROR;
+	}
+      }
+    }
+
+    buffer += n;
+    bufLen -= n;
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	FlushDecoder --
+ *
+ *	------------------------------------------------*
+ *	Checks that the input ended between frames.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+FlushDecoder (ctrlBlock, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (LZ4) */
+
+  if ((c->state != DEC_MAGIC) || (c->unitLen > 0)) {
+    Lz4Error (interp, "decompressor/flush", "unexpected eof");
+    ClearDecoder (ctrlBlock, clientData);
+    return TCL_ERROR;
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ClearDecoder --
+ *
+ *	------------------------------------------------*
+ *	Discard an incomplete frame, the next data is
+ *	expected to start a new frame.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ClearDecoder (ctrlBlock, clientData)
+Trf_ControlBlock ctrlBlock;
+ClientData clientData;
+{
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (LZ4) */
+
+  c->state   = DEC_MAGIC;
+  c->need    = 4;
+  c->unitLen = 0;
+  c->histLen = 0;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DecodeUnit --
+ *
+ *	------------------------------------------------*
+ *	Handles a complete unit of the frame format, as
+ *	expected by the current state, and determines the
+ *	next unit.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+#define LE32(p) (((unsigned int) (p) [0])       | \
+		 ((unsigned int) (p) [1] <<  8) | \
+		 ((unsigned int) (p) [2] << 16) | \
+		 ((unsigned int) (p) [3] << 24))
+
+static int
+DecodeUnit (c, data, length, interp)
+DecoderControl* c;
+unsigned char*  data;
+int             length;
+Tcl_Interp*     interp;
+{
+  unsigned int v;
+  int          n;
+
+  switch (c->state) {
+  case DEC_MAGIC:
+    v = LE32 (data);
+
+    if (v == FRAME_MAGIC) {
+      c->state = DEC_FLAGS;
+      c->need  = 2;
+    } else if ((v & SKIP_MASK) == SKIP_MAGIC) {
+      c->state = DEC_SKIPSIZE;
+      c->need  = 4;
+    } else {
+      Lz4Error (interp, "decompressor", "magic number corrupted");
+      goto error;
+    }
+    break;
+
+  case DEC_FLAGS:
+    c->flg = data [0];
+    c->bd  = data [1];
+
+    if (((c->flg & 0xc0) != FLG_VERSION) || (c->flg & 0x02) ||
+	(c->bd & 0x8f) || (((c->bd >> 4) & 0x7) < 4)) {
+      Lz4Error (interp, "decompressor", "frame descriptor corrupted");
+      goto error;
+    }
+    if (c->flg & FLG_DICTIONARY) {
+      Lz4Error (interp, "decompressor", "dictionaries are not supported");
+      goto error;
+    }
+
+    c->blockMax = 1 << (8 + 2 * ((c->bd >> 4) & 0x7));
+    c->state    = DEC_DESCRIPTOR;
+    c->need     = ((c->flg & FLG_SIZE) ? 8 : 0) + 1;
+    break;
+
+  case DEC_DESCRIPTOR:
+    {
+      Xxh32 hc;
+      unsigned char fb [2];
+
+      fb [0] = c->flg;
+      fb [1] = c->bd;
+
+      Xxh32Init   (&hc);
+      Xxh32Update (&hc, fb, 2);
+      Xxh32Update (&hc, data, length - 1);
+
+      if (((Xxh32Digest (&hc) >> 8) & 0xff) != data [length - 1]) {
+	Lz4Error (interp, "decompressor", "header checksum mismatch");
+	goto error;
+      }
+    }
+
+    /* Space for a block, its checksum, and the history before it */
+
+    n = c->blockMax + 4;
+    if (c->unitSize < n) {
+      c->unit     = (unsigned char*) ckrealloc ((char*) c->unit, n);
+      c->unitSize = n;
+    }
+
+    n = HISTORY + c->blockMax;
+    if (c->windowSize < n) {
+      if (c->window != (unsigned char*) NULL) {
+	ckfree ((char*) c->window);
+      }
+      c->window     = (unsigned char*) ckalloc (n);
+      c->windowSize = n;
+    }
+
+    c->histLen = 0;
+    Xxh32Init (&c->sum);
+
+    c->state = DEC_SIZE;
+    c->need  = 4;
+    break;
+
+  case DEC_SIZE:
+    v = LE32 (data);
+
+    if (v == 0) {
+      /* End mark */
+      if (c->flg & FLG_CONTENT_SUM) {
+	c->state = DEC_CHECKSUM;
+	c->need  = 4;
+      } else {
+	c->state = DEC_MAGIC;
+	c->need  = 4;
+      }
+      break;
+    }
+
+    c->stored = (v & STORED) != 0;
+    v        &= ~STORED;
+
+    if (v > (unsigned int) c->blockMax) {
+      Lz4Error (interp, "decompressor", "incoming data corrupted");
+      goto error;
+    }
+
+    c->state = DEC_BLOCK;
+    c->need  = v + ((c->flg & FLG_BLOCK_SUM) ? 4 : 0);
+    break;
+
+  case DEC_BLOCK:
+    if (c->flg & FLG_BLOCK_SUM) {
+      Xxh32 bs;
+
+      length -= 4;
+
+      Xxh32Init   (&bs);
+      Xxh32Update (&bs, data, length);
+
+      if (Xxh32Digest (&bs) != LE32 (data + length)) {
+	Lz4Error (interp, "decompressor", "block checksum mismatch");
+	goto error;
+      }
+    }
+
+    c->state = DEC_SIZE;
+    c->need  = 4;
+
+    return WriteBlock (c, data, length, interp);
+
+  case DEC_CHECKSUM:
+    if (Xxh32Digest (&c->sum) != LE32 (data)) {
+      Lz4Error (interp, "decompressor", "checksum mismatch");
+      goto error;
+    }
+
+    c->state = DEC_MAGIC;
+    c->need  = 4;
+    break;
+
+  case DEC_SKIPSIZE:
+    c->skip  = LE32 (data);
+    c->state = (c->skip > 0) ? DEC_SKIP : DEC_MAGIC;
+    c->need  = 4;
+    break;
+  }
+
+  return TCL_OK;
+
+ error:
+  ClearDecoder ((Trf_ControlBlock) c, (ClientData) NULL);
+  return TCL_ERROR;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	WriteBlock --
+ *
+ *	------------------------------------------------*
+ *	Decompresses a block, unless stored, and writes
+ *	the result. Linked blocks keep the last 64K of
+ *	output as the history of the next block.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+WriteBlock (c, data, length, interp)
+DecoderControl* c;
+unsigned char*  data;
+int             length;
+Tcl_Interp*     interp;
+{
+  int            linked = !(c->flg & FLG_INDEPENDENT);
+  unsigned char* out;
+  int            n, res;
+
+  if (c->stored) {
+    out = data;
+    n   = length;
+
+    if (linked) {
+      memcpy ((VOID*) (c->window + c->histLen), (VOID*) data, length);
+    }
+  } else {
+    n = Lz4Decompress (data, length, c->window, c->histLen,
+		       c->histLen + c->blockMax);
+    if (n < 0) {
+      Lz4Error (interp, "decompressor", "incoming data corrupted");
+      ClearDecoder ((Trf_ControlBlock) c, (ClientData) NULL);
+      return TCL_ERROR;
+    }
+    out = c->window + c->histLen;
+  }
+
+  Xxh32Update (&c->sum, out, n);
+  res = c->write (c->writeClientData, out, n, interp);
+
+  if (linked) {
+    c->histLen += n;
+    if (c->histLen > HISTORY) {
+      memmove ((VOID*) c->window, (VOID*) (c->window + c->histLen - HISTORY),
+	       HISTORY);
+      c->histLen = HISTORY;
+    }
+  }
+
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Lz4Error --
+ *
+ *	------------------------------------------------*
+ *	Append an error message to the interpreter.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+Lz4Error (interp, prefix, msg)
+Tcl_Interp* interp;
+CONST char* prefix;
+CONST char* msg;
+{
+  if (interp == (Tcl_Interp*) NULL) {
+    return;
+  }
+
+  Tcl_AppendResult (interp, "lz4 error (", prefix, "): ", msg, (char*) NULL);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Read32 --
+ *
+ *	------------------------------------------------*
+ *	Reads 4 bytes at an unaligned location, in host
+ *	byteorder.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		The value read.
+ *
+ *------------------------------------------------------*
+ */
+
+static unsigned int
+Read32 (p)
+CONST unsigned char* p;
+{
+  unsigned int v;
+
+  memcpy ((VOID*) &v, (VOID*) p, 4);
+  return v;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PutLength --
+ *
+ *	------------------------------------------------*
+ *	Writes the part of a literal or match length
+ *	beyond the 15 held by the token.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		The location after the length.
+ *
+ *------------------------------------------------------*
+ */
+
+static unsigned char*
+PutLength (op, n)
+unsigned char* op;
+int            n;
+{
+  for (n -= 15; n >= 255; n -= 255) {
+    *op++ = 255;
+  }
+  *op++ = n;
+  return op;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Lz4Compress --
+ *
+ *	------------------------------------------------*
+ *	Compresses a block into the LZ4 block format.
+ *	Larger 'acceleration' values skip ahead faster
+ *	while no match is found.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Writes at most BOUND (srcLen) bytes to 'dst'.
+ *
+ *	Result:
+ *		The size of the compressed block.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Lz4Compress (src, srcLen, dst, acceleration, table)
+CONST unsigned char* src;
+int                  srcLen;
+unsigned char*       dst;
+int                  acceleration;
+int*                 table;
+{
+  unsigned char* op         = dst;
+  unsigned char* token;
+  int            mflimit    = srcLen - MFLIMIT;
+  int            matchlimit = srcLen - LASTLITERALS;
+  int            ip         = 0;
+  int            anchor     = 0;
+  int            search     = acceleration << SKIP_TRIGGER;
+  int            ref, len, lit;
+  unsigned int   v, h;
+
+  memset ((VOID*) table, 0xff, HASH_SIZE * sizeof (int));
+
+  while (ip <= mflimit) {
+    v        = Read32 (src + ip);
+    h        = HASH (v);
+    ref      = table [h];
+    table [h] = ip;
+
+    if ((ref < 0) || (ip - ref > MAX_DISTANCE) ||
+	(Read32 (src + ref) != v)) {
+      ip += search++ >> SKIP_TRIGGER;
+      continue;
+    }
+
+    /* Extend the match backward, then forward */
+
+    while ((ip > anchor) && (ref > 0) && (src [ip-1] == src [ref-1])) {
+      ip--;
+      ref--;
+    }
+
+    len = MINMATCH;
+    while ((ip + len + 4 <= matchlimit) &&
+	   (Read32 (src + ip + len) == Read32 (src + ref + len))) {
+      len += 4;
+    }
+    while ((ip + len < matchlimit) && (src [ip+len] == src [ref+len])) {
+      len ++;
+    }
+
+    /* Sequence: token, literals, offset, match length */
+
+    lit   = ip - anchor;
+    token = op++;
+
+    if (lit >= 15) {
+      *token = 15 << 4;
+      op     = PutLength (op, lit);
+    } else {
+      *token = lit << 4;
+    }
+
+    memcpy ((VOID*) op, (VOID*) (src + anchor), lit);
+    op += lit;
+
+    *op++ = (ip - ref) & 0xff;
+    *op++ = (ip - ref) >> 8;
+
+    if (len - MINMATCH >= 15) {
+      *token |= 15;
+      op      = PutLength (op, len - MINMATCH);
+    } else {
+      *token |= len - MINMATCH;
+    }
+
+    ip    += len;
+    anchor = ip;
+    search = acceleration << SKIP_TRIGGER;
+
+    if (ip <= mflimit) {
+      table [HASH (Read32 (src + ip - 2))] = ip - 2;
+    }
+  }
+
+  /* Last literals */
+
+  lit   = srcLen - anchor;
+  token = op++;
+
+  if (lit >= 15) {
+    *token = 15 << 4;
+    op     = PutLength (op, lit);
+  } else {
+    *token = lit << 4;
+  }
+
+  memcpy ((VOID*) op, (VOID*) (src + anchor), lit);
+  op += lit;
+
+  return op - dst;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Lz4Decompress --
+ *
+ *	------------------------------------------------*
+ *	Decompresses a block in the LZ4 block format to
+ *	'dst' + 'dstPos'. Matches may reach back to the
+ *	start of 'dst'. Checks all lengths and offsets.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Writes to 'dst', up to 'dstMax'.
+ *
+ *	Result:
+ *		The number of bytes written, or -1 for
+ *		corrupted input.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Lz4Decompress (src, srcLen, dst, dstPos, dstMax)
+CONST unsigned char* src;
+int                  srcLen;
+unsigned char*       dst;
+int                  dstPos;
+int                  dstMax;
+{
+  int ip = 0;
+  int op = dstPos;
+  int token, lit, len, off, b;
+
+  for (;;) {
+    if (ip >= srcLen) {
+      return -1;
+    }
+
+    token = src [ip++];
+
+    lit = token >> 4;
+    if (lit == 15) {
+      do {
+	if (ip >= srcLen) {
+	  return -1;
+	}
+	b    = src [ip++];
+	lit += b;
+      } while (b == 255);
+    }
+
+    if ((lit > srcLen - ip) || (lit > dstMax - op)) {
+      return -1;
+    }
+
+    memcpy ((VOID*) (dst + op), (VOID*) (src + ip), lit);
+    ip += lit;
+    op += lit;
+
+    if (ip == srcLen) {
+      /* Last sequence, literals only */
+      break;
+    }
+
+    if (ip + 2 > srcLen) {
+      return -1;
+    }
+
+    off = src [ip] | (src [ip+1] << 8);
+    ip += 2;
+
+    if ((off == 0) || (off > op)) {
+      return -1;
+    }
+
+    len = token & 15;
+    if (len == 15) {
+      do {
+	if (ip >= srcLen) {
+	  return -1;
+	}
+	b    = src [ip++];
+	len += b;
+      } while (b == 255);
+    }
+    len += MINMATCH;
+
+    if (len > dstMax - op) {
+      return -1;
+    }
+
+    if (off >= len) {
+      memcpy ((VOID*) (dst + op), (VOID*) (dst + op - off), len);
+      op += len;
+    } else {
+      /* Overlapping, repeats the last 'off' bytes */
+      for (; len > 0; len--, op++) {
+	dst [op] = dst [op - off];
+      }
+    }
+  }
+
+  return op - dstPos;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Xxh32Init, Xxh32Update, Xxh32Digest --
+ *
+ *	------------------------------------------------*
+ *	The xxHash32 checksum (seed 0) used by the LZ4
+ *	frame format.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Update the state of the checksum.
+ *
+ *	Result:
+ *		Xxh32Digest returns the checksum of all data
+ *		seen so far. The state is not changed.
+ *
+ *------------------------------------------------------*
+ */
+
+#define PRIME1 (2654435761U)
+#define PRIME2 (2246822519U)
+#define PRIME3 (3266489917U)
+#define PRIME4  (668265263U)
+#define PRIME5  (374761393U)
+
+#define ROTL32(x,r) (((x) << (r)) | ((x) >> (32 - (r))))
+#define XXROUND(acc,in) ((acc) = ROTL32 ((acc) + (in) * PRIME2, 13) * PRIME1)
+
+static void
+Xxh32Init (x)
+Xxh32* x;
+{
+  x->v [0]  = PRIME1 + PRIME2;
+  x->v [1]  = PRIME2;
+  x->v [2]  = 0;
+  x->v [3]  = 0U - PRIME1;
+  x->total  = 0;
+  x->large  = 0;
+  x->memLen = 0;
+}
+
+static void
+Xxh32Update (x, data, length)
+Xxh32*               x;
+CONST unsigned char* data;
+int                  length;
+{
+  x->total += length;
+
+  if (x->memLen + length < 16) {
+    memcpy ((VOID*) (x->mem + x->memLen), (VOID*) data, length);
+    x->memLen += length;
+    return;
+  }
+
+  x->large = 1;
+
+  if (x->memLen > 0) {
+    int n = 16 - x->memLen;
+
+    memcpy ((VOID*) (x->mem + x->memLen), (VOID*) data, n);
+    data   += n;
+    length -= n;
+
+    XXROUND (x->v [0], LE32 (x->mem));
+    XXROUND (x->v [1], LE32 (x->mem + 4));
+    XXROUND (x->v [2], LE32 (x->mem + 8));
+    XXROUND (x->v [3], LE32 (x->mem + 12));
+    x->memLen = 0;
+  }
+
+  for (; length >= 16; data += 16, length -= 16) {
+    XXROUND (x->v [0], LE32 (data));
+    XXROUND (x->v [1], LE32 (data + 4));
+    XXROUND (x->v [2], LE32 (data + 8));
+    XXROUND (x->v [3], LE32 (data + 12));
+  }
+
+  memcpy ((VOID*) x->mem, (VOID*) data, length);
+  x->memLen = length;
+}
+
+static unsigned int
+Xxh32Digest (x)
+Xxh32* x;
+{
+  unsigned int         h;
+  CONST unsigned char* p   = x->mem;
+  int                  len = x->memLen;
+
+  if (x->large) {
+    h = ROTL32 (x->v [0], 1)  + ROTL32 (x->v [1], 7) +
+	ROTL32 (x->v [2], 12) + ROTL32 (x->v [3], 18);
+  } else {
+    h = PRIME5;
+  }
+
+  h += x->total;
+
+  for (; len >= 4; p += 4, len -= 4) {
+    h += LE32 (p) * PRIME3;
+    h  = ROTL32 (h, 17) * PRIME4;
+  }
+  for (; len > 0; p++, len--) {
+    h += (*p) * PRIME5;
+    h  = ROTL32 (h, 11) * PRIME1;
+  }
+
+  h ^= h >> 15;
+  h *= PRIME2;
+  h ^= h >> 13;
+  h *= PRIME3;
+  h ^= h >> 16;
+
+  return h;
+}
@@ -0,0 +1,1106 @@
+/*
+ * pipeline.c --
+ *
+ *	Implements and registers 'trf::pipeline', a transformation
+ *	running a sequence of other transformations (its stages) in a
+ *	single channel layer. The output of each stage is handed
+ *	directly to the conversion of the next one.
+ *
+ *
+ * Copyright (c) 2026 Andreas Kupries (andreas_kupries@users.sourceforge.net)
+ * All rights reserved.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL I LIABLE TO ANY PARTY FOR DIRECT, INDIRECT, SPECIAL,
+ * INCIDENTAL, OR CONSEQUENTIAL DAMAGES ARISING OUT OF THE USE OF THIS
+ * SOFTWARE AND ITS DOCUMENTATION, EVEN IF I HAVE BEEN ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * I SPECIFICALLY DISCLAIM ANY WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS ON AN "AS IS" BASIS, AND
+ * I HAVE NO OBLIGATION TO PROVIDE MAINTENANCE, SUPPORT, UPDATES,
+ * ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ * CVS: $Id$
+ */
+
+#include "transformInt.h"
+
+/*
+ * Converter description
+ * ---------------------
+ *
+ * A pipeline is specified by a list of stages, each a list containing
+ * the name of a transformation and its options, as for its command.
+ * The stages are listed in the order the data flows through them when
+ * writing, the last stage writes to the channel below.
+ *
+ * Encoding (writing, immediate mode):
+ *	Runs the stages in the given order, each in the direction
+ *	selected by its own options.
+ *
+ * Decoding (reading):
+ *	Runs the stages in reverse order, each in the opposite
+ *	direction, like the equivalent stack of attached
+ *	transformations.
+ */
+
+
+/*
+ * Declarations of internal procedures.
+ */
+
+static Trf_ControlBlock
+CreateEncoder  _ANSI_ARGS_ ((ClientData writeClientData, Trf_WriteProc *fun,
+			     Trf_Options optInfo, Tcl_Interp*   interp,
+			     ClientData clientData));
+static Trf_ControlBlock
+CreateDecoder  _ANSI_ARGS_ ((ClientData writeClientData, Trf_WriteProc *fun,
+			     Trf_Options optInfo, Tcl_Interp*   interp,
+			     ClientData clientData));
+static void
+DeletePipe     _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     ClientData clientData));
+static int
+Convert        _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     unsigned int character,
+			     Tcl_Interp* interp,
+			     ClientData clientData));
+static int
+ConvertBuffer  _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     unsigned char* buffer,
+			     int bufLen,
+			     Tcl_Interp* interp,
+			     ClientData clientData));
+static int
+FlushPipe      _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     Tcl_Interp* interp,
+			     ClientData clientData));
+static void
+ClearPipe      _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     ClientData clientData));
+static int
+MaxRead        _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     ClientData clientData));
+
+
+static Trf_Options
+CreateOptions  _ANSI_ARGS_ ((ClientData clientData));
+static void
+DeleteOptions  _ANSI_ARGS_ ((Trf_Options options,
+			     ClientData  clientData));
+static int
+CheckOptions   _ANSI_ARGS_ ((Trf_Options            options,
+			     Tcl_Interp*            interp,
+			     CONST Trf_BaseOptions* baseOptions,
+			     ClientData             clientData));
+static int
+SetOption      _ANSI_ARGS_ ((Trf_Options    options,
+			     Tcl_Interp*    interp,
+			     CONST char*    optname,
+			     CONST Tcl_Obj* optvalue,
+			     ClientData     clientData));
+static int
+QueryOptions   _ANSI_ARGS_ ((Trf_Options options,
+			     ClientData  clientData));
+
+
+static int
+PipelineObjCmd _ANSI_ARGS_ ((ClientData clientData, Tcl_Interp* interp,
+			     int objc, struct Tcl_Obj* CONST objv []));
+
+
+/*
+ * Option and converter definition.
+ */
+
+static Trf_OptionVectors optVec = /* THREADING: const, read-only => safe */
+{
+  CreateOptions,
+  DeleteOptions,
+  CheckOptions,
+  NULL,      /* no string procedure for 'SetOption' */
+  SetOption,
+  QueryOptions,
+  NULL       /* unseekable, no changes to the policy */
+};
+
+static Trf_TypeDefinition pipeDefinition = /* THREADING: const, read-only => safe */
+{
+  "trf::pipeline",
+  NULL, /* clientData not used by the pipeline, see 'PipeStage' */
+  &optVec,
+  {
+    CreateEncoder,
+    DeletePipe,
+    Convert,
+    ConvertBuffer,
+    FlushPipe,
+    ClearPipe,
+    MaxRead
+  }, {
+    CreateDecoder,
+    DeletePipe,
+    Convert,
+    ConvertBuffer,
+    FlushPipe,
+    ClearPipe,
+    MaxRead
+  },
+  TRF_UNSEEKABLE
+};
+
+/*
+ * Definition of the option block. A stage is resolved to the
+ * transformation it runs and the option block of that transformation
+ * by 'CheckOptions'.
+ */
+
+typedef struct _StageSpec_ {
+  Trf_RegistryEntry* entry;   /* Transformation run by the stage */
+  Trf_Options        optInfo; /* Its options, possibly NULL */
+  int                encode;  /* Boolean flag. Set if the stage encodes
+			       * when writing. */
+} StageSpec;
+
+typedef struct _PipeOptions_ {
+  Tcl_Obj*   stages;    /* List of stage specifications (-stages) */
+  int        numStages; /* Number of stages resolved so far */
+  StageSpec* spec;      /* Resolved stages, in the order of writing */
+} PipeOptions;
+
+/*
+ * Definition of the control block, for both directions. The stages
+ * are stored in the order the data flows through them. Each stage
+ * writes into the next through 'PipeWrite', the last one through the
+ * procedure given to the pipeline.
+ */
+
+typedef struct _PipeStage_ {
+  Trf_Vectors*     vectors;    /* Conversion run by the stage */
+  Trf_ControlBlock control;    /* Its state */
+  ClientData       clientData; /* Its clientData, see
+				* 'Trf_TypeDefinition' */
+} PipeStage;
+
+typedef struct _PipeControl_ {
+  int        numStages;
+  PipeStage* stages;
+} PipeControl;
+
+
+static Trf_ControlBlock
+CreateChain    _ANSI_ARGS_ ((ClientData writeClientData, Trf_WriteProc *fun,
+			     PipeOptions* o, Tcl_Interp* interp,
+			     int forward));
+static int
+ConvertStage   _ANSI_ARGS_ ((PipeStage* s, unsigned char* buffer,
+			     int bufLen, Tcl_Interp* interp));
+static int
+PipeWrite      _ANSI_ARGS_ ((ClientData clientData,
+			     unsigned char* outString, int outLen,
+			     Tcl_Interp* interp));
+static int
+ParseStage     _ANSI_ARGS_ ((Tcl_Interp* interp, Tcl_Obj* stage,
+			     CONST Trf_BaseOptions* baseOptions,
+			     StageSpec* spec));
+static void
+StageError     _ANSI_ARGS_ ((Tcl_Interp* interp, int i, CONST char* name));
+
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfInit_Pipeline --
+ *
+ *	------------------------------------------------*
+ *	Register the pipeline implemented in this file.
+ *	The command takes the list of stages as its first
+ *	argument, see 'PipelineObjCmd'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of 'Trf_Register'.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+int
+TrfInit_Pipeline (interp)
+Tcl_Interp* interp;
+{
+  Tcl_CmdInfo info;
+  int         res;
+
+  res = Trf_Register (interp, &pipeDefinition);
+
+  if (res != TCL_OK) {
+    return res;
+  }
+
+  if (Tcl_GetCommandInfo (interp, (char*) pipeDefinition.name, &info)) {
+    info.objProc = PipelineObjCmd;
+    Tcl_SetCommandInfo (interp, (char*) pipeDefinition.name, &info);
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PipelineObjCmd --
+ *
+ *	------------------------------------------------*
+ *	Implementation of 'trf::pipeline stages ?options?
+ *	?data?'. Hands the list of stages as option
+ *	-stages to the command procedure shared by all
+ *	transformations.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See 'TrfExecuteObjCmd'.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+PipelineObjCmd (clientData, interp, objc, objv)
+     ClientData              clientData;
+     Tcl_Interp*             interp;
+     int                     objc;
+     struct Tcl_Obj* CONST * objv;
+{
+  Tcl_Obj** args;
+  int       res;
+
+  if (objc < 2) {
+    Tcl_AppendResult (interp, "wrong # args: should be \"",
+		      Tcl_GetStringFromObj (objv [0], NULL),
+		      " stages ?options? ?data?\"", (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  args = (Tcl_Obj**) ckalloc ((objc + 1) * sizeof (Tcl_Obj*));
+
+  args [0] = objv [0];
+  args [1] = Tcl_NewStringObj ("-stages", -1);
+  memcpy ((VOID*) (args + 2), (VOID*) (objv + 1),
+	  (objc - 1) * sizeof (Tcl_Obj*));
+
+  Tcl_IncrRefCount (args [1]);
+  res = TrfExecuteObjCmd (clientData, interp, objc + 1, args);
+  Tcl_DecrRefCount (args [1]);
+
+  ckfree ((char*) args);
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CreateEncoder --
+ *
+ *	------------------------------------------------*
+ *	Allocate and initialize the control block of the
+ *	pipeline run when writing, and of all its stages.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		An opaque reference to the control block.
+ *
+ *------------------------------------------------------*
+ */
+
+static Trf_ControlBlock
+CreateEncoder (writeClientData, fun, optInfo, interp, clientData)
+ClientData    writeClientData;
+Trf_WriteProc *fun;
+Trf_Options   optInfo;
+Tcl_Interp*   interp;
+ClientData    clientData;
+{
+  return CreateChain (writeClientData, fun, (PipeOptions*) optInfo,
+		      interp, 1);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CreateDecoder --
+ *
+ *	------------------------------------------------*
+ *	Allocate and initialize the control block of the
+ *	pipeline run when reading, and of all its stages.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		An opaque reference to the control block.
+ *
+ *------------------------------------------------------*
+ */
+
+static Trf_ControlBlock
+CreateDecoder (writeClientData, fun, optInfo, interp, clientData)
+ClientData    writeClientData;
+Trf_WriteProc *fun;
+Trf_Options   optInfo;
+Tcl_Interp*   interp;
+ClientData    clientData;
+{
+  return CreateChain (writeClientData, fun, (PipeOptions*) optInfo,
+		      interp, 0);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CreateChain --
+ *
+ *	------------------------------------------------*
+ *	Creates the stages of a pipeline, last to first,
+ *	each writing into the one created before. If
+ *	'forward' is set the stages run in the specified
+ *	order and direction, else reversed.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		An opaque reference to the control block,
+ *		or NULL if a stage could not be created.
+ *
+ *------------------------------------------------------*
+ */
+
+static Trf_ControlBlock
+CreateChain (writeClientData, fun, o, interp, forward)
+ClientData    writeClientData;
+Trf_WriteProc *fun;
+PipeOptions*  o;
+Tcl_Interp*   interp;
+int           forward;
+{
+  PipeControl* c;
+  int          k, n = o->numStages;
+
+  c            = (PipeControl*) ckalloc (sizeof (PipeControl));
+  c->numStages = n;
+  c->stages    = (PipeStage*) ckalloc (n * sizeof (PipeStage));
+
+  for (k = n-1; k >= 0; k--) {
+    StageSpec*          spec = &o->spec [forward ? k : (n-1-k)];
+    Trf_TypeDefinition* type = spec->entry->trfType;
+    PipeStage*          s    = &c->stages [k];
+
+    /* Writing uses the direction selected by the options of the
+     * stage, reading the opposite one, as 'AttachTransform' does.
+     */
+
+    if (spec->encode == forward) {
+      s->vectors = &type->encoder;
+    } else {
+      s->vectors = &type->decoder;
+    }
+    s->clientData = type->clientData;
+
+    if (k == n-1) {
+      s->control = s->vectors->createProc (writeClientData, fun,
+					   spec->optInfo, interp,
+					   s->clientData);
+    } else {
+      s->control = s->vectors->createProc ((ClientData) &c->stages [k+1],
+					   PipeWrite,
+					   spec->optInfo, interp,
+					   s->clientData);
+    }
+
+    if (s->control == (Trf_ControlBlock) NULL) {
+      for (k++; k < n; k++) {
+	c->stages [k].vectors->deleteProc (c->stages [k].control,
+					   c->stages [k].clientData);
+      }
+      ckfree ((char*) c->stages);
+      ckfree ((char*) c);
+      return (Trf_ControlBlock) NULL;
+    }
+  }
+
+  return (Trf_ControlBlock) c;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DeletePipe --
+ *
+ *	------------------------------------------------*
+ *	Destroy the control block of a pipeline, and of
+ *	all its stages.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases the memory allocated by
+ *		'CreateChain'.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+DeletePipe (ctrlBlock, clientData)
+Trf_ControlBlock ctrlBlock;
+ClientData clientData;
+{
+  PipeControl* c = (PipeControl*) ctrlBlock;
+  int          k;
+
+  for (k = 0; k < c->numStages; k++) {
+    c->stages [k].vectors->deleteProc (c->stages [k].control,
+				       c->stages [k].clientData);
+  }
+
+  ckfree ((char*) c->stages);
+  ckfree ((char*) c);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Convert --
+ *
+ *	------------------------------------------------*
+ *	Runs a single character through the pipeline.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the stages.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Convert (ctrlBlock, character, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+unsigned int     character;
+Tcl_Interp*      interp;
+ClientData       clientData;
+{
+  unsigned char buf = character;
+
+  return ConvertBuffer (ctrlBlock, &buf, 1, interp, clientData);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ConvertBuffer --
+ *
+ *	------------------------------------------------*
+ *	Runs a buffer of characters through the pipeline.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the stages.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ConvertBuffer (ctrlBlock, buffer, bufLen, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+unsigned char*   buffer;
+int              bufLen;
+Tcl_Interp*      interp;
+ClientData       clientData;
+{
+  PipeControl* c = (PipeControl*) ctrlBlock;
+
+  return ConvertStage (&c->stages [0], buffer, bufLen, interp);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ConvertStage --
+ *
+ *	------------------------------------------------*
+ *	Runs a buffer through a single stage, using its
+ *	buffer procedure if it has one.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the stage, and the stages after it.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ConvertStage (s, buffer, bufLen, interp)
+PipeStage*     s;
+unsigned char* buffer;
+int            bufLen;
+Tcl_Interp*    interp;
+{
+  int i, res;
+
+  if (s->vectors->convertBufProc) {
+    return s->vectors->convertBufProc (s->control, buffer, bufLen,
+				       interp, s->clientData);
+  }
+
+  for (i = 0; i < bufLen; i++) {
+    res = s->vectors->convertProc (s->control, buffer [i], interp,
+				   s->clientData);
+    if (res != TCL_OK) {
+      return res;
+    }
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PipeWrite --
+ *
+ *	------------------------------------------------*
+ *	Write procedure of all stages but the last. Hands
+ *	the output of a stage to the next one.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the next stage.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+PipeWrite (clientData, outString, outLen, interp)
+ClientData     clientData;
+unsigned char* outString;
+int            outLen;
+Tcl_Interp*    interp;
+{
+  if (outLen == 0) {
+    return TCL_OK;
+  }
+
+  return ConvertStage ((PipeStage*) clientData, outString, outLen, interp);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	FlushPipe --
+ *
+ *	------------------------------------------------*
+ *	Flushes the stages, first to last. The data
+ *	flushed out of a stage is converted by the next
+ *	before that is flushed.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the stages.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+FlushPipe (ctrlBlock, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+Tcl_Interp*      interp;
+ClientData       clientData;
+{
+  PipeControl* c = (PipeControl*) ctrlBlock;
+  int          k, res;
+
+  for (k = 0; k < c->numStages; k++) {
+    res = c->stages [k].vectors->flushProc (c->stages [k].control, interp,
+					    c->stages [k].clientData);
+    if (res != TCL_OK) {
+      return res;
+    }
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ClearPipe --
+ *
+ *	------------------------------------------------*
+ *	Discards all information buffered in the stages.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the stages.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ClearPipe (ctrlBlock, clientData)
+Trf_ControlBlock ctrlBlock;
+ClientData       clientData;
+{
+  PipeControl* c = (PipeControl*) ctrlBlock;
+  int          k;
+
+  for (k = 0; k < c->numStages; k++) {
+    c->stages [k].vectors->clearProc (c->stages [k].control,
+				      c->stages [k].clientData);
+  }
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	MaxRead --
+ *
+ *	------------------------------------------------*
+ *	Query the first stage, which is the one reading
+ *	from the channel below, for the number of bytes
+ *	it accepts.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		The number of bytes, or -1 for no limit.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+MaxRead (ctrlBlock, clientData)
+Trf_ControlBlock ctrlBlock;
+ClientData       clientData;
+{
+  PipeStage* s = &((PipeControl*) ctrlBlock)->stages [0];
+
+  if (s->vectors->maxReadProc == (Trf_QueryMaxRead*) NULL) {
+    return -1;
+  }
+
+  return s->vectors->maxReadProc (s->control, s->clientData);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CreateOptions --
+ *
+ *	------------------------------------------------*
+ *	Create option structure for pipelines.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory and initializes it as
+ *		option structure for pipelines.
+ *
+ *	Result:
+ *		A reference to the allocated block of
+ *		memory.
+ *
+ *------------------------------------------------------*
+ */
+
+static Trf_Options
+CreateOptions (clientData)
+ClientData clientData;
+{
+  PipeOptions* o;
+
+  o = (PipeOptions*) ckalloc (sizeof (PipeOptions));
+  o->stages    = (Tcl_Obj*)   NULL;
+  o->numStages = 0;
+  o->spec      = (StageSpec*) NULL;
+
+  return (Trf_Options) o;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DeleteOptions --
+ *
+ *	------------------------------------------------*
+ *	Delete option structure of a pipeline, and the
+ *	option structures of its stages.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		A memory block allocated by 'CreateOptions'
+ *		is released.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+DeleteOptions (options, clientData)
+Trf_Options options;
+ClientData  clientData;
+{
+  PipeOptions* o = (PipeOptions*) options;
+  int          i;
+
+  for (i = 0; i < o->numStages; i++) {
+    StageSpec* spec = &o->spec [i];
+
+    if (spec->optInfo != (Trf_Options) NULL) {
+      spec->entry->trfType->options->deleteProc (spec->optInfo,
+					spec->entry->trfType->clientData);
+    }
+  }
+
+  if (o->spec != (StageSpec*) NULL) {
+    ckfree ((char*) o->spec);
+  }
+  if (o->stages != (Tcl_Obj*) NULL) {
+    Tcl_DecrRefCount (o->stages);
+  }
+
+  ckfree ((VOID*) o);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	CheckOptions --
+ *
+ *	------------------------------------------------*
+ *	Check the given option structure for errors, and
+ *	resolve the stages.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Fills the stage information of the given
+ *		structure. May complete the registration of
+ *		the transformations used by the stages.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+CheckOptions (options, interp, baseOptions, clientData)
+Trf_Options            options;
+Tcl_Interp*            interp;
+CONST Trf_BaseOptions* baseOptions;
+ClientData             clientData;
+{
+  PipeOptions* o = (PipeOptions*) options;
+  Tcl_Obj**    stages;
+  int          n, i;
+
+  if (o->stages == (Tcl_Obj*) NULL) {
+    Tcl_AppendResult (interp, "stages not specified", (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  if (TCL_OK != Tcl_ListObjGetElements (interp, o->stages, &n, &stages)) {
+    return TCL_ERROR;
+  }
+
+  if (n == 0) {
+    Tcl_AppendResult (interp, "pipeline without stages", (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  o->spec = (StageSpec*) ckalloc (n * sizeof (StageSpec));
+
+  for (i = 0; i < n; i++) {
+    StageSpec* spec = &o->spec [i];
+
+    spec->entry   = (Trf_RegistryEntry*) NULL;
+    spec->optInfo = (Trf_Options) NULL;
+    o->numStages  = i+1; /* Known to 'DeleteOptions' from here on */
+
+    if (TCL_OK != ParseStage (interp, stages [i], baseOptions, spec)) {
+      StageError (interp, i,
+		  (spec->entry ? spec->entry->name : (CONST char*) NULL));
+      return TCL_ERROR;
+    }
+
+    if (baseOptions->async &&
+	TrfIsInterpBound (spec->encode ?
+			  &spec->entry->trfType->encoder :
+			  &spec->entry->trfType->decoder)) {
+      Tcl_AppendResult (interp,
+			"-async not possible for a transformation ",
+			"evaluating scripts", (char*) NULL);
+      StageError (interp, i, spec->entry->name);
+      return TCL_ERROR;
+    }
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParseStage --
+ *
+ *	------------------------------------------------*
+ *	Resolves a stage specification into the
+ *	transformation to run and its options, like the
+ *	command of the transformation would.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Fills 'spec'. Allocates the option structure
+ *		of the transformation.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ParseStage (interp, stage, baseOptions, spec)
+Tcl_Interp*            interp;
+Tcl_Obj*               stage;
+CONST Trf_BaseOptions* baseOptions;
+StageSpec*             spec;
+{
+  Trf_TypeDefinition* type;
+  Trf_OptionVectors*  opt;
+  Tcl_Obj**           words;
+  int                 n, i, res;
+
+  if (TCL_OK != Tcl_ListObjGetElements (interp, stage, &n, &words)) {
+    return TCL_ERROR;
+  }
+
+  if (n == 0) {
+    Tcl_AppendResult (interp, "empty stage", (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  spec->entry = TrfLookupEntry (interp,
+				Tcl_GetStringFromObj (words [0], NULL));
+  if (spec->entry == (Trf_RegistryEntry*) NULL) {
+    return TCL_ERROR;
+  }
+
+  type = spec->entry->trfType;
+  opt  = type->options;
+
+  if ((n-1) % 2) {
+    Tcl_AppendResult (interp, "wrong # args, all options require an argument",
+		      (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  if (opt == (Trf_OptionVectors*) NULL) {
+    if (n > 1) {
+      Tcl_AppendResult (interp, "transformation has no options",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+
+    spec->encode = 1;
+    return TCL_OK;
+  }
+
+  spec->optInfo = opt->createProc (type->clientData);
+
+  for (i = 1; i < n; i += 2) {
+    CONST char* option = Tcl_GetStringFromObj (words [i], NULL);
+
+    if (opt->setObjProc == NULL) {
+      res = opt->setProc (spec->optInfo, interp, option,
+			  Tcl_GetStringFromObj (words [i+1], NULL),
+			  type->clientData);
+    } else {
+      res = opt->setObjProc (spec->optInfo, interp, option, words [i+1],
+			     type->clientData);
+    }
+
+    if (res != TCL_OK) {
+      return TCL_ERROR;
+    }
+  }
+
+  if (TCL_OK != opt->checkProc (spec->optInfo, interp, baseOptions,
+				type->clientData)) {
+    return TCL_ERROR;
+  }
+
+  spec->encode = (0 != opt->queryProc (spec->optInfo, type->clientData));
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	StageError --
+ *
+ *	------------------------------------------------*
+ *	Prefixes the error message in the interpreter
+ *	with the number and name of the failing stage.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+StageError (interp, i, name)
+Tcl_Interp* interp;
+int         i;
+CONST char* name;
+{
+  Tcl_Obj* msg = Tcl_GetObjResult (interp);
+  char     num [TCL_INTEGER_SPACE];
+
+  Tcl_IncrRefCount (msg);
+  Tcl_ResetResult  (interp);
+
+  sprintf (num, "%d", i+1);
+
+  Tcl_AppendResult (interp, "stage ", num, (char*) NULL);
+  if (name != (CONST char*) NULL) {
+    Tcl_AppendResult (interp, " (", name, ")", (char*) NULL);
+  }
+  Tcl_AppendResult (interp, ": ", Tcl_GetStringFromObj (msg, NULL),
+		    (char*) NULL);
+
+  Tcl_DecrRefCount (msg);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	SetOption --
+ *
+ *	------------------------------------------------*
+ *	Define value of given option.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Sets the given value into the option
+ *		structure
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+SetOption (options, interp, optname, optvalue, clientData)
+Trf_Options    options;
+Tcl_Interp*    interp;
+CONST char*    optname;
+CONST Tcl_Obj* optvalue;
+ClientData     clientData;
+{
+  PipeOptions* o   = (PipeOptions*) options;
+  int          len = strlen (optname);
+
+  if ((len < 2) || (0 != strncmp (optname, "-stages", len))) {
+    Tcl_AppendResult (interp, "unknown option '", optname,
+		      "', should be '-attach/in/out', '-async' or '-seekpolicy'",
+		      (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  /*
+   * Store reference. We have to unCONST it explicitly to allow
+   * modification of its reference counter.
+   */
+
+  if (o->stages != (Tcl_Obj*) NULL) {
+    Tcl_DecrRefCount (o->stages);
+  }
+  o->stages = (Tcl_Obj*) optvalue;
+  Tcl_IncrRefCount (o->stages);
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	QueryOptions --
+ *
+ *	------------------------------------------------*
+ *	Returns a value indicating wether the encoder or
+ *	decoder set of vectors is to be used by immediate
+ *	execution. A pipeline always runs its stages in
+ *	the specified order, the direction of each is
+ *	given by its own options.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None
+ *
+ *	Result:
+ *		1 - use encoder vectors.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+QueryOptions (options, clientData)
+Trf_Options options;
+ClientData clientData;
+{
+  return 1;
+}
@@ -147,7 +147,11 @@ TrfInit_Transform (interp)
 Tcl_Interp* interp;
 {
   TrfLock; /* THREADING: serialize initialization */
-  reflectDefinition.options = TrfTransformOptions ();
+  if (reflectDefinition.options == (Trf_OptionVectors*) NULL) {
+    TrfRegisterInterpBound (&reflectDefinition.encoder);
+    TrfRegisterInterpBound (&reflectDefinition.decoder);
+    reflectDefinition.options = TrfTransformOptions ();
+  }
   TrfUnlock;
 
   return Trf_Register (interp, &reflectDefinition);
@@ -28,6 +28,11 @@
  */
 
 #include "transformInt.h"
+#include <limits.h>
+
+#ifndef EOVERFLOW
+#define EOVERFLOW EINVAL
+#endif
 
 /*
  * Code used to associate the registry with an interpreter.
@@ -44,15 +49,6 @@ int n = 0;
  */
 #define CHANNEL_ASYNC		(1<<0) /* non-blocking mode */
 
-/*
- * Number of milliseconds to wait before firing an event to flush
- * out information waiting in buffers (fileevent support).
- *
- * Relevant for only Tcl 8.0 and beyond.
- */
-
-#define TRF_DELAY (5)
-
 /*
  * Structures used by an attached transformation procedure
  *
@@ -93,6 +89,9 @@ typedef struct _SeekConfig_ {
 				 * and the underlying channels; */
   int identity;                 /* Flag, set if 'identity' was forced by the
 				 * user. */
+  TrfSeekCheckpoint* checkpoint; /* Set if the unseekable decoder is able to
+				  * seek through a checkpoint index. See
+				  * 'SeekThroughIndex'. */
 } SeekConfig;
 
 
@@ -121,14 +120,16 @@ struct _SeekState_ {
   int                 allowed;  /* Flag. Set for seekable transforms. Derived
 				 * from the contents of 'used'. */
 
-  int upLoc;         /* Current location of file pointer in the
-		      * transformed stream. */
-  int upBufStartLoc; /* Same as above, for start of read buffer (result) */
-  int upBufEndLoc;   /* See above, for the character after the end of the
-		      * buffer. */
-  int downLoc;       /* Current location of the file pointer in the channel
-		      * downstream. */
-  int downZero;      /* location downstream equivalent to UpLoc == 0 */
+  Tcl_WideInt upLoc;         /* Current location of file pointer in the
+			      * transformed stream. */
+  Tcl_WideInt upBufStartLoc; /* Same as above, for start of read buffer
+			      * (result) */
+  Tcl_WideInt upBufEndLoc;   /* See above, for the character after the end
+			      * of the buffer. */
+  Tcl_WideInt downLoc;       /* Current location of the file pointer in the
+			      * channel downstream. */
+  Tcl_WideInt downZero;      /* location downstream equivalent to
+			      * UpLoc == 0 */
   int aheadOffset;   /* #Bytes DownLoc is after the down location of
 		      * BufEnd. Values > 0 indicate incomplete data in the
 		      * transform buffer itself. */
@@ -147,11 +148,16 @@ typedef struct _TrfTransformationInstance_ {
 
   Tcl_Channel self;   /* Our own channel handle */
   Tcl_Channel parent; /* The channel we are stacked upon. Relevant
-		       * only for values PATCH_ORIG and PATCH_832 of
-		       * 'patchVariant', see above. */
+		       * only for values PATCH_ORIG, PATCH_832 and
+		       * PATCH_85 of 'patchVariant', see above. */
 
   int readIsFlushed; /* flag to note wether in.flushProc was called or not */
 
+  struct _VectorsExt_* ext; /* Internal extensions of the decoder used
+			     * for reading, or NULL */
+  int pending;       /* flag, set if the decoder kept data for the next
+		      * call of its budget procedure, see 'TrfInput' */
+
   /* 04/13/1999 Fileevent patch from Matt Newman <matt@novadigm.com> */
 
   int flags;         /* currently CHANNEL_ASYNC or zero */
@@ -187,11 +193,12 @@ typedef struct _TrfTransformationInstance_ {
   int lastStored;
 
 
-  /* Timer for automatic push out of information sitting in various channel
-   * buffers. Used by the fileevent support. See 'ChannelHandler'.
+  /* Set while an event for the automatic push out of information
+   * sitting in various channel buffers is queued. Used by the
+   * fileevent support. See 'ChannelHandler' and 'EventSetup'.
    */
 
-  Tcl_TimerToken timer;
+  int readyQueued;
 
   /* Information about the chosen and used seek policy and wether the user
    * is allowed to change it. Runtime configuration.
@@ -204,6 +211,12 @@ typedef struct _TrfTransformationInstance_ {
 
   SeekState seekState;
 
+  /* Worker thread running the conversion of written data (-async), or
+   * NULL.
+   */
+
+  struct _AsyncWriter_* async;
+
 #ifdef TRF_STREAM_DEBUG
   char*         name;       /* Name of transformation command */
   unsigned long inCounter;  /* Number of bytes read from below */
@@ -220,9 +233,64 @@ typedef struct _TrfTransformationInstance_ {
 #define STREAM_OUT(t,bl,b)
 #endif
 
+#ifdef TCL_THREADS
+/*
+ * Conversion of written data by a worker thread (-async). 'TrfOutput'
+ * queues copies of the written buffers as jobs, the worker runs the
+ * conversion for them, and the thread owning the channel writes the
+ * results down, in order. It does so from an event posted by the
+ * worker, or whenever it has to wait for the worker anyway.
+ */
+
+typedef struct _AsyncJob_ {
+  struct _AsyncJob_* next;
+  unsigned char*     in;    /* Copy of the written data */
+  int                inLen;
+  ResultBuffer       out;   /* Result of its conversion */
+  int                res;   /* Tcl error code of its conversion */
+} AsyncJob;
+
+typedef struct _AsyncWriter_ {
+  TrfTransformationInstance* trans;
+
+  Tcl_Mutex     lock;        /* Protects the fields below */
+  Tcl_Condition cond;        /* Signaled for new jobs, finished jobs and
+			      * shutdown */
+  Tcl_ThreadId  worker;
+  Tcl_ThreadId  owner;       /* Thread the channel belongs to */
+  AsyncJob*     queue;       /* Jobs waiting for the worker */
+  AsyncJob*     queueTail;
+  AsyncJob*     done;        /* Jobs converted, waiting to be written down */
+  AsyncJob*     doneTail;
+  AsyncJob*     current;     /* Job run by the worker, see 'PutAsync' */
+  int           jobs;        /* Number of jobs not written down yet */
+  int           eventQueued; /* Set while an event for 'owner' is pending */
+  int           shutdown;    /* Set to stop the worker */
+
+  int           error;       /* POSIX error of a failed conversion or
+			      * write, or 0. Owner only. */
+} AsyncWriter;
+
+typedef struct _AsyncEvent_ {
+  Tcl_Event    header;
+  AsyncWriter* w;
+} AsyncEvent;
+#endif
+
+
+/* Event queued to signal readability of the information waiting in
+ * the result buffer of a transformation (fileevent support).
+ */
+
+typedef struct _ReadyEvent_ {
+  Tcl_Event                  header;
+  TrfTransformationInstance* trans;
+} ReadyEvent;
 
 #define INCREMENT (512)
 #define READ_CHUNK_SIZE 4096
+#define ASYNC_DEPTH (4) /* Max. number of written buffers waiting for the
+			 * worker of an -async attachment. */
 
 
 #define TRF_UP_CONVERT(trans,k) \
@@ -249,18 +317,21 @@ AllocChannelType _ANSI_ARGS_ ((int* sizePtr));
 static Tcl_ChannelType*
 InitializeChannelType _ANSI_ARGS_ ((CONST char* name, int patchVariant));
 
+static Tcl_ChannelType*
+GetChannelType _ANSI_ARGS_ ((CONST char* name, int patchVariant));
+
 
 static int
 TrfUnregister _ANSI_ARGS_ ((Tcl_Interp*       interp,
                             Trf_RegistryEntry* entry));
 
+static int
+TrfCompleteEntry _ANSI_ARGS_ ((Tcl_Interp*        interp,
+			       Trf_RegistryEntry* entry));
+
 static void
 TrfDeleteRegistry _ANSI_ARGS_ ((ClientData clientData, Tcl_Interp *interp));
 
-static int
-TrfExecuteObjCmd _ANSI_ARGS_((ClientData clientData, Tcl_Interp* interp,
-			      int objc, struct Tcl_Obj* CONST objv []));
-
 static void
 TrfDeleteCmd _ANSI_ARGS_((ClientData clientData));
 
@@ -290,6 +361,9 @@ TrfOutput _ANSI_ARGS_ ((ClientData instanceData,
 static int
 TrfSeek _ANSI_ARGS_ ((ClientData instanceData, long offset,
 		      int mode, int* errorCodePtr));
+static Tcl_WideInt
+TrfWideSeek _ANSI_ARGS_ ((ClientData instanceData, Tcl_WideInt offset,
+			  int mode, int* errorCodePtr));
 static void
 TrfWatch _ANSI_ARGS_ ((ClientData instanceData, int mask));
 
@@ -308,6 +382,10 @@ TrfSetOption _ANSI_ARGS_((ClientData instanceData, Tcl_Interp* interp,
 static int
 TrfNotify _ANSI_ARGS_((ClientData instanceData, int interestMask));
 #endif
+#if defined(USE_TCL_STUBS) && GT85
+static void
+TrfThreadAction _ANSI_ARGS_ ((ClientData instanceData, int action));
+#endif
 
 static int
 TransformImmediate _ANSI_ARGS_ ((Tcl_Interp* interp, Trf_RegistryEntry* entry,
@@ -344,15 +422,19 @@ PutInterpResult _ANSI_ARGS_ ((ClientData clientData,
 static void
 ChannelHandler _ANSI_ARGS_ ((ClientData clientData, int mask));
 
-static void
-ChannelHandlerTimer _ANSI_ARGS_ ((ClientData clientData));
+static int
+ChannelHandlerEvent _ANSI_ARGS_ ((Tcl_Event* evPtr, int flags));
+
+static int
+ChannelHandlerDelete _ANSI_ARGS_ ((Tcl_Event* evPtr, ClientData clientData));
 
 #ifdef USE_TCL_STUBS
 static Tcl_Channel
 DownChannel _ANSI_ARGS_ ((TrfTransformationInstance* ctrl));
 
-static int
-DownSeek _ANSI_ARGS_ ((TrfTransformationInstance* ctrl, int offset, int mode));
+static Tcl_WideInt
+DownSeek _ANSI_ARGS_ ((TrfTransformationInstance* ctrl, Tcl_WideInt offset,
+		       int mode));
 
 static int
 DownRead _ANSI_ARGS_ ((TrfTransformationInstance* ctrl,
@@ -393,14 +475,54 @@ DownGOpt _ANSI_ARGS_ ((Tcl_Interp* interp,
 #define NEW_TRANSFORM \
 (TrfTransformationInstance*) ckalloc (sizeof (TrfTransformationInstance));
 
-/* Procedures to handle the internal timer.
+/* Procedures to handle the internal readiness event.
+ */
+
+static void
+EventKill _ANSI_ARGS_ ((TrfTransformationInstance* trans));
+
+static void
+EventSetup _ANSI_ARGS_ ((TrfTransformationInstance* trans));
+
+#ifdef TCL_THREADS
+/* Procedures to handle the worker thread of -async attachments.
  */
 
+static AsyncWriter*
+AsyncCreate _ANSI_ARGS_ ((TrfTransformationInstance* trans));
+
+static int
+AsyncStart _ANSI_ARGS_ ((AsyncWriter* w));
+
+static void
+AsyncStop _ANSI_ARGS_ ((AsyncWriter* w));
+
+static int
+AsyncQueue _ANSI_ARGS_ ((AsyncWriter* w, CONST char* buf, int toWrite));
+
+static void
+AsyncWait _ANSI_ARGS_ ((AsyncWriter* w, int limit));
+
 static void
-TimerKill _ANSI_ARGS_ ((TrfTransformationInstance* trans));
+AsyncWriteDone _ANSI_ARGS_ ((AsyncWriter* w));
 
 static void
-TimerSetup _ANSI_ARGS_ ((TrfTransformationInstance* trans));
+AsyncRelease _ANSI_ARGS_ ((AsyncWriter* w));
+
+static Tcl_ThreadCreateType
+AsyncWorker _ANSI_ARGS_ ((ClientData clientData));
+
+static int
+AsyncEventProc _ANSI_ARGS_ ((Tcl_Event* evPtr, int flags));
+
+static int
+AsyncEventDelete _ANSI_ARGS_ ((Tcl_Event* evPtr, ClientData clientData));
+
+static int
+PutAsync _ANSI_ARGS_ ((ClientData clientData,
+		       unsigned char* outString, int outLen,
+		       Tcl_Interp* interp));
+#endif
 
 static void
 ChannelHandlerKS _ANSI_ARGS_ ((TrfTransformationInstance* trans, int mask));
@@ -419,6 +541,12 @@ static void             ResultDiscardAtStart _ANSI_ARGS_ ((ResultBuffer* r,
 							   int n));
 static void             ResultAdd    _ANSI_ARGS_ ((ResultBuffer* r,
                             unsigned char* buf, int toWrite));
+static unsigned char*   ResultReserve _ANSI_ARGS_ ((ResultBuffer* r,
+							int toWrite));
+static void             ResultCommit  _ANSI_ARGS_ ((ResultBuffer* r,
+							int written));
+static ResultBuffer*    WriteTarget   _ANSI_ARGS_ ((Trf_WriteProc* fun,
+						ClientData writeClientData));
 
 /*
  * Procedures to handle seeking information.
@@ -447,6 +575,40 @@ static void
 SeekPolicyGet _ANSI_ARGS_ ((TrfTransformationInstance* trans,
 			    char*                      policy));
 
+static Tcl_WideInt
+SeekThroughIndex _ANSI_ARGS_ ((TrfTransformationInstance* trans,
+			       Tcl_WideInt offset, int mode,
+			       int* errorCodePtr));
+
+/*
+ * Table of the internal extensions of vectors, i.e. seeking through
+ * a checkpoint index ('TrfRegisterCheckpointSeek'), decoding with an
+ * output budget ('TrfRegisterConvertBudget') and the binding to an
+ * interpreter ('TrfRegisterInterpBound').
+ */
+
+#define MAX_VECTORS_EXT (8)
+
+typedef struct _VectorsExt_ {
+  Trf_Vectors*       vectors;
+  TrfSeekCheckpoint* checkpoint;
+  TrfConvertBudget*  budget;
+  int                interpBound;
+} VectorsExt;
+
+static VectorsExt vectorsExt [MAX_VECTORS_EXT]; /* THREADING: serialize initialization */
+static int        numVectorsExt = 0;
+
+static VectorsExt*
+FindVectorsExt _ANSI_ARGS_ ((Trf_Vectors* vectors, int create));
+
+/*
+ * Budget for the output of a decoder, derived from the number of
+ * bytes requested by the reader.
+ */
+
+#define BUDGET(n) (((n) < READ_CHUNK_SIZE) ? READ_CHUNK_SIZE : (n))
+
 #ifdef TRF_DEBUG
 static void
 SeekDump _ANSI_ARGS_ ((TrfTransformationInstance* trans, CONST char* place));
@@ -490,6 +652,7 @@ Tcl_Interp* interp;
   if (registry == (Trf_Registry*) NULL) {
     registry           = (Trf_Registry*)  ckalloc (sizeof (Trf_Registry));
     registry->registry = (Tcl_HashTable*) ckalloc (sizeof (Tcl_HashTable));
+    registry->completing = 0;
 
     Tcl_InitHashTable (registry->registry, TCL_STRING_KEYS);
 
@@ -572,15 +735,31 @@ CONST Trf_TypeDefinition* type;
   registry = TrfGetRegistry (interp);
 
   /*
-   * Already defined ?
+   * Already defined ? An entry made by 'TrfRegisterLazy' is completed
+   * instead.
    */
 
-  hPtr = Tcl_FindHashEntry (registry->registry, (char*) type->name);
+  hPtr  = Tcl_FindHashEntry (registry->registry, (char*) type->name);
+  entry = (Trf_RegistryEntry*) NULL;
 
   if (hPtr != (Tcl_HashEntry*) NULL) {
-    PRINT ("Already defined!\n"); FL;
+    entry = (Trf_RegistryEntry*) Tcl_GetHashValue (hPtr);
+
+    if (entry->trfType != (Trf_TypeDefinition*) NULL) {
+      PRINT ("Already defined!\n"); FL;
+      DONE (Trf_Register);
+      return TCL_ERROR;
+    }
+  } else if (registry->completing > 0) {
+    /*
+     * An initialization procedure run by 'TrfCompleteEntry' announces
+     * a transformation whose command was deleted before its first use.
+     * Do not resurrect that command.
+     */
+
+    PRINT ("Deleted, skipped\n"); FL;
     DONE (Trf_Register);
-    return TCL_ERROR;
+    return TCL_OK;
   }
 
   /*
@@ -612,9 +791,22 @@ CONST Trf_TypeDefinition* type;
   assert (type->decoder.flushProc);
   assert (type->decoder.clearProc);
 
+  if (entry != (Trf_RegistryEntry*) NULL) {
+    /*
+     * The command exists already.
+     */
+
+    entry->trfType  = (Trf_TypeDefinition*) type;
+    entry->lazyInit = (TrfInitProc*) NULL;
+
+    DONE (Trf_Register);
+    return TCL_OK;
+  }
+
   /*
    * Generate command to execute transformations immediately or to generate
-   * filters.
+   * filters. The channel type is looked up by 'AttachTransform', when it is
+   * needed.
    */
 
   entry          = (Trf_RegistryEntry*) ckalloc (sizeof (Trf_RegistryEntry));
@@ -622,12 +814,9 @@ CONST Trf_TypeDefinition* type;
 
   entry->trfType    = (Trf_TypeDefinition*) type;
   entry->interp     = interp;
-#ifndef USE_TCL_STUBS
-  entry->transType  = InitializeChannelType (type->name, -1);
-#else
-  entry->transType  = InitializeChannelType (type->name,
-					     registry->patchVariant);
-#endif
+  entry->name       = type->name;
+  entry->lazyInit   = (TrfInitProc*) NULL;
+  entry->transType  = (Tcl_ChannelType*) NULL;
   entry->trfCommand = Tcl_CreateObjCommand (interp, (char*) type->name,
 					    TrfExecuteObjCmd,
 					    (ClientData) entry, TrfDeleteCmd);
@@ -643,6 +832,174 @@ CONST Trf_TypeDefinition* type;
   return TCL_OK;
 }
 
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfRegisterLazy --
+ *
+ *	------------------------------------------------*
+ *	Announce a transformation to the registry associated
+ *	with the specified interpreter, without registering
+ *	it yet. Only the command is created. Its first
+ *	invocation runs 'initProc', which has to call
+ *	'Trf_Register' for 'name'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		May create the registry. Allocates the
+ *		structure describing the announced
+ *		transformation.
+ *
+ *	Result:
+ *		A standard TCL error code.
+ *
+ *------------------------------------------------------*
+ */
+
+int
+TrfRegisterLazy (interp, name, initProc)
+Tcl_Interp*  interp;
+CONST char*  name;
+TrfInitProc* initProc;
+{
+  Trf_Registry*      registry;
+  Trf_RegistryEntry* entry;
+  Tcl_HashEntry*     hPtr;
+  int                new;
+
+  START (TrfRegisterLazy);
+  PRINT ("(\"%s\")\n", name); FL;
+
+  registry = TrfGetRegistry (interp);
+  hPtr     = Tcl_CreateHashEntry (registry->registry, (char*) name, &new);
+
+  if (!new) {
+    PRINT ("Already defined!\n"); FL;
+    DONE (TrfRegisterLazy);
+    return TCL_ERROR;
+  }
+
+  entry             = (Trf_RegistryEntry*) ckalloc (sizeof (Trf_RegistryEntry));
+  entry->registry   = registry;
+  entry->trfType    = (Trf_TypeDefinition*) NULL;
+  entry->transType  = (Tcl_ChannelType*) NULL;
+  entry->interp     = interp;
+  entry->name       = name;
+  entry->lazyInit   = initProc;
+  entry->trfCommand = Tcl_CreateObjCommand (interp, (char*) name,
+					    TrfExecuteObjCmd,
+					    (ClientData) entry, TrfDeleteCmd);
+
+  Tcl_SetHashValue (hPtr, entry);
+
+  DONE (TrfRegisterLazy);
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfCompleteEntry --
+ *
+ *	------------------------------------------------*
+ *	Completes the registration of a transformation
+ *	announced by 'TrfRegisterLazy'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the registration procedure of the
+ *		transformation. It may complete the entries
+ *		of other transformations too. Those whose
+ *		command was deleted are not registered again.
+ *
+ *	Result:
+ *		A standard TCL error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+TrfCompleteEntry (interp, entry)
+Tcl_Interp*        interp;
+Trf_RegistryEntry* entry;
+{
+  Trf_Registry* registry;
+  int           res;
+
+  START (TrfCompleteEntry);
+  PRINT ("(\"%s\")\n", entry->name); FL;
+
+  registry = TrfGetRegistry (interp);
+
+  registry->completing ++;
+  res = (*entry->lazyInit) (interp);
+  registry->completing --;
+
+  if ((res == TCL_OK) && (entry->trfType == (Trf_TypeDefinition*) NULL)) {
+    Tcl_AppendResult (interp, "unable to initialize transformation \"",
+		      entry->name, "\"", (char*) NULL);
+    res = TCL_ERROR;
+  }
+
+  DONE (TrfCompleteEntry);
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfLookupEntry --
+ *
+ *	------------------------------------------------*
+ *	Looks for the transformation 'name' in the
+ *	registry of the interpreter, and completes its
+ *	registration if it was announced only.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See 'TrfCompleteEntry'. Leaves an error
+ *		message in the interpreter upon failure.
+ *
+ *	Result:
+ *		The entry of the transformation, or NULL.
+ *
+ *------------------------------------------------------*
+ */
+
+Trf_RegistryEntry*
+TrfLookupEntry (interp, name)
+Tcl_Interp* interp;
+CONST char* name;
+{
+  Trf_Registry*      registry;
+  Trf_RegistryEntry* entry;
+  Tcl_HashEntry*     hPtr;
+
+  START (TrfLookupEntry);
+  PRINT ("(\"%s\")\n", name); FL;
+
+  registry = TrfGetRegistry (interp);
+  hPtr     = Tcl_FindHashEntry (registry->registry, (char*) name);
+
+  if (hPtr == (Tcl_HashEntry*) NULL) {
+    Tcl_AppendResult (interp, "unknown transformation \"", name, "\"",
+		      (char*) NULL);
+    DONE (TrfLookupEntry);
+    return (Trf_RegistryEntry*) NULL;
+  }
+
+  entry = (Trf_RegistryEntry*) Tcl_GetHashValue (hPtr);
+
+  if ((entry->lazyInit != (TrfInitProc*) NULL) &&
+      (TrfCompleteEntry (interp, entry) != TCL_OK)) {
+    DONE (TrfLookupEntry);
+    return (Trf_RegistryEntry*) NULL;
+  }
+
+  DONE (TrfLookupEntry);
+  return entry;
+}
+
 /*
  *------------------------------------------------------*
  *
@@ -672,10 +1029,8 @@ Trf_RegistryEntry* entry;
   START (Trf_Unregister);
 
   registry  = TrfGetRegistry    (interp);
-  hPtr      = Tcl_FindHashEntry (registry->registry,
-				 (char*) entry->trfType->name);
+  hPtr      = Tcl_FindHashEntry (registry->registry, (char*) entry->name);
 
-  ckfree ((char*) entry->transType);
   ckfree ((char*) entry);
 
   Tcl_DeleteHashEntry (hPtr);
@@ -758,7 +1113,7 @@ Tcl_Interp* interp;
  *------------------------------------------------------*
  */
 
-static int
+int
 TrfExecuteObjCmd (clientData, interp, objc, objv)
      ClientData              clientData;
      Tcl_Interp*             interp;
@@ -798,10 +1153,17 @@ TrfExecuteObjCmd (clientData, interp, objc, objv)
   baseOpt.source      = (Tcl_Channel) NULL;
   baseOpt.destination = (Tcl_Channel) NULL;
   baseOpt.policy      = (Tcl_Obj*)    NULL;
+  baseOpt.async       = 0;
 
   entry = (Trf_RegistryEntry*) clientData;
   cmd   = Tcl_GetStringFromObj (objv [0], NULL);
 
+  if ((entry->lazyInit != (TrfInitProc*) NULL) &&
+      (TrfCompleteEntry (interp, entry) != TCL_OK)) {
+    DONE (TrfExecuteObjCmd);
+    return TCL_ERROR;
+  }
+
   objc --;
   objv ++;
 
@@ -837,6 +1199,21 @@ TrfExecuteObjCmd (clientData, interp, objc, objv)
     switch (option [1])
       {
       case 'a':
+	if ((len > 2) && (0 == strncmp (option, "-async", len))) {
+	  if (wrong_number) {
+	    Tcl_AppendResult (interp, cmd, ": wrong # args, option \"", option, "\" requires an argument", (char*) NULL);
+	    OT;
+	    goto cleanup_after_error;
+	  }
+
+	  if (TCL_OK != Tcl_GetBooleanFromObj (interp, optarg,
+					       &baseOpt.async)) {
+	    OT;
+	    goto cleanup_after_error;
+	  }
+	  break;
+	}
+
 	if (0 != strncmp (option, "-attach", len))
 	  goto check_for_trans_option;
 
@@ -975,6 +1352,16 @@ TrfExecuteObjCmd (clientData, interp, objc, objv)
     goto cleanup_after_error;
   }
 
+  if ((baseOpt.attach == (Tcl_Channel) NULL) && baseOpt.async) {
+    Tcl_AppendResult (interp, cmd,
+		      ": inconsistent options, -async ",
+		      "not allowed without -attach",
+		      (char*) NULL);
+
+    PRINT ("Inconsistent options\n"); FL;
+    goto cleanup_after_error;
+  }
+
   if ((baseOpt.source == (Tcl_Channel) NULL) &&
       (baseOpt.attach == (Tcl_Channel) NULL))
     wrong_mod2 = 0;
@@ -1041,7 +1428,7 @@ TrfExecuteObjCmd (clientData, interp, objc, objv)
 unknown_option:
   PRINT ("Unknown option \"%s\"\n", option); FL; OT;
 
-  Tcl_AppendResult (interp, cmd, ": unknown option '", option, "', should be '-attach/in/out' or '-seekpolicy'",
+  Tcl_AppendResult (interp, cmd, ": unknown option '", option, "', should be '-attach/in/out', '-async' or '-seekpolicy'",
 		    (char*) NULL);
   /* fall through to cleanup */
 
@@ -1361,7 +1748,17 @@ Tcl_Interp* interp;
    */
 #endif
 
-  TimerKill (trans);
+  EventKill (trans);
+
+#ifdef TCL_THREADS
+  if (trans->async != (AsyncWriter*) NULL) {
+    /* Write everything converted by the worker, and stop it. The
+     * flush below then writes directly, see 'PutAsync'.
+     */
+
+    AsyncStop (trans->async);
+  }
+#endif
 
   /*
    * Flush data waiting in transformation buffers to output.
@@ -1400,6 +1797,12 @@ Tcl_Interp* interp;
 
   ResultClear (&trans->result);
 
+#ifdef TCL_THREADS
+  if (trans->async != (AsyncWriter*) NULL) {
+    AsyncRelease (trans->async);
+  }
+#endif
+
   /*
    * Complement to NEW_TRANSFORM in AttachChannel.
    * [Bug 2788106].
@@ -1446,6 +1849,16 @@ int*       errorCodePtr;
 
   /* should assert (trans->mode & TCL_READABLE) */
 
+#ifdef TCL_THREADS
+  if (trans->async != (AsyncWriter*) NULL) {
+    /* Reading and writing share the channel below. Complete the
+     * pending output first.
+     */
+
+    AsyncWait (trans->async, 0);
+  }
+#endif
+
   gotBytes = 0;
 
   SEEK_DUMP (TrfInput; Start);
@@ -1501,6 +1914,29 @@ int*       errorCodePtr;
      * Additionally: UP_CONVERT (DownLoc - AheadOffset) == BufEndLoc
      */
 
+    if (trans->pending) {
+      /* The decoder stopped at its budget during the last conversion,
+       * keeping the remainder of its input. Continue with that before
+       * reading more from below. The location downstream is not
+       * affected.
+       */
+
+      PRINT ("in_.budgetproc, pending\n"); FL;
+
+      trans->lastStored = 0;
+      res = trans->ext->budget (trans->in.control, (unsigned char*) NULL, 0,
+				BUDGET (toRead), &trans->pending,
+				(Tcl_Interp*) NULL, trans->clientData);
+
+      if (res != TCL_OK) {
+	*errorCodePtr = EINVAL;
+	PRINT ("Got %d, report error in transform (EINVAL)\n", gotBytes); FL;
+	DONE (TrfInput);
+	return -1;
+      }
+      continue; /* at: while (toRead > 0) */
+    }
+
     /*
      * Length (trans->result) == 0, toRead > 0 here  Use 'buf'! as target
      * to store the intermediary information read from the parent channel.
@@ -1645,7 +2081,19 @@ int*       errorCodePtr;
     SEEK_DUMP (TrfInput; Read<);
     trans->lastStored = 0;
 
-    if (trans->in.vectors->convertBufProc){ 
+    if (trans->ext && trans->ext->budget) {
+      /* Pull based decoding. The output of the decoder, and thus the
+       * memory used by the result buffer, is limited by the amount
+       * requested by our caller. Input not converted yet is kept by the
+       * decoder.
+       */
+
+      PRINT ("in_.budgetproc\n"); FL;
+
+      res = trans->ext->budget (trans->in.control, (unsigned char*) buf,
+				read, BUDGET (toRead), &trans->pending,
+				(Tcl_Interp*) NULL, trans->clientData);
+    } else if (trans->in.vectors->convertBufProc){ 
       PRINT ("in_.convertbufproc\n"); FL;
 
       res = trans->in.vectors->convertBufProc (trans->in.control,
@@ -1741,6 +2189,27 @@ int*       errorCodePtr;
     return 0;
   }
 
+#ifdef TCL_THREADS
+  if (trans->async != (AsyncWriter*) NULL) {
+    /* Hand the data to the worker. The channel is unseekable, only
+     * the location upstream is tracked.
+     */
+
+    if (TCL_OK != AsyncQueue (trans->async, buf, toWrite)) {
+      *errorCodePtr = trans->async->error;
+      PRINT ("error %d\n", *errorCodePtr); FL; DONE (TrfOutput);
+      return -1;
+    }
+
+    trans->seekState.upLoc        += toWrite;
+    trans->seekState.upBufStartLoc = trans->seekState.upLoc;
+    trans->seekState.upBufEndLoc   = trans->seekState.upLoc;
+
+    PRINT ("Queued: %d\n", toWrite); FL; DONE (TrfOutput);
+    return toWrite;
+  }
+#endif
+
   SEEK_DUMP (TrfOutput; Start);
 
   /* toWrite / seekState.used.numBytesTransform = #tuples converted.
@@ -1807,20 +2276,16 @@ int*       errorCodePtr;
  *
  *	------------------------------------------------*
  *	This procedure is called by the generic IO level
- *	to move the access point in a channel.
+ *	of cores before 8.5 to move the access point in a
+ *	channel. A wrapper around 'TrfWideSeek'.
  *	------------------------------------------------*
  *
  *	Sideeffects:
- *		Moves the location at which the channel
- *		will be accessed in future operations.
- *		Flushes all transformation buffers, then
- *		forwards it to the underlying channel.
+ *		See 'TrfWideSeek'.
  *
  *	Result:
- *		-1 if failed, the new position if
- *		successful. An output argument contains
- *		the POSIX error code if an error
- *		occurred, or zero.
+ *		See 'TrfWideSeek'. Locations beyond the
+ *		range of the result fail with EOVERFLOW.
  *
  *------------------------------------------------------*
  */
@@ -1832,13 +2297,57 @@ long       offset;		/* Size of movement. */
 int        mode;		/* How to move */
 int*       errorCodePtr;	/* Location of error flag. */
 {
-  TrfTransformationInstance* trans = (TrfTransformationInstance*) instanceData;
-  int         result;
+  Tcl_WideInt result = TrfWideSeek (instanceData, (Tcl_WideInt) offset,
+				    mode, errorCodePtr);
+
+  if (result > (Tcl_WideInt) INT_MAX) {
+    *errorCodePtr = EOVERFLOW;
+    return -1;
+  }
+
+  return (int) result;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfWideSeek --
+ *
+ *	------------------------------------------------*
+ *	This procedure is called by the generic IO level
+ *	of 8.5 and beyond to move the access point in a
+ *	channel.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Moves the location at which the channel
+ *		will be accessed in future operations.
+ *		Flushes all transformation buffers, then
+ *		forwards it to the underlying channel.
+ *
+ *	Result:
+ *		-1 if failed, the new position if
+ *		successful. An output argument contains
+ *		the POSIX error code if an error
+ *		occurred, or zero.
+ *
+ *------------------------------------------------------*
+ */
+
+static Tcl_WideInt
+TrfWideSeek (instanceData, offset, mode, errorCodePtr)
+ClientData  instanceData;	/* The channel to manipulate */
+Tcl_WideInt offset;		/* Size of movement. */
+int         mode;		/* How to move */
+int*        errorCodePtr;	/* Location of error flag. */
+{
+  TrfTransformationInstance* trans = (TrfTransformationInstance*) instanceData;
+  Tcl_WideInt result;
   Tcl_Channel parent;
-  int         newLoc;
+  Tcl_WideInt newLoc;
 
-  START (TrfSeek);
-  PRINT ("(Mode = %d, Offset = %ld)\n", mode, offset); FL;
+  START (TrfWideSeek);
+  PRINT ("(Mode = %d, Offset = %ld)\n", mode, (long) offset); FL;
 
   parent = DOWNC (trans);
 
@@ -1854,15 +2363,26 @@ int*       errorCodePtr;	/* Location of error flag. */
     /* Tell location.
      */
 
-    PRINT ("[Tell], Location = %d\n", trans->seekState.upLoc); FL;
-    DONE (TrfSeek);
+    PRINT ("[Tell], Location = %ld\n", (long) trans->seekState.upLoc); FL;
+    DONE (TrfWideSeek);
     return trans->seekState.upLoc;
   }
 
+  if (!trans->seekState.allowed &&
+      (trans->seekCfg.checkpoint != (TrfSeekCheckpoint*) NULL)) {
+    /* Unseekable, but the decoder remembers where to restart.
+     */
+
+    PRINT ("[Checkpoint index]\n"); FL;
+    result = SeekThroughIndex (trans, offset, mode, errorCodePtr);
+    DONE (TrfWideSeek);
+    return result;
+  }
+
   if (!trans->seekState.allowed) {
     *errorCodePtr = EINVAL;
 
-    PRINT ("[Unseekable]\n"); FL; DONE (TrfSeek);
+    PRINT ("[Unseekable]\n"); FL; DONE (TrfWideSeek);
     return -1;
   }
 
@@ -1882,8 +2402,8 @@ int*       errorCodePtr;	/* Location of error flag. */
     result = SEEK (trans, offset, mode);
     *errorCodePtr = (result == -1) ? Tcl_GetErrno () : 0;
 
-    SEEK_DUMP (TrfSeek; Pass<);
-    DONE (TrfSeek);
+    SEEK_DUMP (TrfWideSeek; Pass<);
+    DONE (TrfWideSeek);
     return result;
   }
 
@@ -1896,9 +2416,9 @@ int*       errorCodePtr;	/* Location of error flag. */
      */
 
     PRINT ("[Seek from start] => Seek relative\n"); FL;
-    result = TrfSeek (trans, offset - trans->seekState.upLoc, SEEK_CUR,
-		      errorCodePtr);
-    DONE (TrfSeek);
+    result = TrfWideSeek (trans, offset - trans->seekState.upLoc, SEEK_CUR,
+			  errorCodePtr);
+    DONE (TrfWideSeek);
     return result;
   }
 
@@ -1906,7 +2426,7 @@ int*       errorCodePtr;	/* Location of error flag. */
     /* Can't do that right now! TODO */
     *errorCodePtr = EINVAL;
 
-    PRINT ("[Seek from end not available]"); FL; DONE (TrfSeek);
+    PRINT ("[Seek from end not available]"); FL; DONE (TrfWideSeek);
     return -1;
   }
 
@@ -1922,7 +2442,7 @@ int*       errorCodePtr;	/* Location of error flag. */
     *errorCodePtr = EINVAL;
 
     PRINT ("Seek constrained to multiples of input tuples\n"); FL;
-    DONE (TrfSeek);
+    DONE (TrfWideSeek);
     return -1;
   }
 
@@ -1930,7 +2450,7 @@ int*       errorCodePtr;	/* Location of error flag. */
     *errorCodePtr = EINVAL;
 
     PRINT ("[Seek relative], cannot seek before start of stream\n"); FL;
-    DONE (TrfSeek);
+    DONE (TrfWideSeek);
     return -1;
   }
 
@@ -1941,7 +2461,7 @@ int*       errorCodePtr;	/* Location of error flag. */
      * equivalent position.
      */
 
-    int offsetDown, newDownLoc;
+    Tcl_WideInt offsetDown, newDownLoc;
 
     PRINT ("[Seek relative], beyond read buffer\n"); FL;
 
@@ -1960,8 +2480,8 @@ int*       errorCodePtr;	/* Location of error flag. */
     trans->seekState.upBufStartLoc = newLoc;
     trans->seekState.upBufEndLoc   = newLoc;
 
-    SEEK_DUMP (TrfSeek; NoBuf);
-    DONE (TrfSeek);
+    SEEK_DUMP (TrfWideSeek; NoBuf);
+    DONE (TrfWideSeek);
     return newLoc;
   }
 
@@ -1973,11 +2493,81 @@ int*       errorCodePtr;	/* Location of error flag. */
   SeekClearBuffer (trans, TCL_WRITABLE);
   trans->seekState.upLoc = newLoc;
 
-  SEEK_DUMP (TrfSeek; Base_);
-  DONE (TrfSeek);
+  SEEK_DUMP (TrfWideSeek; Base_);
+  DONE (TrfWideSeek);
   return newLoc;
 }
 
+#if defined(USE_TCL_STUBS) && GT85
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfThreadAction --
+ *
+ *	------------------------------------------------*
+ *	This procedure is called by the generic IO level
+ *	when the channel is cut from a thread, or spliced
+ *	into one (f.e. by 'thread::transfer').
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Moves the internal readiness event, if any,
+ *		from the thread the channel leaves to the
+ *		thread it enters.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+TrfThreadAction (instanceData, action)
+ClientData instanceData;	/* The channel moving between threads */
+int        action;		/* TCL_CHANNEL_THREAD_INSERT/REMOVE */
+{
+  TrfTransformationInstance* trans = (TrfTransformationInstance*) instanceData;
+
+  /* THREADING: Events are queued for the thread which posted them. An
+   * event left behind would be serviced in the old thread, on a channel
+   * owned by another. The generic layer calls us for each channel of
+   * the stack, so the channel below handles its own state.
+   */
+
+  if (action == TCL_CHANNEL_THREAD_REMOVE) {
+    EventKill (trans);
+  } else if ((trans->watchMask & TCL_READABLE) &&
+	     (ResultLength (&trans->result) > 0)) {
+    EventSetup (trans);
+  }
+
+#ifdef TCL_THREADS
+  if (trans->async != (AsyncWriter*) NULL) {
+    /* The results of the worker are written down by the thread owning
+     * the channel. Write all pending ones before leaving it, the new
+     * owner takes over afterward.
+     */
+
+    AsyncWriter* w = trans->async;
+
+    if (action == TCL_CHANNEL_THREAD_REMOVE) {
+      AsyncWait (w, 0);
+
+      Tcl_MutexLock (&w->lock);
+      w->eventQueued = 0;
+      Tcl_MutexUnlock (&w->lock);
+
+      Tcl_DeleteEvents (AsyncEventDelete, (ClientData) w);
+    } else {
+      Tcl_MutexLock (&w->lock);
+      w->owner = Tcl_GetCurrentThread ();
+      Tcl_MutexUnlock (&w->lock);
+    }
+  }
+#endif
+}
+#endif
+
 /*
  *------------------------------------------------------*
  *
@@ -2053,7 +2643,7 @@ int        mask;		/* Events of interest */
 
     ChannelHandlerKS (trans, mask);
 
-  } else if (trans->patchVariant == PATCH_832) {
+  } else if (trans->patchVariant >= PATCH_832) {
     /* 8.3.2 and up */
 
     Tcl_DriverWatchProc* watchProc;
@@ -2080,23 +2670,24 @@ int        mask;		/* Events of interest */
 #endif
 
   /*
-   * Management of the internal timer.
+   * Management of the internal readiness event.
    */
 
   if (!(mask & TCL_READABLE) || (ResultLength(&trans->result) == 0)) {
-    /* A pending timer may exist, but either is there no (more)
-     * interest in the events it generates or nothing is available
-     * for reading. Remove it, if existing.
+    /* A queued event may exist, but either is there no (more)
+     * interest in it or nothing is available for reading. Remove
+     * it, if existing.
      */
 
-    TimerKill (trans);
+    EventKill (trans);
   } else {
-    /* There might be no pending timer, but there is interest in
-     * readable events and we actually have data waiting, so
-     * generate a timer to flush that if it does not exist.
+    /* There is interest in readable events and we actually have
+     * data waiting. Signal that right away, through an event queued
+     * behind those already waiting, instead of waiting for the
+     * channel below, which has nothing to report.
      */
 
-    TimerSetup (trans);
+    EventSetup (trans);
   }
 
   DONE (TrfWatch);
@@ -2259,7 +2850,7 @@ TrfSetOption (instanceData, interp, optionName, value)
 	trans->seekState.downLoc     = TELL (trans);
 
 #ifdef USE_TCL_STUBS
-	if (trans->patchVariant == PATCH_832) {
+	if (trans->patchVariant >= PATCH_832) {
 	  trans->seekState.downLoc  -= Tcl_ChannelBuffered (parent);
 	}
 #endif
@@ -2430,14 +3021,14 @@ TrfNotify (instanceData, interestMask)
    * doesn't process such events thus returns the incoming mask
    * unchanged.
    *
-   * We do delete an existing timer. It was not fired, yet we are
-   * here, so the channel below generated such an event and we don't
-   * have to. The renewal of the interest after the execution of
-   * channel handlers will eventually cause us to recreate the timer
+   * We do delete a queued readiness event. It was not serviced, yet
+   * we are here, so the channel below generated such an event and we
+   * don't have to. The renewal of the interest after the execution of
+   * channel handlers will queue a new one if data is still waiting
    * (in TrfWatch).
    */
 
-  TimerKill ((TrfTransformationInstance*) instanceData);
+  EventKill ((TrfTransformationInstance*) instanceData);
   return interestMask;
 }
 #endif
@@ -2668,13 +3259,14 @@ Tcl_Interp*        interp;
   /* trans->standard.typePtr = entry->transType; */
   trans->clientData       = entry->trfType->clientData;
 
-  if (trans->patchVariant == PATCH_832) {
+  if (trans->patchVariant >= PATCH_832) {
     trans->parent = Tcl_GetTopChannel (baseOpt->attach);
   } else {
     trans->parent = baseOpt->attach;
   }
 
   trans->readIsFlushed    = 0;
+  trans->pending          = 0;
 
   /* 04/13/1999 Fileevent patch from Matt Newman <matt@novadigm.com>
    */
@@ -2685,7 +3277,8 @@ Tcl_Interp*        interp;
   trans->lastStored       = 0;
 
   trans->mode             = Tcl_GetChannelMode (baseOpt->attach);
-  trans->timer            = (Tcl_TimerToken) NULL;
+  trans->readyQueued      = 0;
+  trans->async            = (struct _AsyncWriter_*) NULL;
 
   if (ENCODE_REQUEST (entry, optInfo)) {
     /* ENCODE on write
@@ -2712,25 +3305,91 @@ Tcl_Interp*        interp;
 			  NULL);
   }
 
+  if (baseOpt->async) {
+    /* The conversion of written data is run by a worker thread. This
+     * requires a channel to write to, and a conversion which is not
+     * bound to its interpreter.
+     */
+
+    CONST char* msg = (CONST char*) NULL;
+#ifdef TCL_THREADS
+    VectorsExt* ext = ((trans->mode & TCL_WRITABLE) ?
+		       FindVectorsExt (trans->out.vectors, 0) :
+		       (VectorsExt*) NULL);
+
+    if (!(trans->mode & TCL_WRITABLE)) {
+      msg = "-async requires a channel open for writing";
+    } else if (ext && ext->interpBound) {
+      msg = "-async not possible for a transformation evaluating scripts";
+    }
+#else
+    msg = "-async requires a threaded core";
+#endif
+
+    if (msg != (CONST char*) NULL) {
+      Tcl_AppendResult (interp, entry->trfType->name, ": ", msg,
+			(char*) NULL);
+      ckfree ((char*) trans);
+      DONE (AttachTransform);
+      return TCL_ERROR;
+    }
+  }
+
   /* 'PutDestination' is ok for write, only read
    * requires 'PutTrans' and its internal buffer.
+   * With -async the worker collects the results
+   * through 'PutAsync'.
    */
 
   if (trans->mode & TCL_WRITABLE) {
     PRINT ("out.createproc\n"); FL;
 
+#ifdef TCL_THREADS
+    if (baseOpt->async) {
+      trans->async = AsyncCreate (trans);
+
+      trans->out.control = trans->out.vectors->createProc ((ClientData) trans->async,
+							   PutAsync,
+							   optInfo, interp,
+							   trans->clientData);
+    } else
+#endif
     trans->out.control = trans->out.vectors->createProc ((ClientData) trans,
 							 PutDestination,
 							 optInfo, interp,
 							 trans->clientData);
   
     if (trans->out.control == (Trf_ControlBlock) NULL) {
+#ifdef TCL_THREADS
+      if (trans->async != (AsyncWriter*) NULL) {
+	AsyncRelease (trans->async);
+      }
+#endif
+      ckfree ((char*) trans);
+      DONE (AttachTransform);
+      return TCL_ERROR;
+    }
+
+#ifdef TCL_THREADS
+    if ((trans->async != (AsyncWriter*) NULL) &&
+	(TCL_OK != AsyncStart (trans->async))) {
+      Tcl_AppendResult (interp, entry->trfType->name,
+			": unable to create the worker thread for -async",
+			(char*) NULL);
+
+      trans->out.vectors->deleteProc (trans->out.control, trans->clientData);
+      AsyncRelease (trans->async);
       ckfree ((char*) trans);
       DONE (AttachTransform);
       return TCL_ERROR;
     }
+#endif
   }
 
+  trans->ext = ((trans->mode & TCL_READABLE) ?
+		FindVectorsExt (trans->in.vectors, 0) :
+		(VectorsExt*) NULL);
+
   if (trans->mode & TCL_READABLE) {
     PRINT ("in_.createproc\n"); FL;
 
@@ -2740,6 +3399,12 @@ Tcl_Interp*        interp;
 							 trans->clientData);
 
     if (trans->in.control == (Trf_ControlBlock) NULL) {
+#ifdef TCL_THREADS
+      if (trans->async != (AsyncWriter*) NULL) {
+	AsyncStop    (trans->async);
+	AsyncRelease (trans->async);
+      }
+#endif
       ckfree ((char*) trans);
       DONE (AttachTransform);
       return TCL_ERROR;
@@ -2760,13 +3425,22 @@ Tcl_Interp*        interp;
    * thrashing far away memory)).
    */
 
+  if (entry->transType == (Tcl_ChannelType*) NULL) {
+#ifndef USE_TCL_STUBS
+    entry->transType = GetChannelType (entry->trfType->name, -1);
+#else
+    entry->transType = GetChannelType (entry->trfType->name,
+					entry->registry->patchVariant);
+#endif
+  }
+
 #ifndef USE_TCL_STUBS
   trans->self   = Tcl_StackChannel (interp, entry->transType,
 				    (ClientData) trans, trans->mode,
 				    trans->parent);
 #else
   if ((trans->patchVariant == PATCH_ORIG) ||
-      (trans->patchVariant == PATCH_832)) {
+      (trans->patchVariant >= PATCH_832)) {
 
     trans->self = Tcl_StackChannel (interp, entry->transType,
 				    (ClientData) trans, trans->mode,
@@ -2785,6 +3459,12 @@ Tcl_Interp*        interp;
 #endif
 
   if (trans->self == (Tcl_Channel) NULL) {
+#ifdef TCL_THREADS
+    if (trans->async != (AsyncWriter*) NULL) {
+      AsyncStop    (trans->async);
+      AsyncRelease (trans->async);
+    }
+#endif
     ckfree ((char*) trans);
     Tcl_AppendResult (interp, "internal error in Tcl_StackChannel",
 		      (char*) NULL);
@@ -2809,6 +3489,10 @@ Tcl_Interp*        interp;
     (*OPT->seekQueryProc) (interp, optInfo, &trans->seekCfg.natural, CLT);
   }
 
+  trans->seekCfg.checkpoint = ((trans->mode & TCL_READABLE) && trans->ext) ?
+			       trans->ext->checkpoint :
+			       (TrfSeekCheckpoint*) NULL;
+
   PRINTLN ("Determine Policy");
   SeekCalculatePolicies (trans);
 
@@ -3042,6 +3726,20 @@ Tcl_Interp*    interp;
   DUMP  (outLen, outString);
   PRINT ("}\n");
 
+  if (outLen > INT_MAX - INCREMENT - r->used) {
+    /* The result would not fit into a Tcl object. Fail instead of
+     * overflowing the buffer size.
+     */
+
+    if (interp != (Tcl_Interp*) NULL) {
+      Tcl_AppendResult (interp, "result of transformation too large",
+			(char*) NULL);
+    }
+
+    DONE (PutInterpResult);
+    return TCL_ERROR;
+  }
+
   ResultAdd (r, outString, outLen);
 
   DONE (PutInterpResult);
@@ -3103,7 +3801,7 @@ int            mask;
    * itself.
    */
 
-  if (trans->patchVariant == PATCH_832) {
+  if (trans->patchVariant >= PATCH_832) {
     Tcl_Panic ("Illegal value for 'patchVariant' in ChannelHandler");
   }
   if (trans->patchVariant == PATCH_ORIG) {
@@ -3113,30 +3811,31 @@ int            mask;
 
   /*
    * Check the I/O-Buffers of this channel for waiting information.
-   * Setup a timer generating an artificial event for us if we have
-   * such. We could call Tcl_NotifyChannel directly, but this would
-   * starve other event sources, so a timer is used to prevent that.
+   * Queue an artificial event for us if we have such. We could call
+   * Tcl_NotifyChannel directly, but this would recurse into the
+   * handlers and starve other event sources, so an event is queued
+   * to prevent that.
    */
 
-  TimerKill (trans);
+  EventKill (trans);
 
-  /* Check for waiting data, flush it out with a timer.
+  /* Check for waiting data, flush it out with an event.
    */
 
 #ifndef USE_TCL_STUBS
   if ((mask & TCL_READABLE) && ((ResultLength (&trans->result) > 0) ||
 				(Tcl_InputBuffered (trans->self) > 0))) {
-    TimerSetup (trans);
+    EventSetup (trans);
   }
 #else
   if (trans->patchVariant != PATCH_ORIG) {
     if ((mask & TCL_READABLE) && (ResultLength (&trans->result) > 0)) {
-      TimerSetup (trans);
+      EventSetup (trans);
     }
   } else {
     if ((mask & TCL_READABLE) && ((ResultLength (&trans->result) > 0) ||
 				  (Tcl_InputBuffered (trans->self) > 0))) {
-      TimerSetup (trans);
+      EventSetup (trans);
     }
   }
 #endif
@@ -3145,39 +3844,44 @@ int            mask;
 /*
  *------------------------------------------------------*
  *
- *	ChannelHandlerTimer --
+ *	ChannelHandlerEvent --
  *
  *	------------------------------------------------*
- *	Called by the notifier (-> timer) to flush out
- *	information waiting in channel buffers.
+ *	Called by the notifier (-> event queue) to flush
+ *	out information waiting in channel buffers.
  *	------------------------------------------------*
  *
  *	Sideeffects:
  *		As of 'ChannelHandler'.
  *
  *	Result:
- *		None.
+ *		1 if the event was handled, 0 else.
  *
  *------------------------------------------------------*
  */
 
-static void
-ChannelHandlerTimer (clientData)
-ClientData clientData; /* Transformation to query */
+static int
+ChannelHandlerEvent (evPtr, flags)
+     Tcl_Event* evPtr;
+     int        flags;
 {
-  TrfTransformationInstance* trans = (TrfTransformationInstance*) clientData;
+  TrfTransformationInstance* trans = ((ReadyEvent*) evPtr)->trans;
+
+  if (!(flags & TCL_FILE_EVENTS)) {
+    return 0;
+  }
 
-  trans->timer = (Tcl_TimerToken) NULL;
+  trans->readyQueued = 0;
 
 #ifndef USE_TCL_STUBS
   /* 8.0.x.
    * Use the channel handler itself to do the necessary actions
    */
 
-  ChannelHandler (clientData, trans->watchMask);
+  ChannelHandler ((ClientData) trans, trans->watchMask);
 #else
   if ((trans->patchVariant == PATCH_82) ||
-      (trans->patchVariant == PATCH_832)) {
+      (trans->patchVariant >= PATCH_832)) {
     /*
      * Use the standard notification mechanism to invoke all channel
      * handlers.
@@ -3187,9 +3891,40 @@ ClientData clientData; /* Transformation to query */
     /* PATCH_ORIG, seee 8.0.x
      */
 
-    ChannelHandler (clientData, trans->watchMask);
+    ChannelHandler ((ClientData) trans, trans->watchMask);
   }
 #endif
+  return 1;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ChannelHandlerDelete --
+ *
+ *	------------------------------------------------*
+ *	Filter for 'Tcl_DeleteEvents', selects the
+ *	readiness events queued for the transformation
+ *	in 'clientData'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		1 to delete the event, 0 else.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ChannelHandlerDelete (evPtr, clientData)
+     Tcl_Event* evPtr;
+     ClientData clientData;
+{
+  return ((evPtr->proc == ChannelHandlerEvent) &&
+	  (((ReadyEvent*) evPtr)->trans ==
+	   (TrfTransformationInstance*) clientData));
 }
 
 #ifdef USE_TCL_STUBS
@@ -3218,7 +3953,7 @@ DownSOpt (interp, ctrl, optionName, value)
 {
   Tcl_Channel parent = DOWNC (ctrl);
 
-  if (ctrl->patchVariant == PATCH_832) {
+  if (ctrl->patchVariant >= PATCH_832) {
     /*
      * The newly written patch forces direct use of the driver.
      */
@@ -3263,7 +3998,7 @@ DownGOpt (interp, ctrl, optionName, dsPtr)
 {
   Tcl_Channel parent = DOWNC (ctrl);
 
-  if (ctrl->patchVariant == PATCH_832) {
+  if (ctrl->patchVariant >= PATCH_832) {
     /*
      * The newly written patch forces direct use of the driver.
      */
@@ -3316,7 +4051,7 @@ DownWrite (ctrl, buf, toWrite)
 {
   Tcl_Channel parent = DOWNC (ctrl);
 
-  if (ctrl->patchVariant == PATCH_832) {
+  if (ctrl->patchVariant >= PATCH_832) {
     /*
      * The newly written patch forces use of the new raw-API.
      */
@@ -3353,7 +4088,7 @@ DownRead (ctrl, buf, toRead)
 {
   Tcl_Channel parent = DOWNC (ctrl);
 
-  if (ctrl->patchVariant == PATCH_832) {
+  if (ctrl->patchVariant >= PATCH_832) {
     /*
      * The newly written patch forces use of the new raw-API.
      */
@@ -3382,15 +4117,15 @@ DownRead (ctrl, buf, toRead)
  *------------------------------------------------------*
  */
 
-static int
+static Tcl_WideInt
 DownSeek (ctrl, offset, mode)
     TrfTransformationInstance* ctrl;
-    int                        offset;
+    Tcl_WideInt                offset;
     int                        mode;
 {
   Tcl_Channel parent = DOWNC (ctrl);
 
-  if (ctrl->patchVariant == PATCH_832) {
+  if (ctrl->patchVariant >= PATCH_832) {
     /*
      * The newly rewritten patch forces the transformation into
      * directly using the seek-proc of the downstream driver. Tcl_Seek
@@ -3402,12 +4137,25 @@ DownSeek (ctrl, offset, mode)
     Tcl_DriverSeekProc* parentSeekProc = Tcl_ChannelSeekProc (parentType);
     int                 errorCode;
 
+#if GT85
+    /* Prefer the wide seek of the driver below, if it has one. Its
+     * seekProc fails for locations beyond 2 GB.
+     */
+
+    if (((size_t) Tcl_ChannelVersion (parentType) >=
+	 (size_t) TCL_CHANNEL_VERSION_3) &&
+	(parentType->wideSeekProc != (Tcl_DriverWideSeekProc*) NULL)) {
+      return (*parentType->wideSeekProc) (Tcl_GetChannelInstanceData (parent),
+					  offset, mode, &errorCode);
+    }
+#endif
+
     if (parentSeekProc == (Tcl_DriverSeekProc*) NULL) {
       return -1;
     }
 
     return (*parentSeekProc) (Tcl_GetChannelInstanceData (parent),
-			      offset, mode, &errorCode);
+			      (long) offset, mode, &errorCode);
   }
 
   /*
@@ -3421,7 +4169,7 @@ DownSeek (ctrl, offset, mode)
    * Just use the standard 'Tcl_Seek'.
    */
 
-    return (int) Tcl_Seek (parent, offset, mode);
+    return (Tcl_WideInt) Tcl_Seek (parent, offset, mode);
 }
 
 /*
@@ -3448,7 +4196,7 @@ DownChannel (ctrl)
   Tcl_Channel next;
 
   if ((ctrl->patchVariant == PATCH_ORIG) ||
-      (ctrl->patchVariant == PATCH_832)) {
+      (ctrl->patchVariant >= PATCH_832)) {
     /*
      * Both the original patch for stacked channels and rewritten
      * implementation for 8.3.2. have simple semantics for getting at
@@ -3750,32 +4498,104 @@ ResultAdd (r, buf, toWrite)
     unsigned char* buf;     /* The buffer to read from */
     int            toWrite; /* The number of bytes in 'buf' */
 {
+  unsigned char* dst;
+
   START (ResultAdd);
   PRINT ("have %d, adding %d\n", r->used, toWrite); FL;
 
-  if ((r->used + toWrite + 1) > r->allocated) {
+  /* now copy data */
+  dst = ResultReserve (r, toWrite);
+  if (dst == (unsigned char*) NULL) {
+    Tcl_Panic ("Trf: result of transformation too large");
+  }
+
+  memcpy (dst, buf, toWrite);
+  ResultCommit (r, toWrite);
+
+  DONE (ResultAdd);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ResultReserve --
+ *
+ *	Makes room for the specified number of bytes at
+ *	the end of the buffer, without adding them. See
+ *	'ResultCommit'.
+ *
+ *	Sideeffects:
+ *		May reallocate the buffer area. The buffer
+ *		grows by at least its current size, to keep
+ *		the copying done by the reallocations linear,
+ *		except where that would exceed INT_MAX.
+ *
+ *	Result:
+ *		A reference to the free space, or NULL if
+ *		the buffer would grow beyond INT_MAX.
+ *
+ *------------------------------------------------------*
+ */
+
+static unsigned char*
+ResultReserve (r, toWrite)
+    ResultBuffer*  r;       /* The buffer to extend */
+    int            toWrite; /* The number of bytes to make room for */
+{
+  int size;
+
+  if (toWrite > INT_MAX - INCREMENT - r->used) {
+    return (unsigned char*) NULL;
+  }
+
+  if (toWrite >= r->allocated - r->used) {
     /* Extension of the internal buffer is required.
      */
 
+    size = r->used + toWrite + INCREMENT;
+    if ((r->allocated <= INT_MAX / 2) && (size < 2 * r->allocated)) {
+      size = 2 * r->allocated;
+    }
+
     if (r->allocated == 0) {
-      r->allocated = toWrite + INCREMENT;
-      r->buf       = (unsigned char*) ckalloc (r->allocated);
+      r->buf = (unsigned char*) ckalloc (size);
     } else {
-      r->allocated += toWrite + INCREMENT;
-      r->buf        = (unsigned char*) ckrealloc((char*) r->buf,
-						   r->allocated);
+      r->buf = (unsigned char*) ckrealloc((char*) r->buf, size);
     }
+
+    r->allocated = size;
   }
 
-  /* now copy data */
-  memcpy (r->buf + r->used, buf, toWrite);
-  r->used += toWrite;
+  return r->buf + r->used;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ResultCommit --
+ *
+ *	Adds the bytes written into the space returned by
+ *	'ResultReserve' to the buffer.
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ResultCommit (r, written)
+    ResultBuffer*  r;       /* The buffer to extend */
+    int            written; /* The number of bytes written */
+{
+  r->used += written;
 
   if (r->seekState != (SeekState*) NULL) {
-    r->seekState->upBufEndLoc += toWrite;
+    r->seekState->upBufEndLoc += written;
   }
-
-  DONE (ResultAdd);
 }
 
 /*
@@ -3818,15 +4638,24 @@ SeekCalculatePolicies (trans)
 
   TRF_SET_UNSEEKABLE (trans->seekCfg.chosen);
   trans->seekCfg.overideAllowed = 0;
+  trans->seekCfg.checkpoint     = (TrfSeekCheckpoint*) NULL;
 
 #else
   Tcl_Channel self = trans->self;
   Tcl_Channel next;
 
   int stopped = 0;
+  Tcl_WideInt upLoc, downLoc;
+  TrfSeekCheckpoint* checkpoint = trans->seekCfg.checkpoint;
 
   START (SeekCalculatePolicies);
 
+  /* Seeking through a checkpoint index is possible only under the
+   * same conditions as natural seeking, see (iii) below.
+   */
+
+  trans->seekCfg.checkpoint = (TrfSeekCheckpoint*) NULL;
+
   if (trans->patchVariant == PATCH_ORIG) {
     PRINTLN ("8.1., no Tcl_GetStackedChannel, unseekable, no overide");
 
@@ -3938,6 +4767,19 @@ SeekCalculatePolicies (trans)
 
       TRF_SET_UNSEEKABLE (trans->seekCfg.chosen);
       trans->seekCfg.overideAllowed = 1;
+
+      /* Seeking through the checkpoint index of the decoder restarts it
+       * for reading, this is not possible for a channel which is written
+       * too. The decoder may not build an index at all.
+       */
+
+      if ((checkpoint != (TrfSeekCheckpoint*) NULL) &&
+	  !(trans->mode & TCL_WRITABLE) &&
+	  (TCL_OK == checkpoint (trans->in.control, 0, 0, &upLoc, &downLoc,
+				 trans->clientData))) {
+	PRINTLN ("Seek through checkpoint index");
+	trans->seekCfg.checkpoint = checkpoint;
+      }
     } else {
       /* Take the natural ratio.
        */
@@ -3960,6 +4802,19 @@ SeekCalculatePolicies (trans)
 #ifdef USE_TCL_STUBS
 done:
 #endif
+#ifdef TCL_THREADS
+  if (trans->async != (AsyncWriter*) NULL) {
+    /* The location downstream is known only after the worker
+     * converted the written data. Not seekable.
+     */
+
+    PRINTLN ("asynchronous output, unseekable, no overide");
+
+    TRF_SET_UNSEEKABLE (trans->seekCfg.chosen);
+    trans->seekCfg.overideAllowed = 0;
+  }
+#endif
+
   trans->seekState.used.numBytesTransform =
     trans->seekCfg.chosen.numBytesTransform;
 
@@ -3996,10 +4851,11 @@ SeekInitialize (trans)
   trans->seekState.upBufStartLoc = 0;
   trans->seekState.upBufEndLoc   = 0;
 
-  if (trans->seekState.allowed) {
+  if (trans->seekState.allowed ||
+      (trans->seekCfg.checkpoint != (TrfSeekCheckpoint*) NULL)) {
     trans->seekState.downLoc     = TELL (trans);
 #ifdef USE_TCL_STUBS
-    if (trans->patchVariant == PATCH_832) {
+    if (trans->patchVariant >= PATCH_832) {
       trans->seekState.downLoc  -= Tcl_ChannelBuffered (DOWNC (trans));
     }
 #endif
@@ -4055,6 +4911,7 @@ SeekClearBuffer (trans, which)
 
     trans->in.vectors->clearProc  (trans->in.control, trans->clientData);
     trans->readIsFlushed = 0;
+    trans->pending       = 0;
     ResultClear (&trans->result);
   }
 }
@@ -4081,7 +4938,7 @@ SeekSynchronize (trans, parent)
      TrfTransformationInstance* trans;
      Tcl_Channel                parent;
 {
-  int offsetDown;
+  Tcl_WideInt offsetDown;
 
   if (!trans->seekState.allowed) {
     /* No synchronisation required for an unseekable transform */
@@ -4098,6 +4955,7 @@ SeekSynchronize (trans, parent)
 
   trans->in.vectors->clearProc  (trans->in.control, trans->clientData);
   trans->readIsFlushed = 0;
+  trans->pending       = 0;
 
   offsetDown  = TRF_DOWN_CONVERT (trans,
 				  trans->seekState.upLoc - trans->seekState.upBufEndLoc);
@@ -4287,19 +5145,19 @@ SeekStateGet (interp, state)
   LIST_ADDOBJ (error, list, sub);
 
   LIST_ADDSTR (error, list, "up");
-  LIST_ADDINT (error, list, state->upLoc);
+  LIST_ADDWIDE (error, list, state->upLoc);
 
   LIST_ADDSTR (error, list, "upBufStart");
-  LIST_ADDINT (error, list, state->upBufStartLoc);
+  LIST_ADDWIDE (error, list, state->upBufStartLoc);
 
   LIST_ADDSTR (error, list, "upBufEnd");
-  LIST_ADDINT (error, list, state->upBufEndLoc);
+  LIST_ADDWIDE (error, list, state->upBufEndLoc);
 
   LIST_ADDSTR (error, list, "down");
-  LIST_ADDINT (error, list, state->downLoc);
+  LIST_ADDWIDE (error, list, state->downLoc);
 
   LIST_ADDSTR (error, list, "downBase");
-  LIST_ADDINT (error, list, state->downZero);
+  LIST_ADDWIDE (error, list, state->downZero);
 
   LIST_ADDSTR (error, list, "downAhead");
   LIST_ADDINT (error, list, state->aheadOffset);
@@ -4421,10 +5279,10 @@ SeekDump (trans, place)
      TrfTransformationInstance* trans;
      CONST char*                place;
 {
-  int         loc;
+  long        loc;
   Tcl_Channel parent = DOWNC (trans);
 
-  loc = TELL (trans);
+  loc = (long) TELL (trans);
 
 #if 0
   PRINT ("SeekDump (%s) {\n", place); FL; IN;
@@ -4434,16 +5292,16 @@ SeekDump (trans, place)
 	 trans->seekState.used.numBytesDown); FL;
   PRINT ("seekable         %d\n",
 	 trans->seekState.allowed); FL;
-  PRINT ("up               %d [%d .. %d]\n",
-	 trans->seekState.upLoc,
-	 trans->seekState.upBufStartLoc,
-	 trans->seekState.upBufEndLoc); FL;
-  PRINT ("down             %d [%d] | %d\n",
-	 trans->seekState.downLoc,
+  PRINT ("up               %ld [%ld .. %ld]\n",
+	 (long) trans->seekState.upLoc,
+	 (long) trans->seekState.upBufStartLoc,
+	 (long) trans->seekState.upBufEndLoc); FL;
+  PRINT ("down             %ld [%d] | %ld\n",
+	 (long) trans->seekState.downLoc,
 	 trans->seekState.aheadOffset,
 	 loc); FL;
-  PRINT ("base             %d\n",
-	 trans->seekState.downZero); FL;
+  PRINT ("base             %ld\n",
+	 (long) trans->seekState.downZero); FL;
   PRINT ("identity force   %d\n",
 	 trans->seekCfg.identity); FL;
   PRINT ("seek while ident %d\n",
@@ -4463,18 +5321,18 @@ SeekDump (trans, place)
 	  trans->seekCfg.chosen.numBytesTransform,
 	  trans->seekCfg.chosen.numBytesDown); FL;
 #endif
-  NPRINT ("%2d:%2d /%1d |r %5d |u %5d [%5d..%5d] |d %5d [%2d] %5d | %5d | %1d %1d",
+  NPRINT ("%2d:%2d /%1d |r %5d |u %5ld [%5ld..%5ld] |d %5ld [%2d] %5ld | %5ld | %1d %1d",
 	  trans->seekState.used.numBytesTransform,
 	  trans->seekState.used.numBytesDown,
 	  trans->seekState.allowed,
 	  ResultLength (&trans->result),
-	  trans->seekState.upLoc,
-	  trans->seekState.upBufStartLoc,
-	  trans->seekState.upBufEndLoc,
-	  trans->seekState.downLoc,
+	  (long) trans->seekState.upLoc,
+	  (long) trans->seekState.upBufStartLoc,
+	  (long) trans->seekState.upBufEndLoc,
+	  (long) trans->seekState.downLoc,
 	  trans->seekState.aheadOffset,
 	  loc,
-	  trans->seekState.downZero,
+	  (long) trans->seekState.downZero,
 	  trans->seekCfg.identity,
 	  trans->seekState.changed
 	  ); FL;
@@ -4586,10 +5444,11 @@ InitializeChannelType (name, patchVariant)
    */
 
   tct           = AllocChannelType (&size);
-  tct->typeName = (char*) name;
 
   memset ((VOID*) tct, '\0', size);
 
+  tct->typeName = (char*) name;
+
   /*
    * Common elements of the structure (no changes in location or name)
    */
@@ -4632,14 +5491,31 @@ InitializeChannelType (name, patchVariant)
      * place.
      */
     tct->version = (Tcl_ChannelTypeVersion) TrfBlock;
-  } else /* patchVariant == PATCH_832 */ {
+  } else /* patchVariant >= PATCH_832 */ {
     /* For the 8.3.2 core we present ourselves as a version 2
      * driver. This means a speciial value in version (ex
      * blockModeProc), blockModeProc in a different place and of
      * course usage of the handlerProc.
      */
 
+#if GT85
+    if (patchVariant == PATCH_85) {
+      /* Compiled against and loaded into 8.5 or higher, we present
+       * ourselves as a version 5 driver, with wide seeks and a thread
+       * action. The latter allows the transfer of the channel to a
+       * different thread. Older cores do not know this version, and
+       * take it for version 1.
+       */
+
+      tct->version          = TCL_CHANNEL_VERSION_5;
+      tct->wideSeekProc     = TrfWideSeek;
+      tct->threadActionProc = TrfThreadAction;
+    } else {
+      tct->version          = TCL_CHANNEL_VERSION_2;
+    }
+#else
     tct->version       = TCL_CHANNEL_VERSION_2;
+#endif
     tct->blockModeProc = TrfBlock;
     tct->handlerProc   = TrfNotify;
   }
@@ -4657,7 +5533,7 @@ InitializeChannelType (name, patchVariant)
      * place.
      */
     tct->blockModeProc = TrfBlock;
-  } else /* patchVariant == PATCH_832 */ {
+  } else /* patchVariant >= PATCH_832 */ {
     /* For the 8.3.2 core we present ourselves as a version 2
      * driver. This means a special value in version (ex
      * blockModeProc), blockModeProc in a different place and of
@@ -4687,47 +5563,71 @@ InitializeChannelType (name, patchVariant)
 
   return tct;
 }
-
+
 /*
  *------------------------------------------------------*
  *
- *	TimerKill --
+ *	GetChannelType --
  *
- *	Timer management. Removes the internal timer
- *	if it exists.
+ *	Returns the channel type for transformations of
+ *	the given name. The types are shared by all
+ *	interpreters and threads. They are created on
+ *	first use and never released, as channels using
+ *	them may outlive the command of the
+ *	transformation.
  *
  *	Sideeffects:
- *		See above.
+ *		May allocate and initialize a channel type.
  *
  *	Result:
- *		None.
+ *		The channel type.
  *
  *------------------------------------------------------*
  */
 
-static void
-TimerKill (trans)
-     TrfTransformationInstance* trans;
+static Tcl_HashTable channelTypes;          /* THREADING: serialize access */
+static int           channelTypesInit = 0;  /* THREADING: serialize access */
+
+static Tcl_ChannelType*
+GetChannelType (name, patchVariant)
+     CONST char*      name;
+     int              patchVariant;
 {
-  if (trans->timer != (Tcl_TimerToken) NULL) {
-    /* Delete an existing flush-out timer,
-     * prevent it from firing on removed channel.
-     */
+  Tcl_ChannelType* tct;
+  Tcl_HashEntry*   hPtr;
+  int              new;
+
+  TrfLock; /* THREADING: serialize access */
+
+  if (!channelTypesInit) {
+    Tcl_InitHashTable (&channelTypes, TCL_STRING_KEYS);
+    channelTypesInit = 1;
+  }
+
+  hPtr = Tcl_CreateHashEntry (&channelTypes, (char*) name, &new);
 
-    Tcl_DeleteTimerHandler (trans->timer);
-    trans->timer = (Tcl_TimerToken) NULL;
+  if (new) {
+    /* The key is a copy of 'name' living as long as the type.
+     */
 
-    PRINT ("Timer deleted ..."); FL;
+    tct = InitializeChannelType (Tcl_GetHashKey (&channelTypes, hPtr),
+				 patchVariant);
+    Tcl_SetHashValue (hPtr, tct);
+  } else {
+    tct = (Tcl_ChannelType*) Tcl_GetHashValue (hPtr);
   }
+
+  TrfUnlock;
+  return tct;
 }
 
 /*
  *------------------------------------------------------*
  *
- *	TimerSetup --
+ *	EventKill --
  *
- *	Timer management. Creates the internal timer
- *	if it does not exist.
+ *	Event management. Removes the internal readiness
+ *	event from the queue if it is pending there.
  *
  *	Sideeffects:
  *		See above.
@@ -4739,22 +5639,29 @@ TimerKill (trans)
  */
 
 static void
-TimerSetup (trans)
+EventKill (trans)
      TrfTransformationInstance* trans;
 {
-  if (trans->timer == (Tcl_TimerToken) NULL) {
-    trans->timer = Tcl_CreateTimerHandler (TRF_DELAY, ChannelHandlerTimer,
-					   (ClientData) trans);
+  if (trans->readyQueued) {
+    /* Delete a pending flush-out event,
+     * prevent it from firing on removed channel.
+     */
+
+    Tcl_DeleteEvents (ChannelHandlerDelete, (ClientData) trans);
+    trans->readyQueued = 0;
+
+    PRINT ("Event deleted ..."); FL;
   }
 }
-
+
 /*
  *------------------------------------------------------*
  *
- *	ChannelHandlerKS --
+ *	EventSetup --
  *
- *	Management of channel handlers. Deletes/Recreates
- *	as required by the specified mask.
+ *	Event management. Queues the internal readiness
+ *	event if it is not pending already. It is placed
+ *	behind the events already waiting in the queue.
  *
  *	Sideeffects:
  *		See above.
@@ -4766,7 +5673,564 @@ TimerSetup (trans)
  */
 
 static void
-ChannelHandlerKS (trans, mask)
+EventSetup (trans)
+     TrfTransformationInstance* trans;
+{
+  if (!trans->readyQueued) {
+    ReadyEvent* ev = (ReadyEvent*) ckalloc (sizeof (ReadyEvent));
+
+    ev->header.proc = ChannelHandlerEvent;
+    ev->trans       = trans;
+
+    Tcl_QueueEvent ((Tcl_Event*) ev, TCL_QUEUE_TAIL);
+    trans->readyQueued = 1;
+  }
+}
+
+#ifdef TCL_THREADS
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncCreate --
+ *
+ *	------------------------------------------------*
+ *	Allocates and initializes the state of the worker
+ *	for an -async attachment. The thread itself is
+ *	created by 'AsyncStart'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		The new state.
+ *
+ *------------------------------------------------------*
+ */
+
+static AsyncWriter*
+AsyncCreate (trans)
+     TrfTransformationInstance* trans;
+{
+  AsyncWriter* w = (AsyncWriter*) ckalloc (sizeof (AsyncWriter));
+
+  w->trans       = trans;
+  w->lock        = (Tcl_Mutex) NULL;
+  w->cond        = (Tcl_Condition) NULL;
+  w->owner       = Tcl_GetCurrentThread ();
+  w->queue       = (AsyncJob*) NULL;
+  w->queueTail   = (AsyncJob*) NULL;
+  w->done        = (AsyncJob*) NULL;
+  w->doneTail    = (AsyncJob*) NULL;
+  w->current     = (AsyncJob*) NULL;
+  w->jobs        = 0;
+  w->eventQueued = 0;
+  w->shutdown    = 0;
+  w->error       = 0;
+
+  return w;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncStart --
+ *
+ *	------------------------------------------------*
+ *	Creates the worker thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+AsyncStart (w)
+     AsyncWriter* w;
+{
+  return Tcl_CreateThread (&w->worker, AsyncWorker, (ClientData) w,
+			   TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncStop --
+ *
+ *	------------------------------------------------*
+ *	Waits for the worker to convert all queued jobs,
+ *	writes their results down and then stops the
+ *	thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Writes to the channel below, joins the worker
+ *		thread.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+AsyncStop (w)
+     AsyncWriter* w;
+{
+  int result;
+
+  AsyncWait (w, 0);
+
+  Tcl_MutexLock (&w->lock);
+  w->shutdown = 1;
+  Tcl_ConditionNotify (&w->cond);
+  Tcl_MutexUnlock (&w->lock);
+
+  Tcl_JoinThread (w->worker, &result);
+
+  /* No events can be posted anymore, remove a pending one */
+
+  Tcl_DeleteEvents (AsyncEventDelete, (ClientData) w);
+  w->eventQueued = 0;
+
+  Tcl_MutexFinalize     (&w->lock);
+  Tcl_ConditionFinalize (&w->cond);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncQueue --
+ *
+ *	------------------------------------------------*
+ *	Hands a copy of the written data to the worker.
+ *	Blocks while ASYNC_DEPTH buffers are waiting
+ *	already, writing down the results of the worker
+ *	in the meantime.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory, may write to the channel
+ *		below.
+ *
+ *	Result:
+ *		A standard Tcl error code. The POSIX error
+ *		of a failure is in 'w->error'.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+AsyncQueue (w, buf, toWrite)
+     AsyncWriter* w;
+     CONST char*  buf;
+     int          toWrite;
+{
+  AsyncJob* j;
+
+  AsyncWait (w, ASYNC_DEPTH - 1);
+
+  if (w->error) {
+    return TCL_ERROR;
+  }
+
+  j        = (AsyncJob*) ckalloc (sizeof (AsyncJob));
+  j->next  = (AsyncJob*) NULL;
+  j->in    = (unsigned char*) ckalloc (toWrite);
+  j->inLen = toWrite;
+  j->res   = TCL_OK;
+  ResultInit (&j->out);
+  memcpy ((VOID*) j->in, (VOID*) buf, toWrite);
+
+  Tcl_MutexLock (&w->lock);
+
+  if (w->queueTail == (AsyncJob*) NULL) {
+    w->queue = j;
+  } else {
+    w->queueTail->next = j;
+  }
+  w->queueTail = j;
+  w->jobs ++;
+
+  Tcl_ConditionNotify (&w->cond);
+  Tcl_MutexUnlock (&w->lock);
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncWait --
+ *
+ *	------------------------------------------------*
+ *	Writes down the results of the worker until no
+ *	more than 'limit' jobs are outstanding. Blocks
+ *	as long as necessary.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Writes to the channel below.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+AsyncWait (w, limit)
+     AsyncWriter* w;
+     int          limit;
+{
+  int jobs;
+
+  while (1) {
+    AsyncWriteDone (w);
+
+    Tcl_MutexLock (&w->lock);
+    while ((w->jobs > limit) && (w->done == (AsyncJob*) NULL)) {
+      Tcl_ConditionWait (&w->cond, &w->lock, (Tcl_Time*) NULL);
+    }
+    jobs = w->jobs;
+    Tcl_MutexUnlock (&w->lock);
+
+    if (jobs <= limit) {
+      break;
+    }
+  }
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncWriteDone --
+ *
+ *	------------------------------------------------*
+ *	Writes the results of all jobs converted by the
+ *	worker to the channel below, in order. Called by
+ *	the thread owning the channel only. After a
+ *	failure the remaining results are discarded, the
+ *	error is reported by the next write.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Writes to the channel below, releases the
+ *		jobs.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+AsyncWriteDone (w)
+     AsyncWriter* w;
+{
+  TrfTransformationInstance* trans = w->trans;
+  AsyncJob* j;
+  AsyncJob* next;
+  int       n = 0;
+
+  Tcl_MutexLock (&w->lock);
+  j           = w->done;
+  w->done     = (AsyncJob*) NULL;
+  w->doneTail = (AsyncJob*) NULL;
+  Tcl_MutexUnlock (&w->lock);
+
+  if (j == (AsyncJob*) NULL) {
+    return;
+  }
+
+  for (; j != (AsyncJob*) NULL; j = next) {
+    next = j->next;
+    n ++;
+
+    if (w->error) {
+      /* Discard */
+    } else if (j->res != TCL_OK) {
+      w->error = EINVAL;
+    } else if (ResultLength (&j->out) > 0) {
+      if (WRITE (trans, (char*) j->out.buf, j->out.used) < 0) {
+	w->error = Tcl_GetErrno ();
+      } else {
+	trans->seekState.downLoc += j->out.used;
+      }
+    }
+
+    ResultClear (&j->out);
+    ckfree ((char*) j->in);
+    ckfree ((char*) j);
+  }
+
+  Tcl_MutexLock (&w->lock);
+  w->jobs -= n;
+  Tcl_ConditionNotify (&w->cond);
+  Tcl_MutexUnlock (&w->lock);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncRelease --
+ *
+ *	------------------------------------------------*
+ *	Releases the state of a worker stopped by
+ *	'AsyncStop'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Deallocates memory.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+AsyncRelease (w)
+     AsyncWriter* w;
+{
+  ckfree ((char*) w);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncWorker --
+ *
+ *	------------------------------------------------*
+ *	Body of the worker thread. Runs the conversion
+ *	of the queued jobs, in order, and notifies the
+ *	thread owning the channel about the results.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the conversion, posts events.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static Tcl_ThreadCreateType
+AsyncWorker (clientData)
+ClientData clientData;
+{
+  AsyncWriter*               w     = (AsyncWriter*) clientData;
+  TrfTransformationInstance* trans = w->trans;
+  AsyncJob* j;
+  int       i, res;
+
+  Tcl_MutexLock (&w->lock);
+
+  while (1) {
+    while ((w->queue == (AsyncJob*) NULL) && !w->shutdown) {
+      Tcl_ConditionWait (&w->cond, &w->lock, (Tcl_Time*) NULL);
+    }
+    if (w->queue == (AsyncJob*) NULL) {
+      break;
+    }
+
+    j = w->queue;
+    w->queue = j->next;
+    if (w->queue == (AsyncJob*) NULL) {
+      w->queueTail = (AsyncJob*) NULL;
+    }
+    j->next    = (AsyncJob*) NULL;
+    w->current = j;
+
+    Tcl_MutexUnlock (&w->lock);
+
+    /* The results are collected in the job, see 'PutAsync' */
+
+    if (trans->out.vectors->convertBufProc) {
+      res = trans->out.vectors->convertBufProc (trans->out.control,
+						j->in, j->inLen,
+						(Tcl_Interp*) NULL,
+						trans->clientData);
+    } else {
+      res = TCL_OK;
+      for (i=0; i < j->inLen; i++) {
+	res = trans->out.vectors->convertProc (trans->out.control, j->in [i],
+					       (Tcl_Interp*) NULL,
+					       trans->clientData);
+	if (res != TCL_OK) {
+	  break;
+	}
+      }
+    }
+    j->res = res;
+
+    Tcl_MutexLock (&w->lock);
+
+    w->current = (AsyncJob*) NULL;
+
+    if (w->doneTail == (AsyncJob*) NULL) {
+      w->done = j;
+    } else {
+      w->doneTail->next = j;
+    }
+    w->doneTail = j;
+
+    if (!w->eventQueued) {
+      AsyncEvent* ev = (AsyncEvent*) ckalloc (sizeof (AsyncEvent));
+
+      ev->header.proc = AsyncEventProc;
+      ev->w           = w;
+      w->eventQueued  = 1;
+
+      Tcl_ThreadQueueEvent (w->owner, (Tcl_Event*) ev, TCL_QUEUE_TAIL);
+      Tcl_ThreadAlert      (w->owner);
+    }
+
+    Tcl_ConditionNotify (&w->cond);
+  }
+
+  Tcl_MutexUnlock (&w->lock);
+
+  /* Run the exit handlers of the thread before 'AsyncStop' joins it.
+   * They release the scratch buffers and pools of the conversions it
+   * ran.
+   */
+
+  Tcl_ExitThread (0);
+  TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncEventProc --
+ *
+ *	------------------------------------------------*
+ *	Event posted by the worker to the thread owning
+ *	the channel. Writes the converted data down.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See 'AsyncWriteDone'.
+ *
+ *	Result:
+ *		1 if the event was handled, 0 else.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+AsyncEventProc (evPtr, flags)
+     Tcl_Event* evPtr;
+     int        flags;
+{
+  AsyncWriter* w = ((AsyncEvent*) evPtr)->w;
+
+  if (!(flags & TCL_FILE_EVENTS)) {
+    return 0;
+  }
+
+  Tcl_MutexLock (&w->lock);
+  w->eventQueued = 0;
+  Tcl_MutexUnlock (&w->lock);
+
+  AsyncWriteDone (w);
+  return 1;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	AsyncEventDelete --
+ *
+ *	------------------------------------------------*
+ *	Filter for 'Tcl_DeleteEvents', selects the events
+ *	posted for the worker in 'clientData'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		1 to delete the event, 0 else.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+AsyncEventDelete (evPtr, clientData)
+     Tcl_Event* evPtr;
+     ClientData clientData;
+{
+  return ((evPtr->proc == AsyncEventProc) &&
+	  (((AsyncEvent*) evPtr)->w == (AsyncWriter*) clientData));
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PutAsync --
+ *
+ *	------------------------------------------------*
+ *	Write procedure of -async attachments. Collects
+ *	the results of the worker in the job it runs.
+ *	Outside of the worker, i.e. during the final
+ *	flush, the data is written down directly.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory or writes to the channel
+ *		below.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+PutAsync (clientData, outString, outLen, interp)
+ClientData     clientData;
+unsigned char* outString;
+int            outLen;
+Tcl_Interp*    interp;
+{
+  AsyncWriter* w = (AsyncWriter*) clientData;
+
+  if (w->current == (AsyncJob*) NULL) {
+    return PutDestination ((ClientData) w->trans, outString, outLen, interp);
+  }
+
+  ResultAdd (&w->current->out, outString, outLen);
+  return TCL_OK;
+}
+#endif
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ChannelHandlerKS --
+ *
+ *	Management of channel handlers. Deletes/Recreates
+ *	as required by the specified mask.
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ChannelHandlerKS (trans, mask)
      TrfTransformationInstance* trans;
      int                        mask;
 {
@@ -4799,3 +6263,441 @@ ChannelHandlerKS (trans, mask)
 			      ChannelHandler, (ClientData) trans);
   }
 }
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfRegisterCheckpointSeek --
+ *
+ *	Declares that the decoder with the given vectors
+ *	is able to seek through a checkpoint index, and
+ *	the procedure to use for this.
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+void
+TrfRegisterCheckpointSeek (vectors, proc)
+     Trf_Vectors*       vectors;
+     TrfSeekCheckpoint* proc;
+{
+  /* THREADING: Called by the initialization of the transformations,
+   * with the lock held.
+   */
+
+  FindVectorsExt (vectors, 1)->checkpoint = proc;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfRegisterConvertBudget --
+ *
+ *	Declares that the decoder with the given vectors
+ *	is able to limit its output to a budget, and the
+ *	procedure to use for this.
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+void
+TrfRegisterConvertBudget (vectors, proc)
+     Trf_Vectors*      vectors;
+     TrfConvertBudget* proc;
+{
+  /* THREADING: Called by the initialization of the transformations,
+   * with the lock held.
+   */
+
+  FindVectorsExt (vectors, 1)->budget = proc;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfRegisterInterpBound --
+ *
+ *	Declares that the conversions with the given
+ *	vectors evaluate scripts in the interpreter they
+ *	were created for.
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+void
+TrfRegisterInterpBound (vectors)
+     Trf_Vectors* vectors;
+{
+  /* THREADING: Called by the initialization of the transformations,
+   * with the lock held.
+   */
+
+  FindVectorsExt (vectors, 1)->interpBound = 1;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfIsInterpBound --
+ *
+ *	Queries wether the conversions with the given
+ *	vectors were declared by 'TrfRegisterInterpBound'.
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		A boolean value.
+ *
+ *------------------------------------------------------*
+ */
+
+int
+TrfIsInterpBound (vectors)
+     Trf_Vectors* vectors;
+{
+  VectorsExt* ext = FindVectorsExt (vectors, 0);
+
+  return (ext != (VectorsExt*) NULL) && ext->interpBound;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	FindVectorsExt --
+ *
+ *	Looks for the internal extensions of the given
+ *	vectors.
+ *
+ *	Sideeffects:
+ *		Adds an empty entry if there is none and
+ *		'create' is set.
+ *
+ *	Result:
+ *		The entry, or NULL if the decoder has none.
+ *
+ *------------------------------------------------------*
+ */
+
+static VectorsExt*
+FindVectorsExt (vectors, create)
+     Trf_Vectors* vectors;
+     int          create;
+{
+  int i;
+
+  for (i = 0; i < numVectorsExt; i++) {
+    if (vectorsExt [i].vectors == vectors) {
+      return &vectorsExt [i];
+    }
+  }
+
+  if (!create) {
+    return (VectorsExt*) NULL;
+  }
+
+  if (numVectorsExt >= MAX_VECTORS_EXT) {
+    Tcl_Panic ("Trf: too many transformations with extended vectors");
+  }
+
+  vectorsExt [numVectorsExt].vectors    = vectors;
+  vectorsExt [numVectorsExt].checkpoint = (TrfSeekCheckpoint*) NULL;
+  vectorsExt [numVectorsExt].budget     = (TrfConvertBudget*) NULL;
+  vectorsExt [numVectorsExt].interpBound = 0;
+
+  return &vectorsExt [numVectorsExt ++];
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	SeekThroughIndex --
+ *
+ *	Seeks in an unseekable transformation whose
+ *	decoder has a checkpoint index. The decoder is
+ *	restarted at the nearest checkpoint before the
+ *	new location, unless the current state is nearer,
+ *	and everything up to the location is decoded and
+ *	thrown away.
+ *
+ *	Sideeffects:
+ *		Moves the location of the channel below.
+ *		Seeking behind the end of the stream leaves
+ *		the location at its end.
+ *
+ *	Result:
+ *		The new location, or -1 in case of an error.
+ *
+ *------------------------------------------------------*
+ */
+
+static Tcl_WideInt
+SeekThroughIndex (trans, offset, mode, errorCodePtr)
+     TrfTransformationInstance* trans;
+     Tcl_WideInt                offset;
+     int                        mode;
+     int*                       errorCodePtr;
+{
+  Tcl_WideInt newLoc, upLoc, downLoc, result;
+  int         n;
+  char buf [READ_CHUNK_SIZE];
+
+  START (SeekThroughIndex);
+
+  switch (mode) {
+  case SEEK_SET:
+    newLoc = offset;
+    break;
+  case SEEK_CUR:
+    newLoc = trans->seekState.upLoc + offset;
+    break;
+  default:
+    /* The length of the stream is not known, SEEK_END is impossible.
+     */
+    newLoc = -1;
+    break;
+  }
+
+  if (newLoc < 0) {
+    *errorCodePtr = EINVAL;
+
+    PRINT ("[Index], bad location or mode\n"); FL;
+    DONE (SeekThroughIndex);
+    return -1;
+  }
+
+  if ((trans->seekState.upBufStartLoc <= newLoc) &&
+      (newLoc <= trans->seekState.upBufEndLoc)) {
+    /* Still inside the read buffer, just adjust the position.
+     */
+
+    trans->seekState.upLoc = newLoc;
+
+    SEEK_DUMP (SeekThroughIndex; Buf_);
+    DONE (SeekThroughIndex);
+    return newLoc;
+  }
+
+  if (TCL_OK != trans->seekCfg.checkpoint (trans->in.control, newLoc, 0,
+					   &upLoc, &downLoc,
+					   trans->clientData)) {
+    *errorCodePtr = EINVAL;
+    DONE (SeekThroughIndex);
+    return -1;
+  }
+
+  if ((newLoc < trans->seekState.upBufEndLoc) ||
+      (upLoc  > trans->seekState.upBufEndLoc)) {
+    /* The location is behind the decoder, or the checkpoint is nearer
+     * to it than the decoder. Restart the decoder at the checkpoint.
+     */
+
+    PRINT ("[Index], restart at %ld / %ld\n", (long) upLoc,
+	   (long) downLoc); FL;
+
+    if (TCL_OK != trans->seekCfg.checkpoint (trans->in.control, newLoc, 1,
+					     &upLoc, &downLoc,
+					     trans->clientData)) {
+      *errorCodePtr = EINVAL;
+      DONE (SeekThroughIndex);
+      return -1;
+    }
+
+    result = SEEK (trans, trans->seekState.downZero + downLoc, SEEK_SET);
+
+    if (result == -1) {
+      *errorCodePtr = Tcl_GetErrno ();
+      DONE (SeekThroughIndex);
+      return -1;
+    }
+
+    trans->readIsFlushed           = 0;
+    trans->pending                 = 0;
+    trans->seekState.downLoc       = trans->seekState.downZero + downLoc;
+    trans->seekState.aheadOffset   = 0;
+    trans->seekState.upLoc         = upLoc;
+    ResultClear (&trans->result);
+  }
+
+  /* Decode up to the new location, throwing the result away.
+   */
+
+  while (trans->seekState.upLoc < newLoc) {
+    if (newLoc - trans->seekState.upLoc > READ_CHUNK_SIZE) {
+      n = READ_CHUNK_SIZE;
+    } else {
+      n = (int) (newLoc - trans->seekState.upLoc);
+    }
+
+    result = TrfInput ((ClientData) trans, buf, n, errorCodePtr);
+
+    if (result < 0) {
+      DONE (SeekThroughIndex);
+      return -1;
+    }
+    if (result == 0) {
+      PRINT ("[Index], stopped at end of stream\n"); FL;
+      break;
+    }
+  }
+
+  SEEK_DUMP (SeekThroughIndex; Done);
+  DONE (SeekThroughIndex);
+  return trans->seekState.upLoc;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	WriteTarget --
+ *
+ *	Determines the result buffer a write procedure
+ *	appends to, if it is one of the procedures of
+ *	this file doing so.
+ *
+ *	Sideeffects:
+ *		None.
+ *
+ *	Result:
+ *		The result buffer, or NULL.
+ *
+ *------------------------------------------------------*
+ */
+
+static ResultBuffer*
+WriteTarget (fun, writeClientData)
+     Trf_WriteProc* fun;
+     ClientData     writeClientData;
+{
+  if (fun == PutTrans) {
+    return &((TrfTransformationInstance*) writeClientData)->result;
+  }
+  if (fun == PutInterpResult) {
+    return (ResultBuffer*) writeClientData;
+  }
+#ifdef TCL_THREADS
+  if ((fun == PutAsync) &&
+      (((AsyncWriter*) writeClientData)->current != (AsyncJob*) NULL)) {
+    return &((AsyncWriter*) writeClientData)->current->out;
+  }
+#endif
+
+  return (ResultBuffer*) NULL;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfWriteReserve --
+ *
+ *	Returns space for at most 'size' bytes of output
+ *	(not more than TRF_SCRATCH_SIZE), to be handed to
+ *	the write procedure by 'TrfWriteCommit'. If the
+ *	procedure appends to a result buffer, this is the
+ *	free space at its end, the output is then not
+ *	copied again. Otherwise, and if the result buffer
+ *	cannot grow anymore, it is the scratch buffer of
+ *	the thread.
+ *
+ *	Sideeffects:
+ *		May allocate memory.
+ *
+ *	Result:
+ *		See above.
+ *
+ *------------------------------------------------------*
+ */
+
+unsigned char*
+TrfWriteReserve (fun, writeClientData, size)
+     Trf_WriteProc* fun;
+     ClientData     writeClientData;
+     int            size;
+{
+  ResultBuffer*  r = WriteTarget (fun, writeClientData);
+  unsigned char* buf;
+
+  if (r == (ResultBuffer*) NULL) {
+    return TrfScratchBuffer ();
+  }
+
+  buf = ResultReserve (r, size);
+
+  if (buf == (unsigned char*) NULL) {
+    /* The commit hands the output to the write procedure, which
+     * reports the overflow.
+     */
+
+    return TrfScratchBuffer ();
+  }
+
+  return buf;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfWriteCommit --
+ *
+ *	Writes the first 'length' bytes of the space
+ *	returned by 'TrfWriteReserve'. Nothing else may
+ *	be written through the procedure in between.
+ *
+ *	Sideeffects:
+ *		As of the write procedure.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+int
+TrfWriteCommit (fun, writeClientData, buffer, length, interp)
+     Trf_WriteProc* fun;
+     ClientData     writeClientData;
+     unsigned char* buffer;
+     int            length;
+     Tcl_Interp*    interp;
+{
+  ResultBuffer* r;
+
+  if (length == 0) {
+    return TCL_OK;
+  }
+
+  r = WriteTarget (fun, writeClientData);
+
+  if ((r == (ResultBuffer*) NULL) || (buffer != r->buf + r->used)) {
+    return TrfScratchWrite (fun, writeClientData, buffer, length, interp);
+  }
+
+  if (fun == PutTrans) {
+    TrfTransformationInstance* trans =
+      (TrfTransformationInstance*) writeClientData;
+
+    STREAM_OUT (trans, length, buffer);
+    trans->lastStored += length;
+  }
+
+  ResultCommit (r, length);
+  return TCL_OK;
+}
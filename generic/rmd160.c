@@ -62,6 +62,8 @@ static void MDrmd160_UpdateBuf _ANSI_ARGS_ ((VOID* context, unsigned char* buffe
 static void MDrmd160_Final     _ANSI_ARGS_ ((VOID* context, VOID* digest));
 static void CountLength  _ANSI_ARGS_ ((ripemd_context* ctx,
 				       unsigned int    nbytes));
+static void Compress     _ANSI_ARGS_ ((ripemd_context* ctx,
+				       unsigned char*  chunk));
 
 /*
  * Generator definition.
@@ -167,11 +169,7 @@ unsigned int   character;
 
   if (ctx->byteCount == CHUNK_SIZE) {
     CountLength (ctx, CHUNK_SIZE);
-
-#ifdef WORDS_BIGENDIAN
-    Trf_FlipRegisterLong (ctx->buf, CHUNK_SIZE);
-#endif
-    ripemd160_compress (ctx->state, (dword*) ctx->buf);
+    Compress    (ctx, ctx->buf);
     ctx->byteCount = 0;
   }
 }
@@ -224,26 +222,20 @@ int   bufLen;
       memcpy ((VOID*) (ctx->buf + ctx->byteCount), (VOID*) buffer, k);
 
       CountLength (ctx, CHUNK_SIZE);
-
-#ifdef WORDS_BIGENDIAN
-      Trf_FlipRegisterLong (ctx->buf, CHUNK_SIZE);
-#endif
-      ripemd160_compress (ctx->state, (dword*) ctx->buf);
+      Compress    (ctx, ctx->buf);
 
       buffer += k;
       bufLen -= k;
     } /* k == CHUNK_SIZE => internal buffer was empty, so skip it entirely */
 
+    /*
+     * Complete chunks are compressed directly out of the buffer of the
+     * caller, see 'Compress'.
+     */
+
     while (bufLen >= CHUNK_SIZE) {
       CountLength (ctx, CHUNK_SIZE);
-
-#ifdef WORDS_BIGENDIAN
-      Trf_FlipRegisterLong (buffer, CHUNK_SIZE);
-#endif
-      ripemd160_compress (ctx->state, (dword*) buffer);
-#ifdef WORDS_BIGENDIAN
-      Trf_FlipRegisterLong (buffer, CHUNK_SIZE);
-#endif
+      Compress    (ctx, buffer);
 
       buffer += CHUNK_SIZE;
       bufLen -= CHUNK_SIZE;
@@ -325,6 +317,43 @@ CountLength (ctx, nbytes)
   ctx->lowc += nbytes;
 }
 
+/*
+ *------------------------------------------------------*
+ *
+ *	Compress --
+ *
+ *	------------------------------------------------*
+ *	Compresses a chunk of CHUNK_SIZE bytes into the
+ *	state. The message words are assembled from the
+ *	bytes in little endian order, so neither the
+ *	alignment of the chunk nor the byte order of the
+ *	host matter, and the chunk is not modified.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+Compress (ctx, chunk)
+     ripemd_context* ctx;
+     unsigned char*  chunk;
+{
+  dword X [CHUNK_SIZE/4];
+  int   i;
+
+  for (i=0; i < (CHUNK_SIZE/4); i++, chunk += 4) {
+    X [i] = BYTES_TO_DWORD (chunk);
+  }
+
+  ripemd160_compress (ctx->state, X);
+}
+
 /*
  * External code from here on.
  */
@@ -228,11 +228,18 @@ int   bufLen;
       bufLen -= k;
     } /* k == CHUNK_SIZE => internal buffer was empty, so skip it entirely */
 
-    while (bufLen > CHUNK_SIZE) {
-      sha_update (&s->s, buffer, CHUNK_SIZE);
+    /*
+     * All complete chunks in the buffer are handed to 'sha_update' in one
+     * call, which reads them directly from there.
+     */
+
+    k = bufLen - (bufLen % CHUNK_SIZE);
 
-      buffer += CHUNK_SIZE;
-      bufLen -= CHUNK_SIZE;
+    if (k > 0) {
+      sha_update (&s->s, buffer, k);
+
+      buffer += k;
+      bufLen -= k;
     }
 
     s->count = bufLen;
@@ -160,18 +160,25 @@ SHA_INFO *sha_info;
 void sha_update(sha_info, buffer, count)
 SHA_INFO *sha_info; BYTE *buffer; int count;
 {
+    int i;
+
     if ((sha_info->count_lo + ((UINT32) count << 3)) < sha_info->count_lo) {
 	++sha_info->count_hi;
     }
     sha_info->count_lo += (UINT32) count << 3;
     sha_info->count_hi += (UINT32) count >> 29;
     while (count >= SHA_BLOCKSIZE) {
-	memcpy(sha_info->data, buffer, SHA_BLOCKSIZE);
-#ifdef LITTLE_ENDIAN
-	byte_reverse(sha_info->data, SHA_BLOCKSIZE);
-#endif /* LITTLE_ENDIAN */
+	/* aku: assemble the big endian message words directly out of the
+	 * (possibly unaligned) buffer, instead of copying the block and
+	 * reversing it in place on little endian machines.
+	 */
+	for (i = 0; i < SHA_BLOCKSIZE/4; ++i, buffer += 4) {
+	    sha_info->data[i] = ((UINT32) buffer[0] << 24) |
+				((UINT32) buffer[1] << 16) |
+				((UINT32) buffer[2] <<  8) |
+				 (UINT32) buffer[3];
+	}
 	sha_transform(sha_info);
-	buffer += SHA_BLOCKSIZE;
 	count -= SHA_BLOCKSIZE;
     }
     memcpy(sha_info->data, buffer, count);
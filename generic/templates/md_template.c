@@ -39,23 +39,41 @@
  */
 
 #define DIGEST_SIZE               (0)
-#define CTX_TYPE                  XXX
+#define CHUNK_SIZE                (64)
+#define CTX_TYPE                  xxx_trf_info
+
+/*
+ * The algorithm core is assumed to process complete chunks only. The
+ * context therefore carries the bytes of an incomplete chunk across
+ * calls.
+ */
+
+typedef struct _xxx_trf_info {
+  XXX            s;
+  unsigned short count;
+  unsigned char  buf [CHUNK_SIZE];
+} xxx_trf_info;
 
 /*
  * Declarations of internal procedures.
  */
 
 static void MD_Start     _ANSI_ARGS_ ((VOID* context));
-static void MD_Update    _ANSI_ARGS_ ((VOID* context, int character));
-static void MD_UpdateBuf _ANSI_ARGS_ ((VOID* context, char* buffer, int bufLen));
+static void MD_Update    _ANSI_ARGS_ ((VOID* context, unsigned int character));
+static void MD_UpdateBuf _ANSI_ARGS_ ((VOID* context, unsigned char* buffer, int bufLen));
 static void MD_Final     _ANSI_ARGS_ ((VOID* context, VOID* digest));
 static int  MD_Check     _ANSI_ARGS_ ((Tcl_Interp* interp));
 
 /*
  * Generator definition.
+ *
+ * Always provide the buffer procedure. The common code (digest.c) calls
+ * it once per buffer, with the loop over the bytes inside of it. Without
+ * it the common code has to fall back to calling the character
+ * procedure for each byte.
  */
 
-static Trf_MessageDigestDescription mdDescription = {
+static Trf_MessageDigestDescription mdDescription = { /* THREADING: constant, read-only => safe */
   "xxx",
   sizeof (CTX_TYPE),
   DIGEST_SIZE,
@@ -138,12 +156,12 @@ VOID* context;
 
 static void
 MD_Update (context, character)
-VOID* context;
-int   character;
+VOID*        context;
+unsigned int character;
 {
-  char buf = character;
+  unsigned char buf = character;
 
-  /* call md specific update here */
+  MD_UpdateBuf (context, &buf, 1);
 }
 
 /*
@@ -166,12 +184,12 @@ int   character;
  */
 
 static void
-MD_Updatebuf (context, buffer, bufLen)
-VOID* context;
-char* buffer;
-int   bufLen;
+MD_UpdateBuf (context, buffer, bufLen)
+VOID*          context;
+unsigned char* buffer;
+int            bufLen;
 {
-  sha_trf_info* s = context;
+  xxx_trf_info* s = (xxx_trf_info*) context;
 
   if ((s->count + bufLen) < CHUNK_SIZE) {
     /*
@@ -193,14 +211,19 @@ int   bufLen;
     if (k < CHUNK_SIZE) {
       memcpy ((VOID*) (s->buf + s->count), (VOID*) buffer, k);
 
-      sha_update (&s->s, s->buf, CHUNK_SIZE);
+      xxx_update (&s->s, s->buf, CHUNK_SIZE);
 
       buffer += k;
       bufLen -= k;
     } /* k == CHUNK_SIZE => internal buffer was empty, so skip it entirely */
 
-    while (bufLen > CHUNK_SIZE) {
-      sha_update (&s->s, buffer, CHUNK_SIZE);
+    /*
+     * Complete chunks are processed directly from the buffer of the
+     * caller, without copying them into the context.
+     */
+
+    while (bufLen >= CHUNK_SIZE) {
+      xxx_update (&s->s, buffer, CHUNK_SIZE);
 
       buffer += CHUNK_SIZE;
       bufLen -= CHUNK_SIZE;
@@ -154,6 +154,7 @@ TRF_EXPORT (int,Trf_IsInitialized) _ANSI_ARGS_ ((Tcl_Interp* interp));
  * * Handle of channel specified as argument to '-in'.
  * * Handle of channel specified as argument to '-out'.
  * * Name of the seek policy requested by the user.
+ * * Wether output is to be transformed asynchronously.
  */
 
 typedef struct _Trf_BaseOptions_ {
@@ -167,6 +168,9 @@ typedef struct _Trf_BaseOptions_ {
 
   Tcl_Obj* policy;    /* Refers to string object containing the seek policy
 		       * to use, if overiding the chosen one is allowed! */
+
+  int      async;     /* Boolean flag. Set if the output of the attached
+		       * transformation is to be run by a worker thread. */
 } Trf_BaseOptions;
 
 
@@ -732,7 +736,8 @@ typedef void Trf_MDUpdate _ANSI_ARGS_ ((VOID* context, unsigned int character));
  * Interface to procedures for update of a MD context.
  * A procedure of this type is called for character buffer to hash
  * into the final digest. This procedure is optional, its definition
- * has precedence over 'Trf_MDUpdate'.
+ * has precedence over 'Trf_MDUpdate'. Without it the common code has
+ * to call 'Trf_MDUpdate' for every single character of a buffer.
  */
 
 #ifdef __C2MAN__
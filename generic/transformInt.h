@@ -51,7 +51,7 @@ extern "C" {
 #else
 #   include "../compat/dlfcn.h"
 #endif
-#ifdef HAVE_zlibtcl_PACKAGE
+#if defined(HAVE_zlibtcl_PACKAGE) && !defined(ZLIB_STATIC_BUILD)
 #   include "zlibtcl.h"
 #else
 #   ifdef HAVE_ZLIB_H
@@ -176,6 +176,9 @@ extern void DumpString  _ANSI_ARGS_ ((int level, int len, char* bytes));
 #define LIST_ADDINT(el, list, i) \
     LIST_ADDOBJ (el, list, Tcl_NewIntObj (i))
 
+#define LIST_ADDWIDE(el, list, i) \
+    LIST_ADDOBJ (el, list, Tcl_NewWideIntObj (i))
+
 
 /* Define macro which is TRUE for tcl versions >= 8.1
  * Required as there are incompatibilities between 8.0 and 8.1
@@ -195,6 +198,25 @@ extern void DumpString  _ANSI_ARGS_ ((int level, int len, char* bytes));
 		 (TCL_RELEASE_LEVEL == TCL_FINAL_RELEASE) && \
 		 (TCL_RELEASE_SERIAL >= 2)))))
 
+/* Define macro which is TRUE for tcl versions >= 8.5, i.e. cores
+ * knowing channel types of version 5 (wide seeks, thread actions).
+ */
+
+#define GT85 ((TCL_MAJOR_VERSION > 8) || \
+	      ((TCL_MAJOR_VERSION == 8) && \
+	       (TCL_MINOR_VERSION >= 5)))
+
+#if !((TCL_MAJOR_VERSION > 8) || \
+      ((TCL_MAJOR_VERSION == 8) && (TCL_MINOR_VERSION >= 4)))
+/*
+ * Cores before 8.4 have no wide integers. Locations in the seek
+ * system are limited to the range of 'long' there.
+ */
+
+typedef long Tcl_WideInt;
+#define Tcl_NewWideIntObj(w) Tcl_NewLongObj ((long) (w))
+#endif
+
 #if ! (GT81)
 /*
  * Tcl version 8.0.x don't export their 'panic' procedure. Here we
@@ -219,6 +241,9 @@ panic _ANSI_ARGS_ (TCL_VARARGS(CONST char*, format));
 typedef struct _Trf_Registry_ {
   Tcl_HashTable* registry;        /* Table containing all registered
 				   * transformers. */
+  int            completing;      /* Number of lazy entries currently
+				   * completed by their initialization
+				   * procedure, see 'TrfCompleteEntry'. */
 #ifdef USE_TCL_STUBS
   int            patchVariant;   /* Defined only for versions of Tcl
 				  * supporting stubs, and thus enable
@@ -236,9 +261,19 @@ typedef struct _Trf_Registry_ {
 #define PATCH_ORIG (0) /* Patch as used in 8.0.x and 8.1.x */
 #define PATCH_82   (1) /* Patch as included into 8.2. Valid till 8.3.1 */
 #define PATCH_832  (2) /* Patch as rewritten for 8.3.2 and beyond */
+#define PATCH_85   (3) /* Same, in 8.5 and beyond. The core knows channel
+			* types of version 5. Tested for as
+			* '>= PATCH_832' where both are handled alike */
 #endif
 
 
+/*
+ * Signature of the procedures registering the builtin transformers
+ * (TrfInit_ZIP, ...).
+ */
+
+typedef int (TrfInitProc) _ANSI_ARGS_ ((Tcl_Interp* interp));
+
 /*
  * A structure of the type below is created and maintained
  * for every registered transformer (and every interpreter).
@@ -247,12 +282,19 @@ typedef struct _Trf_Registry_ {
 typedef struct _Trf_RegistryEntry_ {
   Trf_Registry*       registry;   /* Backpointer to the registry */
 
-  Trf_TypeDefinition* trfType;    /* reference to transformer specification */
+  Trf_TypeDefinition* trfType;    /* reference to transformer specification,
+				   * NULL until 'lazyInit' was run. */
   Tcl_ChannelType*    transType;  /* reference to derived channel type
-				   * specification */
+				   * specification, shared by all
+				   * interpreters. Looked up by the first
+				   * attachment. */
   Tcl_Command         trfCommand; /* command associated to the transformer */
   Tcl_Interp*         interp;     /* interpreter the command is registered
 				   * in. */
+  CONST char*         name;       /* name of the transformer */
+  TrfInitProc*        lazyInit;   /* procedure completing the registration,
+				   * see 'TrfRegisterLazy'. NULL for a
+				   * complete entry. */
 } Trf_RegistryEntry;
 
 
@@ -272,6 +314,132 @@ EXTERN int
 Trf_Unregister _ANSI_ARGS_ ((Tcl_Interp*        interp,
 			     Trf_RegistryEntry* entry));
 
+/*
+ * Deferred registration. Creates the command for transformer 'name',
+ * but nothing else. 'initProc' is run when the command is used for the
+ * first time. It has to 'Trf_Register' the transformer, which then
+ * completes the entry made here.
+ */
+
+EXTERN int
+TrfRegisterLazy _ANSI_ARGS_ ((Tcl_Interp*  interp,
+			      CONST char*  name,
+			      TrfInitProc* initProc));
+
+/*
+ * Lookup of a transformation by name, completing a deferred
+ * registration, and the command procedure shared by all
+ * transformations. Used by 'trf::pipeline' to run other
+ * transformations as its stages.
+ */
+
+EXTERN Trf_RegistryEntry*
+TrfLookupEntry _ANSI_ARGS_ ((Tcl_Interp* interp,
+			     CONST char* name));
+
+EXTERN int
+TrfExecuteObjCmd _ANSI_ARGS_ ((ClientData clientData, Tcl_Interp* interp,
+			       int objc, struct Tcl_Obj* CONST objv []));
+
+/*
+ * Seeking through a checkpoint index. A transformation unable to
+ * compute the location downstream for a location in its output, but
+ * able to restart its decoder at locations it remembered earlier
+ * (zip with -index), registers a procedure of the type below for its
+ * decoder vectors. It returns the checkpoint nearest to, but not
+ * behind 'location' in 'upLoc' and 'downLoc' (relative to the start
+ * of the stream), and resets the decoder to that checkpoint if
+ * 'restore' is set. A result of TCL_ERROR indicates that no index is
+ * available. This is internal to Trf and keeps the public vectors
+ * unchanged.
+ */
+
+typedef int TrfSeekCheckpoint _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+					    Tcl_WideInt      location,
+					    int              restore,
+					    Tcl_WideInt*     upLoc,
+					    Tcl_WideInt*     downLoc,
+					    ClientData       clientData));
+
+EXTERN void
+TrfRegisterCheckpointSeek _ANSI_ARGS_ ((Trf_Vectors*       vectors,
+					TrfSeekCheckpoint* proc));
+
+/*
+ * Decoding with an output budget. A decoder able to stop after
+ * writing 'budget' bytes registers a procedure of the type below for
+ * its vectors. It converts 'buffer' like a 'Trf_ConvertBuffer', but
+ * keeps the input it did not convert yet, and sets '*pending' if it
+ * has more to deliver. The next call then gets an empty buffer, until
+ * '*pending' is cleared. Reading from an attached channel uses this
+ * to bound the result buffer by the amount requested, instead of
+ * decompressing a whole chunk read from below at once.
+ */
+
+typedef int TrfConvertBudget _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+					   unsigned char*   buffer,
+					   int              bufLen,
+					   int              budget,
+					   int*             pending,
+					   Tcl_Interp*      interp,
+					   ClientData       clientData));
+
+EXTERN void
+TrfRegisterConvertBudget _ANSI_ARGS_ ((Trf_Vectors*      vectors,
+				       TrfConvertBudget* proc));
+
+/*
+ * Conversions evaluating Tcl scripts (transform) are bound to the
+ * thread of their interpreter. Their vectors are declared through
+ * 'TrfRegisterInterpBound' and are not run by the worker thread of
+ * attachments with -async.
+ */
+
+EXTERN void
+TrfRegisterInterpBound _ANSI_ARGS_ ((Trf_Vectors* vectors));
+
+EXTERN int
+TrfIsInterpBound _ANSI_ARGS_ ((Trf_Vectors* vectors));
+
+
+/*
+ * Per-thread scratch buffers for the output of conversions, instead
+ * of a buffer in every control block. A buffer returned by
+ * 'TrfScratchBuffer' is valid until the conversion returns, and has
+ * to be written through 'TrfScratchWrite', as the write may reenter
+ * another conversion in the same thread (stacked transformations).
+ */
+
+#define TRF_SCRATCH_SIZE (32 * 1024)
+
+EXTERN unsigned char*
+TrfScratchBuffer _ANSI_ARGS_ ((void));
+
+EXTERN int
+TrfScratchWrite  _ANSI_ARGS_ ((Trf_WriteProc* fun,
+			       ClientData     writeClientData,
+			       unsigned char* buffer,
+			       int            length,
+			       Tcl_Interp*    interp));
+
+/*
+ * Reserve/commit writing. 'TrfWriteReserve' returns space for the
+ * output of a conversion, in the buffer of the write procedure if
+ * that appends to one of the result buffers of the registry (no
+ * copy), else a scratch buffer. 'TrfWriteCommit' writes it.
+ */
+
+EXTERN unsigned char*
+TrfWriteReserve  _ANSI_ARGS_ ((Trf_WriteProc* fun,
+			       ClientData     writeClientData,
+			       int            size));
+
+EXTERN int
+TrfWriteCommit   _ANSI_ARGS_ ((Trf_WriteProc* fun,
+			       ClientData     writeClientData,
+			       unsigned char* buffer,
+			       int            length,
+			       Tcl_Interp*    interp));
 
 /*
  * Procedures used by 3->4 encoders (uu, base64).
@@ -317,6 +485,11 @@ typedef struct _TrfMDOptionBlock {
   Tcl_Interp* vInterp;	/* Interpreter containing the variable named in
 			 * 'matchFlag', or '*Destination'. */
 
+  int         iterations; /* Number of times the digest is applied to
+			   * its own result (IMMEDIATE only). 1 = once. */
+  int         every;	  /* If > 0, every k-th value of the chain is
+			   * returned instead of the last (IMMEDIATE). */
+
   /* derived information */
 
   Tcl_Channel rdChannel;  /* Channel associated to 'readDestination' */
@@ -371,8 +544,31 @@ typedef struct _TrfZipOptionBlock {
   int mode;   /* compressor mode: compress/decompress */
   int level;  /* compression level (1..9, -1 = default) */
   int nowrap; /* pkzip-compatibility (0..1, 0 = default) */
+  int flush;  /* zlib flush used for every write to an attached
+	       * channel: Z_NO_FLUSH (default, 'finish'),
+	       * Z_SYNC_FLUSH or Z_FULL_FLUSH */
+  Tcl_Obj* dictionary; /* Preset dictionary (byte array), or NULL */
+  int strategy; /* deflate strategy (Z_DEFAULT_STRATEGY = default) */
+  int memlevel; /* deflate memory level (1..9, MAX_MEM_LEVEL = default) */
+  int window;   /* base 2 log of window size (9..15, MAX_WBITS = default) */
+  int threads;  /* number of blocks compressed in parallel (1 = default,
+		 * no parallel compression) */
+  int blocksize; /* size of the blocks for parallel compression */
+  int index;     /* uncompressed bytes between the checkpoints of the
+		  * seek index built by the decompressor (0 = default,
+		  * no index) */
+  int hibernate; /* release the compressor state after every flush
+		  * (0..1, 0 = default) */
 } TrfZipOptionBlock;
 
+#define TRF_DEFAULT_BLOCKSIZE (128 * 1024)
+#define TRF_MIN_BLOCKSIZE     (1024)
+#define TRF_MAX_BLOCKSIZE     (64 * 1024 * 1024)
+#define TRF_MAX_THREADS       (64)
+#define TRF_MAX_BATCH         (256 * 1024 * 1024) /* threads * blocksize */
+#define TRF_MIN_INDEX         (1024)
+#define TRF_MAX_INDEX         (1024 * 1024 * 1024)
+
 EXTERN Trf_OptionVectors*
 TrfZIPOptions _ANSI_ARGS_ ((void));
 
@@ -384,11 +580,32 @@ TrfZIPOptions _ANSI_ARGS_ ((void));
 typedef struct _TrfBz2OptionBlock {
   int mode;   /* compressor mode: compress/decompress */
   int level;  /* compression level (1..9, 9 = default) */
+  int threads; /* number of blocks (de)compressed in parallel (1 = default,
+		* no parallel (de)compression) */
+  int immediate; /* boolean, set by CheckOptions. Parallel decompression
+		  * is done for immediate conversions only */
 } TrfBz2OptionBlock;
 
 EXTERN Trf_OptionVectors*
 TrfBZ2Options _ANSI_ARGS_ ((void));
 
+/*
+ * Definition of option information for the LZ4 compressor
+ * + accessor to set of vectors processing them
+ */
+
+typedef struct _TrfLz4OptionBlock {
+  int mode;         /* compressor mode: compress/decompress */
+  int acceleration; /* trades compression for speed (1 = default,
+		     * best compression) */
+} TrfLz4OptionBlock;
+
+#define TRF_MIN_ACCELERATION (1)
+#define TRF_MAX_ACCELERATION (65537)
+
+EXTERN Trf_OptionVectors*
+TrfLZ4Options _ANSI_ARGS_ ((void));
+
 #define TRF_COMPRESS   (1)
 #define TRF_DECOMPRESS (2)
 
@@ -410,7 +627,7 @@ TrfBZ2Options _ANSI_ARGS_ ((void));
 #undef  ZEXPORT
 #define ZEXPORT WINAPI
 #endif
-#ifdef HAVE_zlibtcl_PACKAGE
+#if defined(HAVE_zlibtcl_PACKAGE) && !defined(ZLIB_STATIC_BUILD)
 #undef  ZEXPORT
 #define ZEXPORT
 #endif
@@ -447,10 +664,44 @@ typedef struct ZFunctions {
   unsigned long (ZEXPORT * zcrc32)   _ANSI_ARGS_ ((unsigned long crc,
 						  CONST unsigned char *buf,
 						  unsigned int len));
+  int (ZEXPORT * zdeflateSetDictionary) _ANSI_ARGS_ ((z_streamp strm,
+						  CONST Bytef *dictionary,
+						  uInt dictLength));
+  int (ZEXPORT * zinflateSetDictionary) _ANSI_ARGS_ ((z_streamp strm,
+						  CONST Bytef *dictionary,
+						  uInt dictLength));
+  /* Optional, required only by the seek index (zip -index) */
+  int (ZEXPORT * zinflatePrime)      _ANSI_ARGS_ ((z_streamp strm,
+						  int bits, int value));
 } zFunctions;
 
 
+#ifdef ZLIB_STATIC_BUILD
+/*
+ * 'zlib' is linked into the package (--enable-static-zlib). The table
+ * is a constant known to every translation unit, which allows the
+ * compiler to turn each 'zf.zxxx (...)' into a direct call.
+ */
+
+static CONST zFunctions zf = { /* THREADING: constant, read-only => safe */
+  (VOID*) NULL,
+  deflate,
+  deflateEnd,
+  deflateInit2_,
+  deflateReset,
+  inflate,
+  inflateEnd,
+  inflateInit2_,
+  inflateReset,
+  adler32,
+  crc32,
+  deflateSetDictionary,
+  inflateSetDictionary,
+  inflatePrime
+};
+#else
 EXTERN zFunctions zf; /* THREADING: serialize initialization */
+#endif
 
 EXTERN int
 TrfLoadZlib _ANSI_ARGS_ ((Tcl_Interp *interp));
@@ -487,7 +738,24 @@ typedef struct BZFunctions {
 } bzFunctions;
 
 
+#ifdef BZLIB_STATIC_BUILD
+/*
+ * 'libbz2' is linked into the package (--enable-static-bzlib), see
+ * 'zf' above.
+ */
+
+static CONST bzFunctions bz = { /* THREADING: constant, read-only => safe */
+  (VOID*) NULL,
+  BZ2_bzCompress,
+  BZ2_bzCompressEnd,
+  BZ2_bzCompressInit,
+  BZ2_bzDecompress,
+  BZ2_bzDecompressEnd,
+  BZ2_bzDecompressInit
+};
+#else
 EXTERN bzFunctions bz; /* THREADING: serialize initialization */
+#endif
 
 EXTERN int
 TrfLoadBZ2lib _ANSI_ARGS_ ((Tcl_Interp *interp));
@@ -637,9 +905,11 @@ EXTERN int TrfInit_OTP_MD5   _ANSI_ARGS_ ((Tcl_Interp* interp));
 EXTERN int TrfInit_RS_ECC    _ANSI_ARGS_ ((Tcl_Interp* interp));
 EXTERN int TrfInit_ZIP       _ANSI_ARGS_ ((Tcl_Interp* interp));
 EXTERN int TrfInit_BZ2       _ANSI_ARGS_ ((Tcl_Interp* interp));
+EXTERN int TrfInit_LZ4       _ANSI_ARGS_ ((Tcl_Interp* interp));
 
 EXTERN int TrfInit_Info      _ANSI_ARGS_ ((Tcl_Interp* interp));
 EXTERN int TrfInit_Unstack   _ANSI_ARGS_ ((Tcl_Interp* interp));
+EXTERN int TrfInit_Pipeline  _ANSI_ARGS_ ((Tcl_Interp* interp));
 EXTERN int TrfInit_Binio     _ANSI_ARGS_ ((Tcl_Interp* interp));
 
 EXTERN int TrfInit_Transform _ANSI_ARGS_ ((Tcl_Interp* interp));
@@ -457,6 +457,158 @@ int   length;
   }
 }
 
+/*
+ * Scratch buffers for the output of the compressors, per thread. A
+ * conversion fills a buffer and hands it to its write procedure,
+ * which may run the conversion of another transformation stacked
+ * below, in the same thread. Each level of this nesting therefore
+ * gets its own buffer, selected by the depth of the writes in
+ * progress. The buffers are kept until the thread exits, instead of
+ * one buffer per control block for its whole lifetime.
+ */
+
+typedef struct _ScratchData_ {
+  char** buffers;	/* Buffers allocated so far, by depth */
+  int    numBuffers;
+  int    depth;		/* Number of 'TrfScratchWrite's in progress */
+} ScratchData;
+
+#if GT81
+static Tcl_ThreadDataKey scratchKey; /* THREADING: per-thread data, safe */
+
+static void
+ScratchRelease _ANSI_ARGS_ ((ClientData clientData));
+
+#define SCRATCH (ScratchData*) Tcl_GetThreadData (&scratchKey, sizeof (ScratchData))
+#else
+static ScratchData scratch;
+
+#define SCRATCH (&scratch)
+#endif
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfScratchBuffer --
+ *
+ *	------------------------------------------------*
+ *	Returns the scratch buffer of TRF_SCRATCH_SIZE
+ *	bytes for the current depth of writes in the
+ *	calling thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		May allocate memory.
+ *
+ *	Result:
+ *		See above.
+ *
+ *------------------------------------------------------*
+ */
+
+unsigned char*
+TrfScratchBuffer ()
+{
+  ScratchData* s = SCRATCH;
+
+  if (s->depth >= s->numBuffers) {
+#if GT81
+    if (s->numBuffers == 0) {
+      Tcl_CreateThreadExitHandler (ScratchRelease, (ClientData) NULL);
+    }
+#endif
+    if (s->buffers == (char**) NULL) {
+      s->buffers = (char**) ckalloc ((s->depth + 1) * sizeof (char*));
+    } else {
+      s->buffers = (char**) ckrealloc ((char*) s->buffers,
+				       (s->depth + 1) * sizeof (char*));
+    }
+
+    while (s->numBuffers <= s->depth) {
+      s->buffers [s->numBuffers ++] = ckalloc (TRF_SCRATCH_SIZE);
+    }
+  }
+
+  return (unsigned char*) s->buffers [s->depth];
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	TrfScratchWrite --
+ *
+ *	------------------------------------------------*
+ *	Hands a scratch buffer to a write procedure.
+ *	Scratch buffers requested during the write are
+ *	distinct from the one written.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+int
+TrfScratchWrite (fun, writeClientData, buffer, length, interp)
+Trf_WriteProc* fun;
+ClientData     writeClientData;
+unsigned char* buffer;
+int            length;
+Tcl_Interp*    interp;
+{
+  ScratchData* s = SCRATCH;
+  int res;
+
+  s->depth ++;
+  res = fun (writeClientData, buffer, length, interp);
+  s->depth --;
+
+  return res;
+}
+
+#if GT81
+/*
+ *------------------------------------------------------*
+ *
+ *	ScratchRelease --
+ *
+ *	------------------------------------------------*
+ *	Releases the scratch buffers of the exiting
+ *	thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases memory.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ScratchRelease (clientData)
+ClientData clientData;
+{
+  ScratchData* s = SCRATCH;
+  int i;
+
+  for (i = 0; i < s->numBuffers; i++) {
+    ckfree (s->buffers [i]);
+  }
+  if (s->buffers != (char**) NULL) {
+    ckfree ((char*) s->buffers);
+  }
+
+  s->buffers    = (char**) NULL;
+  s->numBuffers = 0;
+}
+#endif
+
 /*
  *------------------------------------------------------*
  */
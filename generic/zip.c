@@ -82,6 +82,14 @@ DecodeBuffer   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
 			     Tcl_Interp*      interp,
 			     ClientData       clientData));
 static int
+DecodeBudget   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     unsigned char*   buffer,
+			     int              bufLen,
+			     int              budget,
+			     int*             pending,
+			     Tcl_Interp*      interp,
+			     ClientData       clientData));
+static int
 FlushDecoder   _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
 			     Tcl_Interp*      interp,
 			     ClientData       clientData));
@@ -103,6 +111,93 @@ static int
 MaxReadDecoder _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
 			     ClientData       clientData));
 
+static int
+SetDictionary  _ANSI_ARGS_ ((z_streamp   state,
+			     Tcl_Obj*    dictionary,
+			     int         compress));
+
+struct _EncoderControl_;
+struct _ParallelDeflate_;
+
+static struct _ParallelDeflate_*
+ParallelCreate _ANSI_ARGS_ ((TrfZipOptionBlock* o));
+static void
+ParallelDelete _ANSI_ARGS_ ((struct _ParallelDeflate_* p));
+static void
+ParallelClear  _ANSI_ARGS_ ((struct _ParallelDeflate_* p));
+#ifdef TCL_THREADS
+static void
+ParallelStart  _ANSI_ARGS_ ((struct _ParallelDeflate_* p));
+static Tcl_ThreadCreateType
+DeflateWorker  _ANSI_ARGS_ ((ClientData clientData));
+#endif
+static int
+ParallelWrite  _ANSI_ARGS_ ((struct _EncoderControl_* c,
+			     unsigned char*  buffer,
+			     int             bufLen,
+			     Tcl_Interp*     interp));
+static int
+ParallelFlush  _ANSI_ARGS_ ((struct _EncoderControl_* c,
+			     Tcl_Interp*     interp));
+
+struct _Hibernation_;
+
+static struct _Hibernation_*
+HibernateCreate _ANSI_ARGS_ ((void));
+static int
+HibernateWake   _ANSI_ARGS_ ((struct _EncoderControl_* c,
+			      Tcl_Interp*     interp));
+static void
+HibernateSleep  _ANSI_ARGS_ ((struct _EncoderControl_* c));
+static void
+HibernateTrack  _ANSI_ARGS_ ((struct _EncoderControl_* c,
+			      unsigned char*  buffer,
+			      int             bufLen));
+static void
+HibernateClear  _ANSI_ARGS_ ((struct _EncoderControl_* c));
+
+struct _DecoderControl_;
+struct _SeekIndex_;
+
+static int
+Inflate        _ANSI_ARGS_ ((struct _DecoderControl_* c,
+			     int         budget,
+			     Tcl_Interp* interp));
+
+static struct _SeekIndex_*
+IndexCreate    _ANSI_ARGS_ ((int span));
+static void
+IndexDelete    _ANSI_ARGS_ ((struct _SeekIndex_* x));
+static void
+IndexUpdate    _ANSI_ARGS_ ((struct _DecoderControl_* c,
+			     unsigned char* out,
+			     int written,
+			     int consumed));
+static int
+IndexRestart   _ANSI_ARGS_ ((struct _DecoderControl_* c,
+			     int point));
+static int
+SeekCheckpoint _ANSI_ARGS_ ((Trf_ControlBlock ctrlBlock,
+			     Tcl_WideInt      location,
+			     int              restore,
+			     Tcl_WideInt*     upLoc,
+			     Tcl_WideInt*     downLoc,
+			     ClientData       clientData));
+
+#if GT81
+
+static struct _EncoderControl_*
+PoolGetEncoder _ANSI_ARGS_ ((TrfZipOptionBlock* o));
+static int
+PoolPutEncoder _ANSI_ARGS_ ((struct _EncoderControl_* c));
+static struct _DecoderControl_*
+PoolGetDecoder _ANSI_ARGS_ ((TrfZipOptionBlock* o));
+static int
+PoolPutDecoder _ANSI_ARGS_ ((struct _DecoderControl_* c));
+static void
+PoolRelease    _ANSI_ARGS_ ((ClientData clientData));
+#endif
+
 /*
  * Converter definition.
  */
@@ -144,7 +239,25 @@ typedef struct _EncoderControl_ {
 
   z_stream state;	/* compressor state */
 
-  char* output_buffer;
+  int   flush;		/* zlib flush mode applied to each buffer, see
+			 * option '-flush' */
+
+  int   level;		/* Parameters the state was initialized with. */
+  int   nowrap;		/* Key for reuse through the pool, see below. */
+  int   strategy;
+  int   memlevel;
+  int   window;
+
+  Tcl_Obj* dictionary;	/* Preset dictionary, or NULL. Re-applied
+			 * after every reset of the state. */
+
+  struct _ParallelDeflate_* par; /* State of a parallel compression
+				  * (-threads), or NULL */
+
+  struct _Hibernation_* hib;	/* Saved form of the state between
+				 * flushes (-hibernate), or NULL */
+
+  struct _EncoderControl_* nextFree; /* Link in the pool */
 
 } EncoderControl;
 
@@ -153,17 +266,171 @@ typedef struct _DecoderControl_ {
   Trf_WriteProc* write;
   ClientData     writeClientData;
   int            nowrap;
+  int            window;	/* Parameter the state was initialized with */
 
   /* add conversion specific items here (ZIP) */
 
   z_stream state;	/* decompressor state */
-  char*    output_buffer;
   int      stop;        /* Boolean flag. Set after
 			 * reaching Z_STREAM_END */
+  Tcl_Obj* dictionary;	/* Preset dictionary, or NULL. Supplied on
+			 * Z_NEED_DICT, or immediately for raw streams */
+
+  struct _SeekIndex_* index; /* Checkpoints for seeking (-index), or NULL */
+
+  unsigned char* keep;	/* Input not decoded yet by 'DecodeBudget' */
+  int      keepLen;
+  int      keepSize;	/* Allocated size of 'keep' */
+
+  struct _DecoderControl_* nextFree; /* Link in the pool */
 } DecoderControl;
 
 #define KILO     (1024)
-#define OUT_SIZE (32 * KILO)
+#define OUT_SIZE TRF_SCRATCH_SIZE /* Output is collected in the scratch
+				   * buffers of the thread */
+
+/*
+ * Parallel compression (-threads N, -blocksize B). The input is cut
+ * into blocks of B bytes. Up to N blocks are compressed at the same
+ * time, each as an independent raw deflate stream primed with the
+ * 32K of input preceding the block as its dictionary, and ended with
+ * a sync flush (the last block of all with Z_FINISH). The results are
+ * concatenated in order, which yields a single valid deflate stream,
+ * wrapped into the zlib header and trailer unless -nowrap is set.
+ * The worker threads are started with the first batch and live as
+ * long as the compressor. They wait for their job to become ready.
+ */
+
+#define DICT_SIZE (32 * KILO)
+
+typedef struct _DeflateJob_ {
+  unsigned char* in;		/* Block to compress (not owned) */
+  int            inLen;
+  unsigned char* dict;		/* Input preceding the block (not owned) */
+  int            dictLen;
+  int            last;		/* Boolean. Finish the stream with this block */
+  int            level;
+  int            memlevel;
+  int            strategy;
+  int            window;
+
+  z_stream       state;		/* Kept for the error message */
+  unsigned char* out;		/* Compressed block, owned by the job */
+  int            outSize;	/* Allocated size of 'out' */
+  int            outLen;	/* Used size of 'out' */
+  int            res;		/* Z_OK, or zlib error code */
+
+  struct _ParallelDeflate_* par; /* Compression the job belongs to */
+  int            worker;	/* Boolean. Set if a thread runs the job */
+  int            ready;		/* Boolean. Set while the job waits for its
+				 * thread, or runs in it */
+} DeflateJob;
+
+typedef struct _ParallelDeflate_ {
+  int            threads;
+  int            blocksize;
+  int            level;
+  int            memlevel;
+  int            strategy;
+  int            window;
+  int            nowrap;
+
+  unsigned char* buffer;	/* DICT_SIZE bytes of history, followed by
+				 * space for 'threads' blocks of input */
+  int            histLen;	/* Bytes of history in front of the input */
+  int            inLen;		/* Bytes of input waiting for compression */
+  int            headerDone;	/* Boolean. Set after the zlib header is written */
+  unsigned long  adler;		/* Checksum of the input, for the trailer */
+  DeflateJob*    jobs;		/* 'threads' job descriptions */
+
+#ifdef TCL_THREADS
+  int            started;	/* Boolean. Set after the workers started */
+  int            shutdown;	/* Boolean. Set to stop the workers */
+  Tcl_ThreadId   tid [TRF_MAX_THREADS]; /* Workers, for jobs 1..threads-1 */
+  Tcl_Mutex      lock;		/* Protects 'ready' and 'shutdown' */
+  Tcl_Condition  cond;		/* Signaled for ready and finished jobs */
+#endif
+} ParallelDeflate;
+
+/*
+ * Hibernation (-hibernate). The state of an idle compressor (~256K)
+ * is released after every buffer completed by a sync or full flush.
+ * Saved are the checksum of the input so far, and for sync flushes
+ * the last HIB_HISTORY bytes of input. The next write starts a raw
+ * deflate stream primed with that history as dictionary, which
+ * continues the stream. Its zlib trailer is then written here, as
+ * zlib does not know the whole input. A full flush already removed
+ * all references to earlier input, no history is needed.
+ */
+
+#define HIB_HISTORY (4 * KILO)
+
+typedef struct _Hibernation_ {
+  int            asleep;	/* Boolean. Set while the state is released */
+  int            started;	/* Boolean. Set after output was written,
+				 * i.e. the next state is a continuation */
+  int            raw;		/* Boolean. Set if the current state is a
+				 * continuation, without header and trailer */
+  unsigned long  adler;		/* Checksum of the input, for the trailer */
+  int            historyLen;
+  unsigned char  history [HIB_HISTORY]; /* Input preceding the next write */
+} Hibernation;
+
+/*
+ * Seek index (-index SPAN). While decompressing, a checkpoint is
+ * recorded at the first deflate block boundary after every SPAN bytes
+ * of output. It remembers the locations in the compressed and the
+ * uncompressed stream, the bits of the last compressed byte not
+ * consumed yet, and the 32K of output preceding it. That is all raw
+ * inflate needs to restart at the boundary. The generic layer uses
+ * this to seek, see 'SeekCheckpoint' and 'TrfRegisterCheckpointSeek'.
+ */
+
+typedef struct _Checkpoint_ {
+  Tcl_WideInt    upLoc;		/* Location in the uncompressed stream */
+  Tcl_WideInt    downLoc;	/* Location in the compressed stream */
+  int            bits;		/* Number of bits left in the byte before
+				 * 'downLoc', and their value */
+  int            value;
+  unsigned char* window;	/* Output preceding 'upLoc' */
+  int            windowLen;
+} Checkpoint;
+
+typedef struct _SeekIndex_ {
+  int            span;		/* Output between checkpoints */
+  Checkpoint*    points;	/* Ordered by location. points [0] is the
+				 * start of the stream, without window */
+  int            numPoints;
+  int            allocPoints;
+  Tcl_WideInt    upLoc;		/* Current locations in the uncompressed */
+  Tcl_WideInt    downLoc;	/* and compressed stream. Counted here,
+				 * total_in is not reliable after Z_NEED_DICT */
+  unsigned char  ring [DICT_SIZE]; /* The last output, a ring buffer */
+  int            ringPos;	/* Next location to write in 'ring' */
+  int            ringLen;	/* Bytes used in 'ring' */
+} SeekIndex;
+
+#if GT81
+/*
+ * Pool of initialized control blocks, per thread. Setting up and
+ * tearing down a zlib stream (~256K of state, plus our output buffer)
+ * dominates the cost of compressing small messages. Deleted control
+ * blocks are therefore reset and kept for reuse by the next creation
+ * with the same parameters, up to POOL_SIZE of each kind.
+ */
+
+#define POOL_SIZE (4)
+
+typedef struct _ThreadSpecificData_ {
+  int             initialized;
+  EncoderControl* encoders;	/* Free compressors, linked via 'nextFree' */
+  int             numEncoders;
+  DecoderControl* decoders;	/* Free decompressors, linked via 'nextFree' */
+  int             numDecoders;
+} ThreadSpecificData;
+
+static Tcl_ThreadDataKey dataKey; /* THREADING: per-thread data, safe */
+#endif
 
 
 /*
@@ -189,7 +456,11 @@ TrfInit_ZIP (interp)
 Tcl_Interp* interp;
 {
   TrfLock; /* THREADING: serialize initialization */
-  convDefinition.options = TrfZIPOptions ();
+  if (convDefinition.options == (Trf_OptionVectors*) NULL) {
+    TrfRegisterCheckpointSeek (&convDefinition.decoder, SeekCheckpoint);
+    TrfRegisterConvertBudget  (&convDefinition.decoder, DecodeBudget);
+    convDefinition.options = TrfZIPOptions ();
+  }
   TrfUnlock;
 
   return Trf_Register (interp, &convDefinition);
@@ -228,6 +499,37 @@ ClientData     clientData;
 
   START (ZipCreateEncoder); 
 
+#if GT81
+  c = (o->hibernate || (o->threads > 1)) ?
+    (EncoderControl*) NULL :
+    PoolGetEncoder (o);
+
+  if (c != (EncoderControl*) NULL) {
+    c->write           = fun;
+    c->writeClientData = writeClientData;
+    c->flush           = o->flush;
+    c->dictionary      = o->dictionary;
+
+    if (c->dictionary != (Tcl_Obj*) NULL) {
+      Tcl_IncrRefCount (c->dictionary);
+
+      res = SetDictionary (&c->state, c->dictionary, 1);
+
+      if (res != Z_OK) {
+	if (interp) {
+	  ZlibError (interp, &c->state, res, "compressor/dictionary");
+	}
+	DeleteEncoder ((Trf_ControlBlock) c, clientData);
+	DONE (ZipCreateEncoder); 
+	return (ClientData) NULL;
+      }
+    }
+
+    DONE (ZipCreateEncoder); 
+    return (ClientData) c;
+  }
+#endif
+
   c = (EncoderControl*) ckalloc (sizeof (EncoderControl));
   c->write           = fun;
   c->writeClientData = writeClientData;
@@ -237,16 +539,47 @@ ClientData     clientData;
   c->state.zalloc = Z_NULL;
   c->state.zfree  = Z_NULL;
   c->state.opaque = Z_NULL;
+  c->flush        = o->flush;
+  c->level        = o->level;
+  c->nowrap       = o->nowrap;
+  c->strategy     = o->strategy;
+  c->memlevel     = o->memlevel;
+  c->window       = o->window;
+  c->dictionary   = (Tcl_Obj*) NULL;
+  c->par          = (ParallelDeflate*) NULL;
+  c->hib          = (Hibernation*) NULL;
+  c->nextFree     = (EncoderControl*) NULL;
+
+  if (o->hibernate) {
+    /*
+     * Start asleep, the state is built by the first write.
+     */
 
-  c->output_buffer = (char*) ckalloc (OUT_SIZE);
+    c->hib = HibernateCreate ();
+
+    if (o->dictionary != (Tcl_Obj*) NULL) {
+      c->dictionary = o->dictionary;
+      Tcl_IncrRefCount (c->dictionary);
+    }
 
-  if (c->output_buffer == (char*) NULL) {
-    ckfree ((VOID*) c);
     DONE (ZipCreateEncoder); 
-    return (ClientData) NULL;
+    return (ClientData) c;
   }
 
-  PRINT ("deflateInit (%d, %s)\n", o->level, ZLIB_VERSION); FL;
+  c->par = ParallelCreate (o);
+
+  if (c->par != (ParallelDeflate*) NULL) {
+    /*
+     * All data goes through 'ParallelCompress', whose jobs have
+     * their own states. This one would never be used.
+     */
+
+    DONE (ZipCreateEncoder); 
+    return (ClientData) c;
+  }
+
+  PRINT ("deflateInit (%d, %d, %d, %d, %s)\n", o->level, o->window,
+	 o->memlevel, o->strategy, ZLIB_VERSION); FL;
 
 #if 0
   res = zf.zdeflateInit_ (&c->state, o->level,
@@ -255,9 +588,9 @@ ClientData     clientData;
 
   res = zf.zdeflateInit2_ (&c->state, o->level, Z_DEFLATED,
 			 o->nowrap  ?
-			 -MAX_WBITS :
-			 MAX_WBITS,
-			 MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+			 -o->window :
+			 o->window,
+			 o->memlevel, o->strategy,
 			 ZLIB_VERSION, sizeof(z_stream));
 
   IN; PRINTLN (ZlibErrorMsg (&c->state, res)); FL; OT;
@@ -267,12 +600,28 @@ ClientData     clientData;
       ZlibError (interp, &c->state, res, "compressor/init");
     }
 
-    ckfree ((VOID*) c->output_buffer);
     ckfree ((VOID*) c);
     DONE (ZipCreateEncoder); 
     return (ClientData) NULL;
   }
 
+  if (o->dictionary != (Tcl_Obj*) NULL) {
+    c->dictionary = o->dictionary;
+    Tcl_IncrRefCount (c->dictionary);
+
+    res = SetDictionary (&c->state, c->dictionary, 1);
+
+    if (res != Z_OK) {
+      if (interp) {
+	ZlibError (interp, &c->state, res, "compressor/dictionary");
+      }
+
+      DeleteEncoder ((Trf_ControlBlock) c, clientData);
+      DONE (ZipCreateEncoder); 
+      return (ClientData) NULL;
+    }
+  }
+
   DONE (ZipCreateEncoder); 
   return (ClientData) c;
 }
@@ -305,11 +654,45 @@ ClientData clientData;
   /* release conversion specific items here (ZIP) */
 
   START (ZipDeleteEncoder); 
+
+  if (c->dictionary != (Tcl_Obj*) NULL) {
+    Tcl_DecrRefCount (c->dictionary);
+    c->dictionary = (Tcl_Obj*) NULL;
+  }
+
+  if (c->par != (ParallelDeflate*) NULL) {
+    /* No state of its own, see 'CreateEncoder' */
+
+    ParallelDelete (c->par);
+    ckfree ((char*) c);
+    DONE (ZipDeleteEncoder); 
+    return;
+  }
+
+  if (c->hib != (Hibernation*) NULL) {
+    /* A continued state does not fit the pool */
+
+    if (!c->hib->asleep) {
+      zf.zdeflateEnd (&c->state);
+    }
+
+    ckfree ((char*) c->hib);
+    ckfree ((char*) c);
+    DONE (ZipDeleteEncoder); 
+    return;
+  }
+
+#if GT81
+  if (PoolPutEncoder (c)) {
+    DONE (ZipDeleteEncoder); 
+    return;
+  }
+#endif
+
   PRINT ("deflateEnd ()\n"); FL;
 
   zf.zdeflateEnd (&c->state);
 
-  ckfree ((char*) c->output_buffer);
   ckfree ((char*) c);
 
   DONE (ZipDeleteEncoder); 
@@ -346,12 +729,27 @@ ClientData clientData;
   /* execute conversion specific code here (ZIP) */
 
   char in;
+  unsigned char* out;
   int res;
 
   START (ZipEncode); 
 
   in = character;
 
+  if (c->par != (ParallelDeflate*) NULL) {
+    res = ParallelWrite (c, (unsigned char*) &in, 1, interp);
+    DONE (ZipEncode); 
+    return res;
+  }
+
+  if (c->hib != (Hibernation*) NULL) {
+    if (HibernateWake (c, interp) != TCL_OK) {
+      DONE (ZipEncode); 
+      return TCL_ERROR;
+    }
+    HibernateTrack (c, (unsigned char*) &in, 1);
+  }
+
   c->state.next_in   = (Bytef*) &in;
   c->state.avail_in  = 1;
 
@@ -361,7 +759,8 @@ ClientData clientData;
       break;
     }
 
-    c->state.next_out  = (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (Bytef*) out;
     c->state.avail_out = OUT_SIZE;
 
     PRINT ("deflate (Z_NO_FLUSH)\n"); FL;
@@ -378,8 +777,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	DONE (ZipEncode); 
 	return res;
@@ -430,6 +829,7 @@ ClientData clientData;
 
   /* execute conversion specific code here (ZIP) */
 
+  unsigned char* out;
   int res;
 
   START (ZipEncodeBuffer); 
@@ -437,20 +837,42 @@ ClientData clientData;
   DUMP  (bufLen, buffer);
   PRINT ("}\n");
 
+  if (c->par != (ParallelDeflate*) NULL) {
+    res = ParallelWrite (c, buffer, bufLen, interp);
+    DONE (ZipEncodeBuffer); 
+    return res;
+  }
+
+  if (c->hib != (Hibernation*) NULL) {
+    if (HibernateWake (c, interp) != TCL_OK) {
+      DONE (ZipEncodeBuffer); 
+      return TCL_ERROR;
+    }
+    HibernateTrack (c, buffer, bufLen);
+  }
+
   c->state.next_in   = (Bytef*) buffer;
   c->state.avail_in  = bufLen;
 
+  /*
+   * For '-flush sync|full' every buffer handed to us is completed
+   * with a flush point, i.e. all of it leaves immediately, without
+   * ending the stream. The loop has to run until the flush is
+   * complete, even after all input is consumed.
+   */
+
   for (;;) {
-    if (c->state.avail_in <= 0) {
+    if ((c->state.avail_in <= 0) && (c->flush == Z_NO_FLUSH)) {
       PRINTLN ("Nothing to process");
       break;
     }
 
-    c->state.next_out  = (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (Bytef*) out;
     c->state.avail_out = OUT_SIZE;
 
-    PRINT ("deflate (Z_NO_FLUSH)\n"); FL;
-    res = zf.zdeflate (&c->state, Z_NO_FLUSH);
+    PRINT ("deflate (%d)\n", c->flush); FL;
+    res = zf.zdeflate (&c->state, c->flush);
 
     IN; PRINTLN (ZlibErrorMsg (&c->state, res)); FL; OT;
 
@@ -463,8 +885,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	DONE (ZipEncodeBuffer); 
 	return res;
@@ -480,6 +902,11 @@ ClientData clientData;
     break;
   }
 
+  if ((c->hib != (Hibernation*) NULL) && (c->flush != Z_NO_FLUSH)) {
+    /* Everything is written, the state is not needed until the next write */
+    HibernateSleep (c);
+  }
+
   DONE (ZipEncodeBuffer); 
   return TCL_OK;
 }
@@ -513,15 +940,29 @@ ClientData clientData;
 
   /* execute conversion specific code here (ZIP) */
 
+  unsigned char* out;
   int res;
 
   START (ZipFlushEncoder); 
 
+  if (c->par != (ParallelDeflate*) NULL) {
+    res = ParallelFlush (c, interp);
+    DONE (ZipFlushEncoder); 
+    return res;
+  }
+
+  if ((c->hib != (Hibernation*) NULL) &&
+      (HibernateWake (c, interp) != TCL_OK)) {
+    DONE (ZipFlushEncoder); 
+    return TCL_ERROR;
+  }
+
   c->state.next_in   = (Bytef*) NULL;
   c->state.avail_in  = 0;
 
   for (;;) {
-    c->state.next_out  = (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (Bytef*) out;
     c->state.avail_out = OUT_SIZE;
 
     PRINT ("deflate (Z_FINISH)\n"); FL;
@@ -538,8 +979,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	DONE (ZipFlushEncoder); 
 	return res;
@@ -552,6 +993,22 @@ ClientData clientData;
     break;
   }
 
+  if ((c->hib != (Hibernation*) NULL) && c->hib->raw && !c->nowrap) {
+    unsigned char trailer [4];
+    unsigned long adler = c->hib->adler;
+
+    trailer [0] = (unsigned char) ((adler >> 24) & 0xff);
+    trailer [1] = (unsigned char) ((adler >> 16) & 0xff);
+    trailer [2] = (unsigned char) ((adler >>  8) & 0xff);
+    trailer [3] = (unsigned char) ( adler        & 0xff);
+
+    res = c->write (c->writeClientData, trailer, 4, interp);
+    if (res != TCL_OK) {
+      DONE (ZipFlushEncoder); 
+      return res;
+    }
+  }
+
   DONE (ZipFlushEncoder); 
   return TCL_OK;
 }
@@ -586,8 +1043,24 @@ ClientData clientData;
 
   /* execute conversion specific code here (ZIP) */
 
+  if (c->hib != (Hibernation*) NULL) {
+    HibernateClear (c);
+    DONE (ZipClearEncoder); 
+    return;
+  }
+
+  if (c->par != (ParallelDeflate*) NULL) {
+    ParallelClear (c->par);
+    DONE (ZipClearEncoder); 
+    return;
+  }
+
   zf.zdeflateReset (&c->state);
 
+  if (c->dictionary != (Tcl_Obj*) NULL) {
+    SetDictionary (&c->state, c->dictionary, 1);
+  }
+
   DONE (ZipClearEncoder); 
 }
 
@@ -624,11 +1097,39 @@ ClientData     clientData;
 
   START (ZipCreateDecoder); 
 
+#if GT81
+  c = (o->index > 0) ? (DecoderControl*) NULL : PoolGetDecoder (o);
+
+  if (c != (DecoderControl*) NULL) {
+    c->write           = fun;
+    c->writeClientData = writeClientData;
+    c->dictionary      = o->dictionary;
+
+    if (c->dictionary != (Tcl_Obj*) NULL) {
+      Tcl_IncrRefCount (c->dictionary);
+
+      if (c->nowrap) {
+	SetDictionary (&c->state, c->dictionary, 0);
+      }
+    }
+
+    DONE (ZipCreateDecoder); 
+    return (ClientData) c;
+  }
+#endif
+
   c = (DecoderControl*) ckalloc (sizeof (DecoderControl));
   c->write           = fun;
   c->writeClientData = writeClientData;
   c->nowrap          = o->nowrap;
+  c->window          = o->window;
   c->stop            = 0;
+  c->dictionary      = (Tcl_Obj*) NULL;
+  c->index           = (SeekIndex*) NULL;
+  c->keep            = (unsigned char*) NULL;
+  c->keepLen         = 0;
+  c->keepSize        = 0;
+  c->nextFree        = (DecoderControl*) NULL;
 
   /* initialize conversion specific items here (ZIP) */
 
@@ -636,14 +1137,6 @@ ClientData     clientData;
   c->state.zfree  = Z_NULL;
   c->state.opaque = Z_NULL;
 
-  c->output_buffer = (char*) ckalloc (OUT_SIZE);
-
-  if (c->output_buffer == (char*) NULL) {
-    ckfree ((VOID*) c);
-    DONE (ZipCreateDecoder); 
-    return (ClientData) NULL;
-  }
-
   PRINT ("inflateInit (%s, nowrap=%d)\n", ZLIB_VERSION, o->nowrap); FL;
 
 #if 0
@@ -653,8 +1146,8 @@ ClientData     clientData;
 
   res = zf.zinflateInit2_ (&c->state,
 			 o->nowrap  ?
-			 -MAX_WBITS :
-			 MAX_WBITS,
+			 -o->window :
+			 o->window,
 			 ZLIB_VERSION, sizeof (z_stream));
 
   IN; PRINTLN (ZlibErrorMsg (&c->state, res)); FL; OT;
@@ -664,12 +1157,31 @@ ClientData     clientData;
       ZlibError (interp, &c->state, res, "decompressor/init");
     }
 
-    ckfree ((VOID*) c->output_buffer);
     ckfree ((VOID*) c);
     DONE (ZipCreateDecoder); 
     return (ClientData) NULL;
   }
 
+  if (o->dictionary != (Tcl_Obj*) NULL) {
+    /*
+     * A zlib stream announces its need for the dictionary by way of
+     * Z_NEED_DICT (see 'Decode', 'DecodeBuffer'). A raw stream
+     * cannot, its dictionary has to be set immediately.
+     */
+
+    c->dictionary = o->dictionary;
+    Tcl_IncrRefCount (c->dictionary);
+
+    if (c->nowrap) {
+      SetDictionary (&c->state, c->dictionary, 0);
+    }
+  }
+
+  if (o->index > 0) {
+    c->index = IndexCreate (o->index);
+    IndexRestart (c, 0);
+  }
+
   DONE (ZipCreateDecoder); 
   return (ClientData) c;
 }
@@ -702,11 +1214,36 @@ ClientData clientData;
   /* release conversion specific items here (ZIP) */
 
   START (ZipDeleteDecoder); 
+
+  if (c->dictionary != (Tcl_Obj*) NULL) {
+    Tcl_DecrRefCount (c->dictionary);
+    c->dictionary = (Tcl_Obj*) NULL;
+  }
+
+  if (c->keep != (unsigned char*) NULL) {
+    ckfree ((char*) c->keep);
+    c->keep     = (unsigned char*) NULL;
+    c->keepLen  = 0;
+    c->keepSize = 0;
+  }
+
+  if (c->index != (SeekIndex*) NULL) {
+    /* The state may have been restarted as raw stream, don't pool it */
+
+    IndexDelete (c->index);
+    c->index = (SeekIndex*) NULL;
+  } else
+#if GT81
+  if (PoolPutDecoder (c)) {
+    DONE (ZipDeleteDecoder); 
+    return;
+  }
+#endif
+
   PRINT ("inflateEnd ()\n"); FL;
 
   zf.zinflateEnd (&c->state);
 
-  ckfree ((char*) c->output_buffer);
   ckfree ((char*) c);
 
   DONE (ZipDeleteDecoder); 
@@ -743,6 +1280,7 @@ ClientData clientData;
 
   /* execute conversion specific code here (ZIP) */
   char in;
+  unsigned char* out;
   int res;
 
   START (ZipDecode); 
@@ -764,7 +1302,8 @@ ClientData clientData;
       break;
     }
 
-    c->state.next_out  = (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (Bytef*) out;
     c->state.avail_out = OUT_SIZE;
 
     PRINT ("inflate (Z_NO_FLUSH)\n"); FL;
@@ -772,7 +1311,11 @@ ClientData clientData;
 
     IN; PRINTLN (ZlibErrorMsg (&c->state, res)); FL; OT;
 
-    if (res < Z_OK) {
+    if ((res == Z_NEED_DICT) && (c->dictionary != (Tcl_Obj*) NULL)) {
+      res = SetDictionary (&c->state, c->dictionary, 0);
+    }
+
+    if ((res < Z_OK) || (res == Z_NEED_DICT)) {
       if (interp) {
 	ZlibError (interp, &c->state, res, "decompressor");
       }
@@ -781,8 +1324,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	DONE (ZipDecode);
 	return res;
@@ -854,88 +1397,30 @@ ClientData clientData;
   PRINT ("Data = %d {\n", bufLen);
   DUMP  (bufLen, buffer);
   PRINT ("}\n");
-  /*
-  if (c->stop) {
-    PRINTLN ("stopped");
-    DONE (ZipDecodeBuffer);
-    return TCL_OK;
-  }
-  */
+
   c->state.next_in   = (Bytef*) buffer;
   c->state.avail_in  = bufLen;
 
-  for (;;) {
-    if (c->state.avail_in <= 0) {
-      PRINTLN ("Nothing to process");
-      break;
-    }
-
-    c->state.next_out  = (Bytef*) c->output_buffer;
-    c->state.avail_out = OUT_SIZE;
-
-    PRINT ("inflate (Z_NO_FLUSH)\n"); FL;
-    res = zf.zinflate (&c->state, Z_NO_FLUSH);
-
-    IN; PRINTLN (ZlibErrorMsg (&c->state, res)); FL; OT;
-
-    if (res < Z_OK) {
-      if (interp) {
-	ZlibError (interp, &c->state, res, "decompressor");
-      }
-      DONE (ZipDecodeBuffer); 
-      return TCL_ERROR;
-    }
-
-    if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
-      if (res != TCL_OK) {
-	DONE (ZipDecodeBuffer); 
-	return res;
-      }
-    }
-
-    /* 29.11.1999, AK */
-    if (res == Z_STREAM_END) {
-      /* Don't process the remainining characters, they are not part of the
-       * compressed stream. Push them back into the channel downward and then
-       * fake our upstream user into EOF.
-       */
-
-      PRINTLN ("STOP");
-      c->stop = 1;
-      break;
-    }/**/
-
-
-    if (c->state.avail_in > 0) {
-      PRINTLN ("More to process");
-      continue;
-    }
-
-    if ((c->state.avail_out == 0) && (res == Z_OK)) {
-      PRINTLN ("Output space exhausted, still ok");
-      continue;
-    }
-
-    break;
-  }
+  res = Inflate (c, -1, interp);
 
   DONE (ZipDecodeBuffer); 
-  return TCL_OK;
+  return res;
 }
-
+
 /*
  *------------------------------------------------------*
  *
- *	FlushDecoder --
+ *	DecodeBudget --
  *
  *	------------------------------------------------*
- *	Decode an incomplete character sequence (if possible).
+ *	Decode the given buffer, or the input kept from
+ *	the last call, and write at most 'budget' bytes.
+ *	See 'TrfConvertBudget'.
  *	------------------------------------------------*
  *
  *	Sideeffects:
- *		As of the called WriteFun.
+ *		As of the called WriteFun. Keeps the input
+ *		not decoded yet.
  *
  *	Result:
  *		Generated bytes implicitly via WriteFun.
@@ -945,24 +1430,225 @@ ClientData clientData;
  */
 
 static int
-FlushDecoder (ctrlBlock, interp, clientData)
+DecodeBudget (ctrlBlock, buffer, bufLen, budget, pending, interp, clientData)
 Trf_ControlBlock ctrlBlock;
+unsigned char* buffer;
+int bufLen;
+int budget;
+int* pending;
 Tcl_Interp* interp;
 ClientData clientData;
 {
   DecoderControl* c = (DecoderControl*) ctrlBlock;
-
-  /* execute conversion specific code here (ZIP) */
-
   int res;
 
-  START (ZipFlushDecoder); 
+  START (ZipDecodeBudget);
+  PRINT ("Data = %d, kept = %d, budget = %d\n", bufLen, c->keepLen, budget); FL;
 
-  c->state.next_in  = (Bytef*) c->output_buffer; /* fake out 'inflate' */
+  if (bufLen > 0) {
+    c->state.next_in  = (Bytef*) buffer;
+    c->state.avail_in = bufLen;
+  } else {
+    c->state.next_in  = (Bytef*) c->keep;
+    c->state.avail_in = c->keepLen;
+  }
+
+  res = Inflate (c, budget, interp);
+
+  /* Keep the unused input. The output budget is exhausted if zlib
+   * filled the last output buffer, it may hold more output.
+   */
+
+  if ((res != TCL_OK) || c->stop) {
+    c->keepLen = 0;
+    *pending   = 0;
+  } else {
+    if (c->state.avail_in > c->keepSize) {
+      c->keep     = (unsigned char*) ckrealloc ((char*) c->keep,
+					       c->state.avail_in);
+      c->keepSize = c->state.avail_in;
+    }
+    if (c->state.avail_in > 0) {
+      memmove ((VOID*) c->keep, (VOID*) c->state.next_in, c->state.avail_in);
+    }
+
+    c->keepLen = c->state.avail_in;
+    *pending   = (c->keepLen > 0) || (c->state.avail_out == 0);
+  }
+
+  DONE (ZipDecodeBudget);
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	Inflate --
+ *
+ *	------------------------------------------------*
+ *	Decompresses the input set into the state and
+ *	writes the result, at most 'budget' bytes, or
+ *	everything for a negative budget.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+Inflate (c, budget, interp)
+DecoderControl* c;
+int budget;
+Tcl_Interp* interp;
+{
+  unsigned char* out;
+  int res, avail, size;
+
+  for (;;) {
+    if ((c->state.avail_in <= 0) && (budget < 0)) {
+      PRINTLN ("Nothing to process");
+      break;
+    }
+
+    if (budget == 0) {
+      PRINTLN ("Budget exhausted");
+      break;
+    }
+
+    size = ((budget < 0) || (budget > OUT_SIZE)) ? OUT_SIZE : budget;
+
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (Bytef*) out;
+    c->state.avail_out = size;
+    avail              = c->state.avail_in;
+
+    if (c->index != (SeekIndex*) NULL) {
+      /* Stop at block boundaries, to record checkpoints */
+
+      PRINT ("inflate (Z_BLOCK)\n"); FL;
+      res = zf.zinflate (&c->state, Z_BLOCK);
+    } else {
+      PRINT ("inflate (Z_NO_FLUSH)\n"); FL;
+      res = zf.zinflate (&c->state, Z_NO_FLUSH);
+    }
+
+    IN; PRINTLN (ZlibErrorMsg (&c->state, res)); FL; OT;
+
+    if ((res == Z_BUF_ERROR) &&
+	((c->index != (SeekIndex*) NULL) || (budget >= 0))) {
+      /* No progress. Only held bits were decoded, or there was nothing
+       * left to deliver without more input.
+       */
+      res = Z_OK;
+    }
+
+    if ((res == Z_NEED_DICT) && (c->dictionary != (Tcl_Obj*) NULL)) {
+      res = SetDictionary (&c->state, c->dictionary, 0);
+    }
+
+    if ((res < Z_OK) || (res == Z_NEED_DICT)) {
+      if (interp) {
+	ZlibError (interp, &c->state, res, "decompressor");
+      }
+      return TCL_ERROR;
+    }
+
+    if (c->index != (SeekIndex*) NULL) {
+      IndexUpdate (c, out, size - c->state.avail_out,
+		   avail - c->state.avail_in);
+    }
+
+    if (c->state.avail_out < (uInt) size) {
+      if (budget > 0) {
+	budget -= size - c->state.avail_out;
+      }
+
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   size - c->state.avail_out, interp);
+      if (res != TCL_OK) {
+	return res;
+      }
+    } else if ((budget >= 0) && (c->state.avail_in == (uInt) avail) &&
+	       (res != Z_STREAM_END)) {
+      PRINTLN ("No progress");
+      break;
+    }
+
+    /* 29.11.1999, AK */
+    if (res == Z_STREAM_END) {
+      /* Don't process the remainining characters, they are not part of the
+       * compressed stream. Push them back into the channel downward and then
+       * fake our upstream user into EOF.
+       */
+
+      PRINTLN ("STOP");
+      c->stop = 1;
+      break;
+    }/**/
+
+
+    if (c->state.avail_in > 0) {
+      PRINTLN ("More to process");
+      continue;
+    }
+
+    if ((c->state.avail_out == 0) && (res == Z_OK)) {
+      PRINTLN ("Output space exhausted, still ok");
+      continue;
+    }
+
+    break;
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	FlushDecoder --
+ *
+ *	------------------------------------------------*
+ *	Decode an incomplete character sequence (if possible).
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		Generated bytes implicitly via WriteFun.
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+FlushDecoder (ctrlBlock, interp, clientData)
+Trf_ControlBlock ctrlBlock;
+Tcl_Interp* interp;
+ClientData clientData;
+{
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
+
+  /* execute conversion specific code here (ZIP) */
+
+  unsigned char* out = TrfScratchBuffer ();
+  int res;
+
+  START (ZipFlushDecoder); 
+
+  c->state.next_in  = (Bytef*) out; /* fake out 'inflate' */
   c->state.avail_in = 0;
 
   for (;;) {
-    c->state.next_out  = (Bytef*) c->output_buffer;
+    out = TrfWriteReserve (c->write, c->writeClientData, OUT_SIZE);
+    c->state.next_out  = (Bytef*) out;
     c->state.avail_out = OUT_SIZE;
 
     if (c->nowrap) {
@@ -989,8 +1675,8 @@ ClientData clientData;
     }
 
     if (c->state.avail_out < OUT_SIZE) {
-      res = c->write (c->writeClientData, (unsigned char*) c->output_buffer,
-		      OUT_SIZE - c->state.avail_out, interp);
+      res = TrfWriteCommit (c->write, c->writeClientData, out,
+			   OUT_SIZE - c->state.avail_out, interp);
       if (res != TCL_OK) {
 	DONE (ZipFlushDecoder); 
 	return res;
@@ -1037,8 +1723,21 @@ ClientData clientData;
 
   /* execute conversion specific code here (ZIP) */
 
+  c->keepLen = 0;
+
+  if (c->index != (SeekIndex*) NULL) {
+    /* The state may run as raw stream after a restart, reinitialize */
+    IndexRestart (c, 0);
+    DONE (ZipClearDecoder); 
+    return;
+  }
+
   zf.zinflateReset (&c->state);
 
+  if (c->nowrap && (c->dictionary != (Tcl_Obj*) NULL)) {
+    SetDictionary (&c->state, c->dictionary, 0);
+  }
+
   DONE (ZipClearDecoder); 
 }
 
@@ -1190,3 +1889,1415 @@ int         errcode;
 
   return msg;
 }
+
+/*
+ *------------------------------------------------------*
+ *
+ *	SetDictionary --
+ *
+ *	------------------------------------------------*
+ *	Applies a preset dictionary to a (de)compressor.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		A zlib error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+SetDictionary (state, dictionary, compress)
+z_streamp state;
+Tcl_Obj*  dictionary;
+int       compress;
+{
+  int            len;
+  unsigned char* dict = Tcl_GetByteArrayFromObj (dictionary, &len);
+
+  if (compress) {
+    PRINT ("deflateSetDictionary (%d)\n", len); FL;
+    return zf.zdeflateSetDictionary (state, (Bytef*) dict, (uInt) len);
+  } else {
+    PRINT ("inflateSetDictionary (%d)\n", len); FL;
+    return zf.zinflateSetDictionary (state, (Bytef*) dict, (uInt) len);
+  }
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	IndexCreate --
+ *
+ *	------------------------------------------------*
+ *	Allocates an empty seek index, containing only
+ *	the checkpoint for the start of the stream.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		The new index.
+ *
+ *------------------------------------------------------*
+ */
+
+static SeekIndex*
+IndexCreate (span)
+int span;
+{
+  SeekIndex* x = (SeekIndex*) ckalloc (sizeof (SeekIndex));
+
+  x->span        = span;
+  x->allocPoints = 16;
+  x->points      = (Checkpoint*) ckalloc (x->allocPoints * sizeof (Checkpoint));
+  x->numPoints   = 1;
+  x->upLoc       = 0;
+  x->downLoc     = 0;
+  x->ringPos     = 0;
+  x->ringLen     = 0;
+
+  x->points [0].upLoc     = 0;
+  x->points [0].downLoc   = 0;
+  x->points [0].bits      = 0;
+  x->points [0].value     = 0;
+  x->points [0].window    = (unsigned char*) NULL;
+  x->points [0].windowLen = 0;
+
+  return x;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	IndexDelete --
+ *
+ *	------------------------------------------------*
+ *	Releases a seek index and all its checkpoints.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases memory.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+IndexDelete (x)
+SeekIndex* x;
+{
+  int i;
+
+  for (i = 1; i < x->numPoints; i++) {
+    ckfree ((char*) x->points [i].window);
+  }
+
+  ckfree ((char*) x->points);
+  ckfree ((char*) x);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	IndexUpdate --
+ *
+ *	------------------------------------------------*
+ *	Remembers the output of the last call of inflate,
+ *	and records a checkpoint if that call stopped at a
+ *	block boundary far enough behind the last one.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		May allocate memory.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+IndexUpdate (c, out, written, consumed)
+DecoderControl* c;
+unsigned char*  out;
+int             written;
+int             consumed;
+{
+  SeekIndex*     x   = c->index;
+  Checkpoint*    p;
+  int            n, bits, start;
+
+  x->upLoc   += written;
+  x->downLoc += consumed;
+
+  if (written >= DICT_SIZE) {
+    memcpy ((VOID*) x->ring, (VOID*) (out + written - DICT_SIZE), DICT_SIZE);
+    x->ringPos = 0;
+    x->ringLen = DICT_SIZE;
+  } else {
+    while (written > 0) {
+      n = DICT_SIZE - x->ringPos;
+      if (n > written) {
+	n = written;
+      }
+
+      memcpy ((VOID*) (x->ring + x->ringPos), (VOID*) out, n);
+
+      x->ringPos  = (x->ringPos + n) % DICT_SIZE;
+      x->ringLen += n;
+      out        += n;
+      written    -= n;
+    }
+
+    if (x->ringLen > DICT_SIZE) {
+      x->ringLen = DICT_SIZE;
+    }
+  }
+
+  /* Checkpoints are placed only at the end of a block which is not the
+   * last. The byte holding the pending bits has to be in the current
+   * input, so that we are able to remember them.
+   */
+
+  if (!(c->state.data_type & 128) || (c->state.data_type & 64)) {
+    return;
+  }
+
+  bits = c->state.data_type & 7;
+
+  if ((x->upLoc - x->points [x->numPoints-1].upLoc < x->span) ||
+      (bits && (consumed <= 0))) {
+    return;
+  }
+
+  if (x->numPoints == x->allocPoints) {
+    x->allocPoints *= 2;
+    x->points = (Checkpoint*) ckrealloc ((char*) x->points,
+				 x->allocPoints * sizeof (Checkpoint));
+  }
+
+  p = &x->points [x->numPoints ++];
+
+  p->upLoc     = x->upLoc;
+  p->downLoc   = x->downLoc;
+  p->bits      = bits;
+  p->value     = bits ? (c->state.next_in [-1] >> (8 - bits)) : 0;
+  p->windowLen = x->ringLen;
+  p->window    = (unsigned char*) ckalloc (x->ringLen);
+
+  PRINT ("Checkpoint %d: up %ld, down %ld, bits %d\n", x->numPoints-1,
+	 (long) p->upLoc, (long) p->downLoc, p->bits); FL;
+
+  /* Unroll the ring, oldest byte first */
+
+  start = (x->ringPos - x->ringLen + DICT_SIZE) % DICT_SIZE;
+  n     = DICT_SIZE - start;
+  if (n > x->ringLen) {
+    n = x->ringLen;
+  }
+
+  memcpy ((VOID*) p->window, (VOID*) (x->ring + start), n);
+  memcpy ((VOID*) (p->window + n), (VOID*) x->ring, x->ringLen - n);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	IndexRestart --
+ *
+ *	------------------------------------------------*
+ *	Reinitializes the decompressor to continue at the
+ *	specified checkpoint. Except for the start of the
+ *	stream this is a raw inflate primed with the pending
+ *	bits and the window of the checkpoint.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		A zlib error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+IndexRestart (c, point)
+DecoderControl* c;
+int             point;
+{
+  SeekIndex*  x = c->index;
+  Checkpoint* p = &x->points [point];
+  int       res;
+
+  PRINT ("Restart at checkpoint %d (up %ld, down %ld)\n", point,
+	 (long) p->upLoc, (long) p->downLoc); FL;
+
+  zf.zinflateEnd (&c->state);
+
+  c->state.zalloc = Z_NULL;
+  c->state.zfree  = Z_NULL;
+  c->state.opaque = Z_NULL;
+
+  if (point == 0) {
+    res = zf.zinflateInit2_ (&c->state,
+			     c->nowrap ? -c->window : c->window,
+			     ZLIB_VERSION, sizeof (z_stream));
+
+    x->ringPos = 0;
+    x->ringLen = 0;
+
+    if (c->dictionary != (Tcl_Obj*) NULL) {
+      /* The preset dictionary is the virtual output before the start */
+
+      int            len;
+      unsigned char* dict = Tcl_GetByteArrayFromObj (c->dictionary, &len);
+
+      if (len > DICT_SIZE) {
+	dict += len - DICT_SIZE;
+	len   = DICT_SIZE;
+      }
+
+      memcpy ((VOID*) x->ring, (VOID*) dict, len);
+      x->ringPos = len % DICT_SIZE;
+      x->ringLen = len;
+
+      if ((res == Z_OK) && c->nowrap) {
+	res = SetDictionary (&c->state, c->dictionary, 0);
+      }
+    }
+  } else {
+    res = zf.zinflateInit2_ (&c->state, -c->window,
+			     ZLIB_VERSION, sizeof (z_stream));
+
+    if ((res == Z_OK) && p->bits) {
+      res = zf.zinflatePrime (&c->state, p->bits, p->value);
+    }
+    if (res == Z_OK) {
+      res = zf.zinflateSetDictionary (&c->state, (Bytef*) p->window,
+				      (uInt) p->windowLen);
+    }
+
+    memcpy ((VOID*) x->ring, (VOID*) p->window, p->windowLen);
+    x->ringPos = p->windowLen % DICT_SIZE;
+    x->ringLen = p->windowLen;
+  }
+
+  x->upLoc   = p->upLoc;
+  x->downLoc = p->downLoc;
+  c->stop    = 0;
+  c->keepLen = 0;
+
+  IN; PRINTLN (ZlibErrorMsg (&c->state, res)); FL; OT;
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	SeekCheckpoint --
+ *
+ *	------------------------------------------------*
+ *	Looks for the last checkpoint at or before the
+ *	given location, and restarts the decompressor
+ *	there, if so requested. Registered with the generic
+ *	layer for the decoder vectors, see 'TrfInit_ZIP'.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		A standard Tcl error code. TCL_ERROR if the
+ *		decompressor does not build an index.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+SeekCheckpoint (ctrlBlock, location, restore, upLoc, downLoc, clientData)
+Trf_ControlBlock ctrlBlock;
+Tcl_WideInt      location;
+int              restore;
+Tcl_WideInt*     upLoc;
+Tcl_WideInt*     downLoc;
+ClientData       clientData;
+{
+  DecoderControl* c = (DecoderControl*) ctrlBlock;
+  SeekIndex*      x = c->index;
+  int lo, hi, mid;
+
+  if (x == (SeekIndex*) NULL) {
+    return TCL_ERROR;
+  }
+
+  /* Binary search, points [lo].upLoc <= location < points [hi].upLoc */
+
+  lo = 0;
+  hi = x->numPoints;
+
+  while (hi - lo > 1) {
+    mid = (lo + hi) / 2;
+
+    if (x->points [mid].upLoc <= location) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+
+  *upLoc   = x->points [lo].upLoc;
+  *downLoc = x->points [lo].downLoc;
+
+  if (restore && (Z_OK != IndexRestart (c, lo))) {
+    return TCL_ERROR;
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelCreate --
+ *
+ *	------------------------------------------------*
+ *	Allocates the state of a parallel compression, if
+ *	requested by the options.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		The new state, or NULL if the compression is
+ *		not parallel.
+ *
+ *------------------------------------------------------*
+ */
+
+static ParallelDeflate*
+ParallelCreate (o)
+TrfZipOptionBlock* o;
+{
+  ParallelDeflate* p;
+  int              i;
+
+  if (o->threads <= 1) {
+    return (ParallelDeflate*) NULL;
+  }
+
+  p = (ParallelDeflate*) ckalloc (sizeof (ParallelDeflate));
+
+  p->threads   = o->threads;
+  p->blocksize = o->blocksize;
+  p->level     = o->level;
+  p->memlevel  = o->memlevel;
+  p->strategy  = o->strategy;
+  p->window    = o->window;
+  p->nowrap    = o->nowrap;
+  p->buffer    = (unsigned char*) ckalloc (DICT_SIZE + p->threads * p->blocksize);
+  p->jobs      = (DeflateJob*) ckalloc (p->threads * sizeof (DeflateJob));
+
+  memset ((VOID*) p->jobs, 0, p->threads * sizeof (DeflateJob));
+  for (i = 0; i < p->threads; i++) {
+    p->jobs [i].par = p;
+  }
+
+#ifdef TCL_THREADS
+  p->started  = 0;
+  p->shutdown = 0;
+  p->lock     = (Tcl_Mutex) NULL;
+  p->cond     = (Tcl_Condition) NULL;
+#endif
+
+  ParallelClear (p);
+
+  return p;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelDelete --
+ *
+ *	------------------------------------------------*
+ *	Releases the state of a parallel compression,
+ *	after stopping its worker threads.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases memory, ends threads.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ParallelDelete (p)
+ParallelDeflate* p;
+{
+  int i;
+
+#ifdef TCL_THREADS
+  if (p->started) {
+    int result;
+
+    Tcl_MutexLock (&p->lock);
+    p->shutdown = 1;
+    Tcl_ConditionNotify (&p->cond);
+    Tcl_MutexUnlock (&p->lock);
+
+    for (i = 1; i < p->threads; i++) {
+      if (p->jobs [i].worker) {
+	Tcl_JoinThread (p->tid [i], &result);
+      }
+    }
+  }
+
+  Tcl_MutexFinalize     (&p->lock);
+  Tcl_ConditionFinalize (&p->cond);
+#endif
+
+  for (i = 0; i < p->threads; i++) {
+    if (p->jobs [i].out != (unsigned char*) NULL) {
+      ckfree ((char*) p->jobs [i].out);
+    }
+  }
+
+  ckfree ((char*) p->jobs);
+  ckfree ((char*) p->buffer);
+  ckfree ((char*) p);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelClear --
+ *
+ *	------------------------------------------------*
+ *	Discards waiting input and history, i.e. the next
+ *	data starts a new stream.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ParallelClear (p)
+ParallelDeflate* p;
+{
+  p->histLen    = 0;
+  p->inLen      = 0;
+  p->headerDone = 0;
+  p->adler      = zf.zadler32 (0L, (Bytef*) NULL, 0);
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	RunJob --
+ *
+ *	------------------------------------------------*
+ *	Compresses a single block. Executed by the worker
+ *	threads, and by the thread owning the compressor.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates and fills the output buffer of
+ *		the job.
+ *
+ *	Result:
+ *		None. The zlib result is stored in the job.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+RunJob (j)
+DeflateJob* j;
+{
+  int flush = j->last ? Z_FINISH : Z_SYNC_FLUSH;
+  int res;
+
+  memset ((VOID*) &j->state, 0, sizeof (z_stream));
+  j->outLen = 0;
+
+  res = zf.zdeflateInit2_ (&j->state, j->level, Z_DEFLATED, -j->window,
+			   j->memlevel, j->strategy,
+			   ZLIB_VERSION, sizeof (z_stream));
+  if (res != Z_OK) {
+    j->res = res;
+    return;
+  }
+
+  if (j->dictLen > 0) {
+    res = zf.zdeflateSetDictionary (&j->state, (Bytef*) j->dict, j->dictLen);
+    if (res != Z_OK) {
+      zf.zdeflateEnd (&j->state);
+      j->res = res;
+      return;
+    }
+  }
+
+  /*
+   * Stored blocks are the worst case of deflate, they expand the
+   * input by 5 bytes per 16K. Grow the buffer if even that was not
+   * enough.
+   */
+
+  if (j->outSize < (j->inLen + j->inLen / 1024 + 64)) {
+    if (j->out != (unsigned char*) NULL) {
+      ckfree ((char*) j->out);
+    }
+    j->outSize = j->inLen + j->inLen / 1024 + 64;
+    j->out     = (unsigned char*) ckalloc (j->outSize);
+  }
+
+  j->state.next_in  = (Bytef*) j->in;
+  j->state.avail_in = j->inLen;
+
+  for (;;) {
+    j->state.next_out  = (Bytef*) (j->out + j->outLen);
+    j->state.avail_out = j->outSize - j->outLen;
+
+    res = zf.zdeflate (&j->state, flush);
+    j->outLen = j->outSize - j->state.avail_out;
+
+    if ((res < Z_OK) && (res != Z_BUF_ERROR)) {
+      break;
+    }
+    if (res == Z_STREAM_END) {
+      res = Z_OK;
+      break;
+    }
+    if ((j->state.avail_out > 0) && !j->last) {
+      res = Z_OK;
+      break;
+    }
+
+    j->outSize *= 2;
+    j->out = (unsigned char*) ckrealloc ((char*) j->out, j->outSize);
+  }
+
+  zf.zdeflateEnd (&j->state);
+  j->res = res;
+}
+
+#ifdef TCL_THREADS
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelStart --
+ *
+ *	------------------------------------------------*
+ *	Starts the worker threads of a parallel
+ *	compression, one per job except the first, which
+ *	is run by the thread owning the compressor.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Creates threads. Jobs without a thread are
+ *		run by the owner.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+ParallelStart (p)
+ParallelDeflate* p;
+{
+  int i;
+
+  p->started = 1;
+
+  for (i = 1; i < p->threads; i++) {
+    p->jobs [i].worker = (TCL_OK == Tcl_CreateThread (&p->tid [i],
+					DeflateWorker,
+					(ClientData) &p->jobs [i],
+					TCL_THREAD_STACK_DEFAULT,
+					TCL_THREAD_JOINABLE));
+  }
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	DeflateWorker --
+ *
+ *	------------------------------------------------*
+ *	Body of the worker threads. Runs its job whenever
+ *	it is ready, until the compressor is deleted.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See 'RunJob'.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static Tcl_ThreadCreateType
+DeflateWorker (clientData)
+ClientData clientData;
+{
+  DeflateJob*      j = (DeflateJob*) clientData;
+  ParallelDeflate* p = j->par;
+
+  Tcl_MutexLock (&p->lock);
+
+  while (1) {
+    while (!j->ready && !p->shutdown) {
+      Tcl_ConditionWait (&p->cond, &p->lock, (Tcl_Time*) NULL);
+    }
+    if (!j->ready) {
+      break;
+    }
+
+    Tcl_MutexUnlock (&p->lock);
+    RunJob (j);
+    Tcl_MutexLock (&p->lock);
+
+    j->ready = 0;
+    Tcl_ConditionNotify (&p->cond);
+  }
+
+  Tcl_MutexUnlock (&p->lock);
+
+  /* Run the exit handlers of the thread, they release its scratch
+   * buffers and the allocator caches.
+   */
+
+  Tcl_ExitThread (0);
+  TCL_THREAD_CREATE_RETURN;
+}
+#endif
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelCompress --
+ *
+ *	------------------------------------------------*
+ *	Compresses all waiting input, one block per
+ *	thread, and writes the results in order.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun. Moves the tail
+ *		of the input into the history.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ParallelCompress (c, last, interp)
+EncoderControl* c;
+int             last;
+Tcl_Interp*     interp;
+{
+  ParallelDeflate* p     = c->par;
+  unsigned char*   start = p->buffer + DICT_SIZE;
+  int              n, i, res = TCL_OK;
+
+  n = (p->inLen + p->blocksize - 1) / p->blocksize;
+  if (n == 0) {
+    n = 1; /* Empty final block */
+  }
+
+  for (i = 0; i < n; i++) {
+    DeflateJob* j = &p->jobs [i];
+    int       off = i * p->blocksize;
+
+    j->in       = start + off;
+    j->inLen    = (i < n-1) ? p->blocksize : (p->inLen - off);
+    j->dictLen  = (off + p->histLen < DICT_SIZE) ? (off + p->histLen) : DICT_SIZE;
+    j->dict     = j->in - j->dictLen;
+    j->last     = last && (i == n-1);
+    j->level    = p->level;
+    j->memlevel = p->memlevel;
+    j->strategy = p->strategy;
+    j->window   = p->window;
+    j->res      = Z_OK;
+  }
+
+  /*
+   * Blocks 1..n-1 go to worker threads, block 0 is done here, and
+   * while the workers run, the checksum for the trailer is computed.
+   */
+
+#ifdef TCL_THREADS
+  if (n > 1) {
+    if (!p->started) {
+      ParallelStart (p);
+    }
+
+    Tcl_MutexLock (&p->lock);
+    for (i = 1; i < n; i++) {
+      p->jobs [i].ready = p->jobs [i].worker;
+    }
+    Tcl_ConditionNotify (&p->cond);
+    Tcl_MutexUnlock (&p->lock);
+  }
+#endif
+
+  RunJob (&p->jobs [0]);
+
+  if (!p->nowrap) {
+    p->adler = zf.zadler32 (p->adler, (Bytef*) start, p->inLen);
+  }
+
+  for (i = 1; i < n; i++) {
+#ifdef TCL_THREADS
+    if (p->jobs [i].worker) {
+      Tcl_MutexLock (&p->lock);
+      while (p->jobs [i].ready) {
+	Tcl_ConditionWait (&p->cond, &p->lock, (Tcl_Time*) NULL);
+      }
+      Tcl_MutexUnlock (&p->lock);
+      continue;
+    }
+#endif
+    /* No threads, or thread creation failed */
+    RunJob (&p->jobs [i]);
+  }
+
+  if (!p->headerDone && !p->nowrap) {
+    /*
+     * zlib header, RFC 1950: CMF, FLG with level hint and check bits.
+     */
+
+    unsigned char hdr [2];
+    int           flevel;
+
+    if      (p->level == Z_DEFAULT_COMPRESSION) flevel = 2;
+    else if (p->level < 2)                      flevel = 0;
+    else if (p->level < 6)                      flevel = 1;
+    else if (p->level == 6)                     flevel = 2;
+    else                                        flevel = 3;
+
+    hdr [0] = ((p->window - 8) << 4) | Z_DEFLATED;
+    hdr [1] = flevel << 6;
+    hdr [1] += 31 - ((hdr [0] * 256 + hdr [1]) % 31);
+
+    res = c->write (c->writeClientData, hdr, 2, interp);
+  }
+  p->headerDone = 1;
+
+  for (i = 0; (i < n) && (res == TCL_OK); i++) {
+    DeflateJob* j = &p->jobs [i];
+
+    if (j->res != Z_OK) {
+      if (interp) {
+	ZlibError (interp, &j->state, j->res, "compressor/parallel");
+      }
+      res = TCL_ERROR;
+      break;
+    }
+
+    res = c->write (c->writeClientData, j->out, j->outLen, interp);
+  }
+
+  if ((res == TCL_OK) && last && !p->nowrap) {
+    unsigned char trailer [4];
+
+    trailer [0] = (unsigned char) ((p->adler >> 24) & 0xff);
+    trailer [1] = (unsigned char) ((p->adler >> 16) & 0xff);
+    trailer [2] = (unsigned char) ((p->adler >>  8) & 0xff);
+    trailer [3] = (unsigned char) ( p->adler        & 0xff);
+
+    res = c->write (c->writeClientData, trailer, 4, interp);
+  }
+
+  /*
+   * Keep the last DICT_SIZE bytes as history for the next batch.
+   */
+
+  i = p->histLen + p->inLen;
+  if (i > DICT_SIZE) {
+    i = DICT_SIZE;
+  }
+  memmove (p->buffer + DICT_SIZE - i, start + p->inLen - i, i);
+  p->histLen = i;
+  p->inLen   = 0;
+
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelWrite --
+ *
+ *	------------------------------------------------*
+ *	Collects input for a parallel compression, and
+ *	compresses it whenever a block is available for
+ *	every thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ParallelWrite (c, buffer, bufLen, interp)
+EncoderControl* c;
+unsigned char*  buffer;
+int             bufLen;
+Tcl_Interp*     interp;
+{
+  ParallelDeflate* p   = c->par;
+  int              max = p->threads * p->blocksize;
+  int              res;
+
+  while (bufLen > 0) {
+    int k = max - p->inLen;
+
+    if (k > bufLen) {
+      k = bufLen;
+    }
+
+    memcpy (p->buffer + DICT_SIZE + p->inLen, buffer, k);
+    p->inLen += k;
+    buffer   += k;
+    bufLen   -= k;
+
+    /*
+     * A full batch is compressed only when more input arrives. Thus
+     * the batch containing the end of the data is always handled
+     * by 'ParallelFlush', which finishes the stream with it.
+     */
+
+    if ((p->inLen == max) && (bufLen > 0)) {
+      res = ParallelCompress (c, 0, interp);
+      if (res != TCL_OK) {
+	return res;
+      }
+    }
+  }
+
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	ParallelFlush --
+ *
+ *	------------------------------------------------*
+ *	Compresses the waiting input and finishes the
+ *	stream.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		As of the called WriteFun.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+ParallelFlush (c, interp)
+EncoderControl* c;
+Tcl_Interp*     interp;
+{
+  int res = ParallelCompress (c, 1, interp);
+
+  ParallelClear (c->par);
+  return res;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	HibernateCreate --
+ *
+ *	------------------------------------------------*
+ *	Allocates the saved form of a compressor, for
+ *	a compressor starting asleep.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates memory.
+ *
+ *	Result:
+ *		See above.
+ *
+ *------------------------------------------------------*
+ */
+
+static Hibernation*
+HibernateCreate ()
+{
+  Hibernation* h = (Hibernation*) ckalloc (sizeof (Hibernation));
+
+  h->asleep     = 1;
+  h->started    = 0;
+  h->raw        = 0;
+  h->adler      = zf.zadler32 (0L, (Bytef*) NULL, 0);
+  h->historyLen = 0;
+
+  return h;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	HibernateWake --
+ *
+ *	------------------------------------------------*
+ *	Rebuilds the state of a sleeping compressor. A
+ *	new stream starts like a fresh compressor, else
+ *	a raw stream continues it, primed with the
+ *	saved history.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Allocates the zlib state.
+ *
+ *	Result:
+ *		A standard Tcl error code.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+HibernateWake (c, interp)
+EncoderControl* c;
+Tcl_Interp*     interp;
+{
+  Hibernation* h = c->hib;
+  int          res;
+
+  if (!h->asleep) {
+    return TCL_OK;
+  }
+
+  c->state.zalloc = Z_NULL;
+  c->state.zfree  = Z_NULL;
+  c->state.opaque = Z_NULL;
+
+  PRINT ("deflateInit (%d, %d, %d, %d, %s), wake\n", c->level, c->window,
+	 c->memlevel, c->strategy, ZLIB_VERSION); FL;
+
+  res = zf.zdeflateInit2_ (&c->state, c->level, Z_DEFLATED,
+			   (c->nowrap || h->started) ?
+			   -c->window :
+			   c->window,
+			   c->memlevel, c->strategy,
+			   ZLIB_VERSION, sizeof(z_stream));
+
+  if (res != Z_OK) {
+    if (interp) {
+      ZlibError (interp, &c->state, res, "compressor/init");
+    }
+    return TCL_ERROR;
+  }
+
+  if (h->started) {
+    if (h->historyLen > 0) {
+      res = zf.zdeflateSetDictionary (&c->state, (Bytef*) h->history,
+				      h->historyLen);
+    }
+  } else if (c->dictionary != (Tcl_Obj*) NULL) {
+    res = SetDictionary (&c->state, c->dictionary, 1);
+  }
+
+  if (res != Z_OK) {
+    if (interp) {
+      ZlibError (interp, &c->state, res, "compressor/dictionary");
+    }
+    zf.zdeflateEnd (&c->state);
+    return TCL_ERROR;
+  }
+
+  h->asleep = 0;
+  h->raw    = h->started;
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	HibernateSleep --
+ *
+ *	------------------------------------------------*
+ *	Releases the state of a compressor after a
+ *	completed flush.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases the zlib state.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+HibernateSleep (c)
+EncoderControl* c;
+{
+  PRINT ("deflateEnd (), sleep\n"); FL;
+
+  zf.zdeflateEnd (&c->state);
+
+  c->hib->asleep  = 1;
+  c->hib->started = 1;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	HibernateTrack --
+ *
+ *	------------------------------------------------*
+ *	Remembers the checksum and the tail of the
+ *	input given to a hibernating compressor.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+HibernateTrack (c, buffer, bufLen)
+EncoderControl* c;
+unsigned char*  buffer;
+int             bufLen;
+{
+  Hibernation* h = c->hib;
+  int          keep;
+
+  if (!c->nowrap) {
+    h->adler = zf.zadler32 (h->adler, (Bytef*) buffer, bufLen);
+  }
+
+  if (c->flush != Z_SYNC_FLUSH) {
+    return;
+  }
+
+  if (bufLen >= HIB_HISTORY) {
+    memcpy ((VOID*) h->history, (VOID*) (buffer + bufLen - HIB_HISTORY),
+	    HIB_HISTORY);
+    h->historyLen = HIB_HISTORY;
+    return;
+  }
+
+  keep = HIB_HISTORY - bufLen;
+  if (keep > h->historyLen) {
+    keep = h->historyLen;
+  }
+
+  memmove ((VOID*) h->history, (VOID*) (h->history + h->historyLen - keep),
+	   keep);
+  memcpy  ((VOID*) (h->history + keep), (VOID*) buffer, bufLen);
+  h->historyLen = keep + bufLen;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	HibernateClear --
+ *
+ *	------------------------------------------------*
+ *	Discards the state and the saved form, i.e. the
+ *	next write starts a new stream.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases the zlib state.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+HibernateClear (c)
+EncoderControl* c;
+{
+  Hibernation* h = c->hib;
+
+  if (!h->asleep) {
+    zf.zdeflateEnd (&c->state);
+  }
+
+  h->asleep     = 1;
+  h->started    = 0;
+  h->raw        = 0;
+  h->adler      = zf.zadler32 (0L, (Bytef*) NULL, 0);
+  h->historyLen = 0;
+}
+
+#if GT81
+/*
+ *------------------------------------------------------*
+ *
+ *	PoolGetEncoder --
+ *
+ *	------------------------------------------------*
+ *	Retrieves a reset compressor initialized with the
+ *	parameters specified in the options from the pool
+ *	of the current thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Removes the control block from the pool.
+ *
+ *	Result:
+ *		The control block, or NULL if there is no
+ *		matching one.
+ *
+ *------------------------------------------------------*
+ */
+
+static EncoderControl*
+PoolGetEncoder (o)
+TrfZipOptionBlock* o;
+{
+  ThreadSpecificData* tsdPtr = (ThreadSpecificData*)
+    Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+  EncoderControl** link;
+
+  for (link = &tsdPtr->encoders;
+       *link != (EncoderControl*) NULL;
+       link = &(*link)->nextFree) {
+    EncoderControl* c = *link;
+
+    if ((c->level    == o->level)    && (c->nowrap   == o->nowrap) &&
+	(c->strategy == o->strategy) && (c->memlevel == o->memlevel) &&
+	(c->window   == o->window)) {
+      *link       = c->nextFree;
+      c->nextFree = (EncoderControl*) NULL;
+      tsdPtr->numEncoders --;
+      return c;
+    }
+  }
+
+  return (EncoderControl*) NULL;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PoolPutEncoder --
+ *
+ *	------------------------------------------------*
+ *	Resets the compressor and keeps it in the pool of
+ *	the current thread, if there is room.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above. Registers the thread exit handler
+ *		releasing the pool, on first use.
+ *
+ *	Result:
+ *		A boolean value, true if the control block
+ *		was taken by the pool.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+PoolPutEncoder (c)
+EncoderControl* c;
+{
+  ThreadSpecificData* tsdPtr = (ThreadSpecificData*)
+    Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+
+  if (tsdPtr->numEncoders >= POOL_SIZE) {
+    return 0;
+  }
+
+  if (Z_OK != zf.zdeflateReset (&c->state)) {
+    return 0;
+  }
+
+  if (!tsdPtr->initialized) {
+    tsdPtr->initialized = 1;
+    Tcl_CreateThreadExitHandler (PoolRelease, (ClientData) NULL);
+  }
+
+  c->write           = (Trf_WriteProc*) NULL;
+  c->writeClientData = (ClientData) NULL;
+  c->nextFree        = tsdPtr->encoders;
+  tsdPtr->encoders   = c;
+  tsdPtr->numEncoders ++;
+  return 1;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PoolGetDecoder --
+ *
+ *	------------------------------------------------*
+ *	As 'PoolGetEncoder', for decompressors.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Removes the control block from the pool.
+ *
+ *	Result:
+ *		The control block, or NULL if there is no
+ *		matching one.
+ *
+ *------------------------------------------------------*
+ */
+
+static DecoderControl*
+PoolGetDecoder (o)
+TrfZipOptionBlock* o;
+{
+  ThreadSpecificData* tsdPtr = (ThreadSpecificData*)
+    Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+  DecoderControl** link;
+
+  for (link = &tsdPtr->decoders;
+       *link != (DecoderControl*) NULL;
+       link = &(*link)->nextFree) {
+    DecoderControl* c = *link;
+
+    if ((c->nowrap == o->nowrap) && (c->window == o->window)) {
+      *link       = c->nextFree;
+      c->nextFree = (DecoderControl*) NULL;
+      tsdPtr->numDecoders --;
+      return c;
+    }
+  }
+
+  return (DecoderControl*) NULL;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PoolPutDecoder --
+ *
+ *	------------------------------------------------*
+ *	As 'PoolPutEncoder', for decompressors.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		See above.
+ *
+ *	Result:
+ *		A boolean value, true if the control block
+ *		was taken by the pool.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+PoolPutDecoder (c)
+DecoderControl* c;
+{
+  ThreadSpecificData* tsdPtr = (ThreadSpecificData*)
+    Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+
+  if (tsdPtr->numDecoders >= POOL_SIZE) {
+    return 0;
+  }
+
+  if (Z_OK != zf.zinflateReset (&c->state)) {
+    return 0;
+  }
+
+  if (!tsdPtr->initialized) {
+    tsdPtr->initialized = 1;
+    Tcl_CreateThreadExitHandler (PoolRelease, (ClientData) NULL);
+  }
+
+  c->write           = (Trf_WriteProc*) NULL;
+  c->writeClientData = (ClientData) NULL;
+  c->stop            = 0;
+  c->nextFree        = tsdPtr->decoders;
+  tsdPtr->decoders   = c;
+  tsdPtr->numDecoders ++;
+  return 1;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	PoolRelease --
+ *
+ *	------------------------------------------------*
+ *	Thread exit handler. Destroys all control blocks
+ *	in the pool of the exiting thread.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		Releases memory and zlib state.
+ *
+ *	Result:
+ *		None.
+ *
+ *------------------------------------------------------*
+ */
+
+static void
+PoolRelease (clientData)
+ClientData clientData;
+{
+  ThreadSpecificData* tsdPtr = (ThreadSpecificData*)
+    Tcl_GetThreadData (&dataKey, sizeof (ThreadSpecificData));
+
+  while (tsdPtr->encoders != (EncoderControl*) NULL) {
+    EncoderControl* c = tsdPtr->encoders;
+
+    tsdPtr->encoders = c->nextFree;
+    zf.zdeflateEnd (&c->state);
+    ckfree ((char*) c);
+  }
+
+  while (tsdPtr->decoders != (DecoderControl*) NULL) {
+    DecoderControl* c = tsdPtr->decoders;
+
+    tsdPtr->decoders = c->nextFree;
+    zf.zinflateEnd (&c->state);
+    ckfree ((char*) c);
+  }
+
+  tsdPtr->numEncoders = 0;
+  tsdPtr->numDecoders = 0;
+  tsdPtr->initialized = 0;
+}
+#endif
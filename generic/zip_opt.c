@@ -53,6 +53,20 @@ static int         SetOption     _ANSI_ARGS_ ((Trf_Options    options,
 static int         QueryOptions  _ANSI_ARGS_ ((Trf_Options options,
 					       ClientData  clientData));
 
+static int         IntOption     _ANSI_ARGS_ ((Tcl_Interp*    interp,
+					       CONST Tcl_Obj* optvalue,
+					       int            min,
+					       int            max,
+					       CONST char*    what,
+					       int*           result));
+
+static int         SizeOption    _ANSI_ARGS_ ((Tcl_Interp*    interp,
+					       CONST Tcl_Obj* optvalue,
+					       int            min,
+					       int            max,
+					       CONST char*    range,
+					       CONST char*    what,
+					       int*           result));
 
 /*
  *------------------------------------------------------*
@@ -122,6 +136,15 @@ ClientData clientData;
   o->mode   = TRF_UNKNOWN_MODE;
   o->level  = TRF_DEFAULT_LEVEL;
   o->nowrap = 0;
+  o->flush  = Z_NO_FLUSH;
+  o->dictionary = (Tcl_Obj*) NULL;
+  o->strategy = Z_DEFAULT_STRATEGY;
+  o->memlevel = MAX_MEM_LEVEL;
+  o->window   = MAX_WBITS;
+  o->threads  = 1;
+  o->blocksize = TRF_DEFAULT_BLOCKSIZE;
+  o->index     = 0;
+  o->hibernate = 0;
 
   return (Trf_Options) o;
 }
@@ -150,6 +173,12 @@ DeleteOptions (options, clientData)
 Trf_Options options;
 ClientData  clientData;
 {
+  TrfZipOptionBlock* o = (TrfZipOptionBlock*) options;
+
+  if (o->dictionary != (Tcl_Obj*) NULL) {
+    Tcl_DecrRefCount (o->dictionary);
+  }
+
   ckfree ((VOID*) options);
 }
 
@@ -205,6 +234,93 @@ ClientData             clientData;
     }
   }
 
+  if (o->index > 0) {
+    /*
+     * The seek index is built while reading from an attached
+     * channel. Restarting inside the compressed stream requires
+     * 'inflatePrime', which older versions of zlib do not have.
+     */
+
+    if (baseOptions->attach == (Tcl_Channel) NULL) {
+      Tcl_AppendResult (interp, "immediate: -index not allowed",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+    if (zf.zinflatePrime == NULL) {
+      Tcl_AppendResult (interp, "-index not supported, zlib is too old",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+  }
+
+  if (o->hibernate && (o->mode == TRF_COMPRESS)) {
+    /*
+     * The state is released after the flush completing every write
+     * to the attached channel. Without such flushes it is always in
+     * use.
+     */
+
+    if (baseOptions->attach == (Tcl_Channel) NULL) {
+      Tcl_AppendResult (interp, "immediate: -hibernate not allowed",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+    if (o->flush == Z_NO_FLUSH) {
+      Tcl_AppendResult (interp, "-hibernate requires -flush sync or full",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+  }
+
+  if ((o->threads > 1) && (o->mode == TRF_COMPRESS)) {
+    /*
+     * The blocks of a parallel compression are independent of the
+     * flushes of the channel, and use the preceding block as their
+     * dictionary.
+     */
+
+    if (o->dictionary != (Tcl_Obj*) NULL) {
+      Tcl_AppendResult (interp, "-dictionary not allowed for parallel compression",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+    if (o->flush != Z_NO_FLUSH) {
+      Tcl_AppendResult (interp, "-flush not allowed for parallel compression",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+
+    /*
+     * The compressor buffers a whole batch of blocks. Keep its size
+     * well inside of an 'int'.
+     */
+
+    if (((Tcl_WideInt) o->threads * (Tcl_WideInt) o->blocksize) >
+	(Tcl_WideInt) TRF_MAX_BATCH) {
+      Tcl_AppendResult (interp, "-threads times -blocksize larger than 256M",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+  }
+
+  if (o->flush != Z_NO_FLUSH) {
+    /*
+     * The flushes are done for the writes to an attached channel.
+     * Immediate mode and decompression never see them.
+     */
+
+    if (baseOptions->attach == (Tcl_Channel) NULL) {
+      Tcl_AppendResult (interp, "immediate: -flush not allowed",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+    if (o->mode != TRF_COMPRESS) {
+      Tcl_AppendResult (interp, "-flush not allowed for decompression",
+			(char*) NULL);
+      return TCL_ERROR;
+    }
+  }
+
   return TCL_OK;
 }
 
@@ -237,11 +353,20 @@ ClientData  clientData;
 {
   /* Possible options:
    *
+   * -blocksize <number>[K|M]
+   * -dictionary <bytes>
+   * -flush  sync|full|finish
+   * -hibernate <boolean>
+   * -index  <number>[K|M]
    * -level  <number>
    * -level  default
+   * -memlevel <number>
    * -mode   compress|decompress
    * -nowrap <boolean>
    * -nowrap default
+   * -strategy default|filtered|huffman|rle|fixed
+   * -threads <number>
+   * -window <number>
    */
 
   TrfZipOptionBlock* o = (TrfZipOptionBlock*) options;
@@ -249,6 +374,84 @@ ClientData  clientData;
   CONST char*      value;
 
   switch (optname [1]) {
+  case 'b':
+    if (0 != strncmp (optname, "-blocksize", len))
+      goto unknown_option;
+
+    return SizeOption (interp, optvalue, TRF_MIN_BLOCKSIZE, TRF_MAX_BLOCKSIZE,
+		       "1K..64M", "blocksize", &o->blocksize);
+    break;
+
+  case 'd':
+    if (0 != strncmp (optname, "-dictionary", len))
+      goto unknown_option;
+
+    if (o->dictionary != (Tcl_Obj*) NULL) {
+      Tcl_DecrRefCount (o->dictionary);
+      o->dictionary = (Tcl_Obj*) NULL;
+    }
+
+    (void) Tcl_GetByteArrayFromObj ((Tcl_Obj*) optvalue, &len);
+
+    if (len > 0) {
+      o->dictionary = (Tcl_Obj*) optvalue;
+      Tcl_IncrRefCount (o->dictionary);
+    }
+    break;
+
+  case 'f':
+    if (0 != strncmp (optname, "-flush", len))
+      goto unknown_option;
+
+    value = Tcl_GetStringFromObj ((Tcl_Obj*) optvalue, NULL);
+    len   = strlen (value);
+
+    switch (value [0]) {
+    case 's':
+      if (0 != strncmp (value, "sync", len))
+	goto unknown_flush;
+
+      o->flush = Z_SYNC_FLUSH;
+      break;
+
+    case 'f':
+      if (len < 2)
+	goto unknown_flush;
+
+      if (0 == strncmp (value, "full", len)) {
+	o->flush = Z_FULL_FLUSH;
+      } else if (0 == strncmp (value, "finish", len)) {
+	o->flush = Z_NO_FLUSH;
+      } else
+	goto unknown_flush;
+      break;
+
+    default:
+    unknown_flush:
+      Tcl_AppendResult (interp, "unknown flush '", (char*) NULL);
+      Tcl_AppendResult (interp, value, (char*) NULL);
+      Tcl_AppendResult (interp, "', should be 'sync', 'full' or 'finish'", (char*) NULL);
+      return TCL_ERROR;
+      break;
+    } /* switch optvalue */
+    break;
+
+  case 'h':
+    if (0 != strncmp (optname, "-hibernate", len))
+      goto unknown_option;
+
+    return Tcl_GetBooleanFromObj (interp, (Tcl_Obj*) optvalue,
+				  &o->hibernate);
+    break;
+
+  case 'i':
+    if (0 != strncmp (optname, "-index", len))
+      goto unknown_option;
+
+    return SizeOption (interp, optvalue, TRF_MIN_INDEX, TRF_MAX_INDEX,
+		       "1K..1024M", "index", &o->index);
+    break;
+
   case 'l':
     if (0 != strncmp (optname, "-level", len))
       goto unknown_option;
@@ -282,6 +485,14 @@ ClientData  clientData;
     break;
 
   case 'm':
+    if (len < 2)
+      goto unknown_option;
+
+    if (0 == strncmp (optname, "-memlevel", len)) {
+      return IntOption (interp, optvalue, 1, MAX_MEM_LEVEL, "memlevel",
+			&o->memlevel);
+    }
+
     if (0 != strncmp (optname, "-mode", len))
       goto unknown_option;
 
@@ -335,6 +546,77 @@ ClientData  clientData;
     }
     break;
 
+  case 's':
+    if (0 != strncmp (optname, "-strategy", len))
+      goto unknown_option;
+
+    value = Tcl_GetStringFromObj ((Tcl_Obj*) optvalue, NULL);
+    len   = strlen (value);
+
+    switch (value [0]) {
+    case 'd':
+      if (0 != strncmp (value, "default", len))
+	goto unknown_strategy;
+
+      o->strategy = Z_DEFAULT_STRATEGY;
+      break;
+
+    case 'f':
+      if (len < 2)
+	goto unknown_strategy;
+
+      if (0 == strncmp (value, "filtered", len)) {
+	o->strategy = Z_FILTERED;
+#ifdef Z_FIXED
+      } else if (0 == strncmp (value, "fixed", len)) {
+	o->strategy = Z_FIXED;
+#endif
+      } else
+	goto unknown_strategy;
+      break;
+
+    case 'h':
+      if (0 != strncmp (value, "huffman", len))
+	goto unknown_strategy;
+
+      o->strategy = Z_HUFFMAN_ONLY;
+      break;
+
+#ifdef Z_RLE
+    case 'r':
+      if (0 != strncmp (value, "rle", len))
+	goto unknown_strategy;
+
+      o->strategy = Z_RLE;
+      break;
+#endif
+
+    default:
+    unknown_strategy:
+      Tcl_AppendResult (interp, "unknown strategy '", (char*) NULL);
+      Tcl_AppendResult (interp, value, (char*) NULL);
+      Tcl_AppendResult (interp, "', should be 'default', 'filtered', 'huffman', 'rle' or 'fixed'", (char*) NULL);
+      return TCL_ERROR;
+      break;
+    } /* switch optvalue */
+    break;
+
+  case 't':
+    if (0 != strncmp (optname, "-threads", len))
+      goto unknown_option;
+
+    return IntOption (interp, optvalue, 1, TRF_MAX_THREADS, "threads",
+		      &o->threads);
+    break;
+
+  case 'w':
+    if (0 != strncmp (optname, "-window", len))
+      goto unknown_option;
+
+    return IntOption (interp, optvalue, 9, MAX_WBITS, "window",
+		      &o->window);
+    break;
+
   default:
     goto unknown_option;
     break;
@@ -345,7 +627,7 @@ ClientData  clientData;
  unknown_option:
   Tcl_AppendResult (interp, "unknown option '", (char*) NULL);
   Tcl_AppendResult (interp, optname, (char*) NULL);
-  Tcl_AppendResult (interp, "', should be '-level', '-mode' or '-nowrap'", (char*) NULL);
+  Tcl_AppendResult (interp, "', should be '-blocksize', '-dictionary', '-flush', '-hibernate', '-index', '-level', '-memlevel', '-mode', '-nowrap', '-strategy', '-threads' or '-window'", (char*) NULL);
   return TCL_ERROR;
 }
 
@@ -380,3 +662,119 @@ ClientData  clientData;
   return (o->mode == TRF_COMPRESS ? 1 : 0);
 }
 
+
+/*
+ *------------------------------------------------------*
+ *
+ *	IntOption --
+ *
+ *	------------------------------------------------*
+ *	Converts the value of an integer option, and
+ *	checks it against the allowed range.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		May leave an error message in the
+ *		interpreter result area.
+ *
+ *	Result:
+ *		A standard Tcl error code, in case of
+ *		success 'result' is set too.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+IntOption (interp, optvalue, min, max, what, result)
+Tcl_Interp*    interp;
+CONST Tcl_Obj* optvalue;
+int            min;
+int            max;
+CONST char*    what;
+int*           result;
+{
+  int  val;
+  char buf [50];
+
+  if (TCL_OK != Tcl_GetIntFromObj (interp, (Tcl_Obj*) optvalue, &val)) {
+    return TCL_ERROR;
+  }
+
+  if ((val < min) || (val > max)) {
+    sprintf (buf, "%d..%d", min, max);
+    Tcl_AppendResult (interp, what, " out of range ", buf, (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  *result = val;
+  return TCL_OK;
+}
+
+/*
+ *------------------------------------------------------*
+ *
+ *	SizeOption --
+ *
+ *	------------------------------------------------*
+ *	Converts the value of a size option, a number
+ *	with an optional unit of K or M, and checks it
+ *	against the allowed range.
+ *	------------------------------------------------*
+ *
+ *	Sideeffects:
+ *		May leave an error message in the
+ *		interpreter result area.
+ *
+ *	Result:
+ *		A standard Tcl error code, in case of
+ *		success 'result' is set too.
+ *
+ *------------------------------------------------------*
+ */
+
+static int
+SizeOption (interp, optvalue, min, max, range, what, result)
+Tcl_Interp*    interp;
+CONST Tcl_Obj* optvalue;
+int            min;
+int            max;
+CONST char*    range;
+CONST char*    what;
+int*           result;
+{
+  CONST char* value;
+  int         len, val, res;
+  int         unit = 1;
+
+  value = Tcl_GetStringFromObj ((Tcl_Obj*) optvalue, &len);
+
+  if ((len > 1) && ((value [len-1] == 'K') || (value [len-1] == 'k'))) {
+    unit = 1024;
+  } else if ((len > 1) && ((value [len-1] == 'M') || (value [len-1] == 'm'))) {
+    unit = 1024*1024;
+  }
+
+  if (unit > 1) {
+    /* Scaled value, convert the number in front of the unit */
+
+    Tcl_Obj* num = Tcl_NewStringObj ((char*) value, len-1);
+
+    Tcl_IncrRefCount (num);
+    res = Tcl_GetIntFromObj (interp, num, &val);
+    Tcl_DecrRefCount (num);
+  } else {
+    res = Tcl_GetIntFromObj (interp, (Tcl_Obj*) optvalue, &val);
+  }
+
+  if (res != TCL_OK) {
+    return res;
+  }
+
+  if ((val < 0) || (val > max / unit) || (val * unit < min)) {
+    Tcl_AppendResult (interp, what, " out of range ", range, (char*) NULL);
+    return TCL_ERROR;
+  }
+
+  *result = val * unit;
+  return TCL_OK;
+}
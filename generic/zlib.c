@@ -20,6 +20,7 @@
 #endif
 
 
+#ifndef ZLIB_STATIC_BUILD
 static char* symbols [] = {
   "deflate",
   "deflateEnd",
@@ -31,6 +32,9 @@ static char* symbols [] = {
   "inflateReset",
   "adler32",
   "crc32",
+  "deflateSetDictionary",
+  "inflateSetDictionary",
+  "inflatePrime",          /* optional, see zip -index */
   (char *) NULL
 };
 
@@ -39,22 +43,15 @@ static char* symbols [] = {
  * Global variable containing the vectors into the 'zlib'-library.
  */
 
-#ifdef ZLIB_STATIC_BUILD
-zFunctions zf = {
-  0,
-  deflate,
-  deflateEnd,
-  deflateInit_,
-  deflateReset,
-  inflate,
-  inflateEnd,
-  inflateInit_,
-  inflateReset,
-  adler32,
-  crc32,
-};
-#else
 zFunctions zf = {0}; /* THREADING: serialize initialization */
+
+/*
+ * Set after the library was loaded successfully. Later calls of
+ * 'TrfLoadZlib' only check it, under the lock, and do not load the
+ * library again.
+ */
+
+static int zfLoaded = 0; /* THREADING: read and set under the lock */
 #endif
 
 int
@@ -84,13 +81,25 @@ TrfLoadZlib (interp)
     zf.zinflateReset  = inflateReset ;
     zf.zadler32       = adler32      ;
     zf.zcrc32         = crc32        ;
+    zf.zdeflateSetDictionary = deflateSetDictionary;
+    zf.zinflateSetDictionary = inflateSetDictionary;
+    zf.zinflatePrime         = inflatePrime;
     return TCL_OK;
   }
 
 #endif
 
   TrfLock; /* THREADING: serialize initialization */
-  res = Trf_LoadLibrary (interp, Z_LIB_NAME, (VOID**) &zf, symbols, 10);
+
+  if (zfLoaded) {
+    TrfUnlock;
+    return TCL_OK;
+  }
+
+  res = Trf_LoadLibrary (interp, Z_LIB_NAME, (VOID**) &zf, symbols, 12);
+  if (res == TCL_OK) {
+    zfLoaded = 1;
+  }
   TrfUnlock;
 
   return res;
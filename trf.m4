@@ -153,13 +153,21 @@ AC_ARG_WITH(bz2-lib-dir,
 	[BZ2_LIB_DIR=$withval],
 	[])
 
+AC_ARG_ENABLE(static-libs,
+	[  --enable-static-libs          link 'zlib', 'bzlib' and 'libcrypto' statically],
+	[STATIC_LIBS=$enableval], [STATIC_LIBS=no])
+
 AC_ARG_ENABLE(static-zlib,
 	[  --enable-static-zlib         link 'zlib' statically],
-	[STATIC_ZLIB=$enableval], [STATIC_ZLIB=no])
+	[STATIC_ZLIB=$enableval], [STATIC_ZLIB=$STATIC_LIBS])
 
 AC_ARG_ENABLE(static-bzlib,
 	[  --enable-static-bzlib         link 'bzlib' statically],
-	[STATIC_BZLIB=$enableval], [STATIC_BZLIB=no])
+	[STATIC_BZLIB=$enableval], [STATIC_BZLIB=$STATIC_LIBS])
+
+AC_ARG_ENABLE(static-ssl,
+	[  --enable-static-ssl           link 'libcrypto' statically],
+	[STATIC_SSL=$enableval], [STATIC_SSL=$STATIC_LIBS])
 
 AC_ARG_ENABLE(static-md5,
 	[  --enable-static-md5           link 'md5' statically],
@@ -527,17 +535,31 @@ AC_SUBST(BZ2_LIB_DIR)
 dnl AC_CACHE_VAL(trf_cv_BZ2_LIB_DIR, [trf_cv_BZ2_LIB_DIR="$BZ2_LIB_DIR"])
 
 
-if test "x$ZLIB_STATIC" = "xyes"
+dnl ----------------------------------------------------------------
+dnl
+dnl Static linking. The libraries are linked into the package and
+dnl called directly instead of through the tables filled at runtime
+dnl by Trf_LoadLibrary.
+
+if test "x$STATIC_ZLIB" = "xyes"
 then
 	eval AC_DEFINE_UNQUOTED(ZLIB_STATIC_BUILD, 1)
+	TEA_ADD_LIBS([-L${ZLIB_LIB_DIR} -lz])
 fi
 
-if test "x$BZLIB_STATIC" = "xyes"
+if test "x$STATIC_BZLIB" = "xyes"
 then
 	eval AC_DEFINE_UNQUOTED(BZLIB_STATIC_BUILD, 1)
+	TEA_ADD_LIBS([-L${BZ2_LIB_DIR} -lbz2])
+fi
+
+if test "x$STATIC_SSL" = "xyes"
+then
+	eval AC_DEFINE_UNQUOTED(SSL_STATIC_BUILD, 1)
+	TEA_ADD_LIBS([-L${SSL_LIB_DIR} -lcrypto])
 fi
 
-if test "x$MD5_STATIC" = "xyes"
+if test "x$STATIC_MD5" = "xyes"
 then
 	eval AC_DEFINE_UNQUOTED(MD5_STATIC_BUILD, 1)
 fi
@@ -207,6 +207,7 @@ SOURCES	=	../generic/adler.c \
 	../generic/rmd160.c \
 	../generic/rmd128.c \
 	../generic/unstack.c \
+	../generic/pipeline.c \
 	../generic/util.c \
 	../generic/uucode.c \
 	../generic/zip.c \
@@ -215,6 +216,8 @@ SOURCES	=	../generic/adler.c \
 	../generic/bz2.c \
 	../generic/bz2_opt.c \
 	../generic/bz2lib.c \
+	../generic/lz4.c \
+	../generic/lz4_opt.c \
 	../generic/qpcode.c \
 	../generic/reflect.c \
 	../generic/ref_opt.c \
@@ -251,6 +254,7 @@ OBJECTS	=	adler.o \
 	rmd160.o \
 	rmd128.o \
 	unstack.o \
+	pipeline.o \
 	util.o \
 	uucode.o \
 	zip.o \
@@ -259,6 +263,8 @@ OBJECTS	=	adler.o \
 	bz2.o \
 	bz2_opt.o \
 	bz2lib.o \
+	lz4.o \
+	lz4_opt.o \
 	qpcode.o \
 	reflect.o \
 	ref_opt.o \
@@ -370,6 +376,9 @@ rmd128.o:	../generic/rmd128.c
 unstack.o:	../generic/unstack.c
 	$(CC) -c $(CC_SWITCHES) ../generic/unstack.c -o $@
 
+pipeline.o:	../generic/pipeline.c
+	$(CC) -c $(CC_SWITCHES) ../generic/pipeline.c -o $@
+
 util.o:	../generic/util.c
 	$(CC) -c $(CC_SWITCHES) ../generic/util.c -o $@
 
@@ -394,6 +403,12 @@ bz2_opt.o:	../generic/zip_opt.c
 bz2lib.o:	../generic/zlib.c
 	$(CC) -c $(CC_SWITCHES) ../generic/bz2lib.c -o $@
 
+lz4.o:	../generic/lz4.c
+	$(CC) -c $(CC_SWITCHES) ../generic/lz4.c -o $@
+
+lz4_opt.o:	../generic/lz4_opt.c
+	$(CC) -c $(CC_SWITCHES) ../generic/lz4_opt.c -o $@
+
 qpcode.o:	../generic/qpcode.c
 	$(CC) -c $(CC_SWITCHES) ../generic/qpcode.c -o $@
 